@@ -7,7 +7,7 @@ layout(location = 2) in vec3 fragNormals;
 layout(location = 3) in vec4 eye;
 layout(location = 4) in vec4 light;
 
-struct MeshProperties {
+struct Material {
     int ambientTexture;
     int diffuseTexture;
     int specularTexture;
@@ -20,9 +20,9 @@ struct MeshProperties {
     float shininess;
 };
 
-layout(location = 5) flat in MeshProperties meshProperties;
+layout(location = 5) flat in Material meshProperties;
 
-layout(binding = 2) uniform sampler2D samplers[25];
+layout(binding = 2) uniform sampler2D samplers[50];
 
 layout(location = 0) out vec4 outColor;
 
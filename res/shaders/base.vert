@@ -1,11 +1,10 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
+layout(location = 0) in vec4 inPosition;
+layout(location = 1) in vec2 inNormal;
 layout(location = 2) in vec2 inUV;
-layout(location = 3) in vec3 inTangent;
-layout(location = 4) in vec3 inBitangent;
+layout(location = 3) in vec2 inTangent;
 
 layout(binding = 0) uniform UniformBufferObject {
     mat4 view;
@@ -25,46 +24,82 @@ struct MeshProperties {
     float opacity;
     vec3 specularColor;
     float shininess;
+    vec4 positionOffset;
+    vec4 positionScale;
 };
 
-layout(push_constant) uniform PushConstants {
-    mat4 matrix;
-} modelProperties;
+// the varying leaves out the dequantization fields to stay within 64 output components
+struct Material {
+    int ambientTexture;
+    int diffuseTexture;
+    int specularTexture;
+    int normalTexture;
+    vec3 ambientColor;
+    float emissiveFactor;
+    vec3 diffuseColor;
+    float opacity;
+    vec3 specularColor;
+    float shininess;
+};
 
 layout(std430, binding = 1) readonly buffer SSBO {
     MeshProperties props[];
 } meshPropertiesSSBO;
 
+layout(std430, binding = 3) readonly buffer Transforms {
+    mat4 matrices[];
+} modelProperties;
+
+layout(std430, binding = 4) readonly buffer Instances {
+    uvec2 references[];
+} instanceProperties;
+
 layout(location = 0) out vec3 fragPosition;
 layout(location = 1) out vec2 fragTexCoord;
 layout(location = 2) out vec3 fragNormals;
 layout(location = 3) out vec4 eye;
 layout(location = 4) out vec4 light;
-layout(location = 5) flat out MeshProperties meshProperties;
+layout(location = 5) flat out Material meshProperties;
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 direction = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if (direction.z < 0) {
+        direction.xy = (1.0 - abs(direction.yx)) * vec2(direction.x >= 0 ? 1.0 : -1.0, direction.y >= 0 ? 1.0 : -1.0);
+    }
+    
+    return normalize(direction);
+}
 
 void main() {
-    MeshProperties meshProps = meshPropertiesSSBO.props[gl_InstanceIndex];
+    uvec2 instance = instanceProperties.references[gl_InstanceIndex];
+    MeshProperties meshProps = meshPropertiesSSBO.props[instance.y];
+    mat4 modelMatrix = modelProperties.matrices[instance.x];
 
-    vec4 pos = modelProperties.matrix * vec4(inPosition, 1.0);
+    vec3 position = meshProps.positionOffset.xyz + inPosition.xyz * meshProps.positionScale.xyz;
+    vec3 normal = decodeOctahedral(inNormal);
+    
+    vec4 pos = modelMatrix * vec4(position, 1.0);
 
     gl_Position = modelUniforms.proj * modelUniforms.view * pos;
     fragPosition = vec3(pos);
     fragTexCoord = inUV;
     
-    mat3 invertTransposeModel = mat3(transpose(inverse(modelProperties.matrix)));
+    mat3 invertTransposeModel = mat3(transpose(inverse(modelMatrix)));
     
-    fragNormals = normalize(invertTransposeModel * inNormal);
+    fragNormals = normalize(invertTransposeModel * normal);
     eye = modelUniforms.camera;
     light = modelUniforms.sun;
-    meshProperties = meshProps;
+    meshProperties = Material(
+        meshProps.ambientTexture, meshProps.diffuseTexture, meshProps.specularTexture, meshProps.normalTexture,
+        meshProps.ambientColor, meshProps.emissiveFactor, meshProps.diffuseColor, meshProps.opacity,
+        meshProps.specularColor, meshProps.shininess);
 
     if (meshProps.normalTexture != -1) {
-        vec3 T = normalize(invertTransposeModel * inTangent);
-        vec3 N = normalize(invertTransposeModel * inNormal);
-        vec3 B = normalize(invertTransposeModel * inBitangent);
+        vec3 T = normalize(invertTransposeModel * decodeOctahedral(inTangent));
+        vec3 N = normalize(invertTransposeModel * normal);
 
         T = normalize(T - dot(T, N) * N);
-        if (dot(cross(N, T), B) < 0.0f) T *= -1.0f;
+        if (inPosition.w < 0.5f) T *= -1.0f;
         mat3 TBN = transpose(mat3(T, cross(N, T), N));
 
         pos = vec4(TBN * vec3(pos), 1.0);        
@@ -22,6 +22,7 @@ void Camera::updateViewMatrix() {
     }
     
     this->frustum.update(this->perspective * this->view);
+    this->version++;
 };
 
 glm::vec3 Camera::getPosition() {
@@ -170,6 +171,10 @@ glm::mat4 Camera::getProjectionMatrix() {
     return this->perspective;
 };
 
+uint64_t Camera::getVersion() {
+    return this->version;
+}
+
 Camera::Camera(glm::vec3 position)
 {
     setPosition(position);
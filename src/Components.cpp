@@ -167,6 +167,10 @@ std::vector<Component *> Components::getAllComponentsForModel(std::string model)
     return allMeshProperties;
 }
 
+void Components::removeComponentsForModel(std::string model) {
+    this->components.erase(model);
+}
+
 bool Components::checkCollision(BoundingBox & bbox) {    
     for (auto & allComponentsPerModel : this->components) {
         auto & allComps = allComponentsPerModel.second;
@@ -259,3 +263,15 @@ glm::vec3 Component::getRotation() {
     return this->rotation;
 }
 
+uint32_t Component::getLod() {
+    return this->lod;
+}
+
+void Component::updateLod(const float screenSize) {
+    // thresholds are widened in the direction of the switch to avoid popping back and forth
+    while (this->lod < LOD_SCREEN_SIZES.size() && screenSize < LOD_SCREEN_SIZES[this->lod] * (1.0f - LOD_HYSTERESIS)) this->lod++;
+    while (this->lod > 0 && screenSize > LOD_SCREEN_SIZES[this->lod - 1] * (1.0f + LOD_HYSTERESIS)) this->lod--;
+}
+
+const std::array<float, 3> Component::LOD_SCREEN_SIZES = { 400.0f, 160.0f, 60.0f };
+const float Component::LOD_HYSTERESIS = 0.1f;
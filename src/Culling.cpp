@@ -0,0 +1,552 @@
+#include "includes/graphics.h"
+
+bool Graphics::createCulling() {
+    // the passes are recorded into the frame's command buffer, so the graphics queue has to do compute as well
+    const std::vector<VkQueueFamilyProperties> queueFamilyProperties = this->getPhysicalDeviceQueueFamilyProperties(this->physicalDevice);
+    if ((queueFamilyProperties[this->graphicsQueueIndex].queueFlags & VK_QUEUE_COMPUTE_BIT) == 0) return false;
+
+    // the visible instances of a draw are addressed through its first instance
+    if (!this->supportsDrawIndirectFirstInstance) return false;
+
+    if (!this->createCullingDescriptorPool()) return false;
+    if (!this->createCullingDescriptorSetLayouts()) return false;
+    if (!this->createCullingDescriptorSet()) return false;
+
+    VkSamplerCreateInfo samplerInfo{};
+    samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    samplerInfo.magFilter = VK_FILTER_NEAREST;
+    samplerInfo.minFilter = VK_FILTER_NEAREST;
+    samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    samplerInfo.anisotropyEnable = VK_FALSE;
+    samplerInfo.maxAnisotropy = 1.0f;
+    samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    samplerInfo.unnormalizedCoordinates = VK_FALSE;
+    samplerInfo.compareEnable = VK_FALSE;
+    samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+    samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+    VkResult ret = vkCreateSampler(this->device, &samplerInfo, nullptr, &this->depthPyramidSampler);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Create Depth Pyramid Sampler!" << std::endl;
+        return false;
+    }
+
+    if (!this->createComputePipeline(
+            "cull_comp.spv", this->cullingDescriptorSetLayout, sizeof(struct CullingConstants),
+            this->cullingShaderModule, this->cullingPipelineLayout, this->cullingPipeline)) return false;
+
+    if (!this->createComputePipeline(
+            "depth_pyramid_comp.spv", this->depthPyramidDescriptorSetLayout, sizeof(struct DepthPyramidConstants),
+            this->depthPyramidShaderModule, this->depthPyramidPipelineLayout, this->depthPyramidPipeline)) {
+        std::cerr << "Occlusion Culling is not available" << std::endl;
+    }
+
+    return true;
+}
+
+bool Graphics::createCullingDescriptorPool() {
+    std::array<VkDescriptorPoolSize, 4> poolSizes{};
+
+    // the culling set plus one set per pyramid level, those are replaced along with the swap chain.
+    // the culling set is replaced when the frame data grows, the old ones live on until no frame in flight uses them
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = DESCRIPTOR_SET_GENERATIONS;
+    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[1].descriptorCount = DESCRIPTOR_SET_GENERATIONS;
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    poolSizes[2].descriptorCount = DESCRIPTOR_SET_GENERATIONS + DEPTH_PYRAMID_MAX_LEVELS;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    poolSizes[3].descriptorCount = DEPTH_PYRAMID_MAX_LEVELS;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = DESCRIPTOR_SET_GENERATIONS + DEPTH_PYRAMID_MAX_LEVELS;
+
+    VkResult ret = vkCreateDescriptorPool(this->device, &poolInfo, nullptr, &this->cullingDescriptorPool);
+    ASSERT_VULKAN(ret);
+    if (ret != VK_SUCCESS) {
+       std::cerr << "Failed to Create Culling Descriptor Pool!" << std::endl;
+       return false;
+    }
+
+    return true;
+}
+
+bool Graphics::createCullingDescriptorSetLayouts() {
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+
+    VkDescriptorSetLayoutBinding modelUniformLayoutBinding{};
+    modelUniformLayoutBinding.binding = 0;
+    modelUniformLayoutBinding.descriptorCount = 1;
+    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    modelUniformLayoutBinding.pImmutableSamplers = nullptr;
+    modelUniformLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings.push_back(modelUniformLayoutBinding);
+
+    // all of the instance data, the shader finds the arrays within by the offsets it is handed
+    VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+    instanceLayoutBinding.binding = 1;
+    instanceLayoutBinding.descriptorCount = 1;
+    instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    instanceLayoutBinding.pImmutableSamplers = nullptr;
+    instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings.push_back(instanceLayoutBinding);
+
+    VkDescriptorSetLayoutBinding depthPyramidLayoutBinding{};
+    depthPyramidLayoutBinding.binding = 2;
+    depthPyramidLayoutBinding.descriptorCount = 1;
+    depthPyramidLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    depthPyramidLayoutBinding.pImmutableSamplers = nullptr;
+    depthPyramidLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings.push_back(depthPyramidLayoutBinding);
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = layoutBindings.size();
+    layoutInfo.pBindings = layoutBindings.data();
+
+    VkResult ret = vkCreateDescriptorSetLayout(this->device, &layoutInfo, nullptr, &this->cullingDescriptorSetLayout);
+    ASSERT_VULKAN(ret);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Create Culling Descriptor Set Layout!" << std::endl;
+        return false;
+    }
+
+    layoutBindings.clear();
+
+    VkDescriptorSetLayoutBinding sourceLayoutBinding{};
+    sourceLayoutBinding.binding = 0;
+    sourceLayoutBinding.descriptorCount = 1;
+    sourceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    sourceLayoutBinding.pImmutableSamplers = nullptr;
+    sourceLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings.push_back(sourceLayoutBinding);
+
+    VkDescriptorSetLayoutBinding destinationLayoutBinding{};
+    destinationLayoutBinding.binding = 1;
+    destinationLayoutBinding.descriptorCount = 1;
+    destinationLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    destinationLayoutBinding.pImmutableSamplers = nullptr;
+    destinationLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    layoutBindings.push_back(destinationLayoutBinding);
+
+    layoutInfo.bindingCount = layoutBindings.size();
+    layoutInfo.pBindings = layoutBindings.data();
+
+    ret = vkCreateDescriptorSetLayout(this->device, &layoutInfo, nullptr, &this->depthPyramidDescriptorSetLayout);
+    ASSERT_VULKAN(ret);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Create Depth Pyramid Descriptor Set Layout!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Graphics::createCullingDescriptorSet() {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = this->cullingDescriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &this->cullingDescriptorSetLayout;
+
+    VkResult ret = vkAllocateDescriptorSets(this->device, &allocInfo, &this->cullingDescriptorSet);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Allocate Culling Descriptor Set!" << std::endl;
+        return false;
+    }
+
+    // the depth pyramid is written in once there is a swap chain, a replacement set takes over the existing one
+    VkDescriptorBufferInfo uniformBufferInfo{};
+    uniformBufferInfo.buffer = this->frameDataBuffer;
+    uniformBufferInfo.offset = 0;
+    uniformBufferInfo.range = sizeof(struct ModelUniforms);
+
+    VkDescriptorBufferInfo instanceBufferInfo{};
+    instanceBufferInfo.buffer = this->frameDataBuffer;
+    instanceBufferInfo.offset = 0;
+    instanceBufferInfo.range = this->frameDataStride - this->alignFrameData(sizeof(struct ModelUniforms));
+
+    std::vector<VkWriteDescriptorSet> descriptorWrites;
+
+    VkWriteDescriptorSet uniformDescriptorSet = {};
+    uniformDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    uniformDescriptorSet.dstSet = this->cullingDescriptorSet;
+    uniformDescriptorSet.dstBinding = 0;
+    uniformDescriptorSet.dstArrayElement = 0;
+    uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    uniformDescriptorSet.descriptorCount = 1;
+    uniformDescriptorSet.pBufferInfo = &uniformBufferInfo;
+    descriptorWrites.push_back(uniformDescriptorSet);
+
+    VkWriteDescriptorSet instanceDescriptorSet = {};
+    instanceDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    instanceDescriptorSet.dstSet = this->cullingDescriptorSet;
+    instanceDescriptorSet.dstBinding = 1;
+    instanceDescriptorSet.dstArrayElement = 0;
+    instanceDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    instanceDescriptorSet.descriptorCount = 1;
+    instanceDescriptorSet.pBufferInfo = &instanceBufferInfo;
+    descriptorWrites.push_back(instanceDescriptorSet);
+
+    VkDescriptorImageInfo depthPyramidImageInfo{};
+    depthPyramidImageInfo.sampler = this->depthPyramidSampler;
+    depthPyramidImageInfo.imageView = this->depthPyramidImageView;
+    depthPyramidImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    if (this->depthPyramidImageView != nullptr) {
+        VkWriteDescriptorSet depthPyramidDescriptorSet = {};
+        depthPyramidDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        depthPyramidDescriptorSet.dstSet = this->cullingDescriptorSet;
+        depthPyramidDescriptorSet.dstBinding = 2;
+        depthPyramidDescriptorSet.dstArrayElement = 0;
+        depthPyramidDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        depthPyramidDescriptorSet.descriptorCount = 1;
+        depthPyramidDescriptorSet.pImageInfo = &depthPyramidImageInfo;
+        descriptorWrites.push_back(depthPyramidDescriptorSet);
+    }
+
+    vkUpdateDescriptorSets(this->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+    return true;
+}
+
+bool Graphics::createComputePipeline(
+    const std::string & shaderFile, VkDescriptorSetLayout descriptorSetLayout, uint32_t pushConstantSize,
+    VkShaderModule & shaderModule, VkPipelineLayout & pipelineLayout, VkPipeline & pipeline) {
+    std::vector<char> shaderCode;
+    if (!Utils::readFile(this->getAppPath(SHADERS) / shaderFile, shaderCode)) {
+        std::cerr << "Failed to read shader file: " << (this->getAppPath(SHADERS) / shaderFile) << std::endl;
+        return false;
+    }
+
+    shaderModule = this->createShaderModule(shaderCode);
+    if (shaderModule == nullptr) return false;
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo{};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shaderModule;
+    shaderStageInfo.pName = "main";
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = pushConstantSize;
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+
+    VkResult ret = vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+    ASSERT_VULKAN(ret);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Create Compute Pipeline Layout!" << std::endl;
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage = shaderStageInfo;
+    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+    ret = vkCreateComputePipelines(this->device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline);
+    ASSERT_VULKAN(ret);
+    if (ret != VK_SUCCESS) {
+        pipeline = nullptr;
+        std::cerr << "Failed to Create Compute Pipeline!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Graphics::isCullingActive() {
+    return this->cullingPipeline != nullptr && this->depthPyramidImageView != nullptr;
+}
+
+bool Graphics::isOcclusionCullingActive() {
+    return this->useOcclusionCulling && this->cullingPipeline != nullptr && this->depthPyramidPipeline != nullptr;
+}
+
+bool Graphics::createDepthPyramid() {
+    // without occlusion culling it's a placeholder that is bound but never read
+    VkExtent2D extent = { 1, 1 };
+    uint32_t levels = 1;
+    if (this->isOcclusionCullingActive()) {
+        extent = { (this->swapChainExtent.width + 1) / 2, (this->swapChainExtent.height + 1) / 2 };
+        levels = std::min(
+            static_cast<uint32_t>(std::floor(std::log2(std::max(extent.width, extent.height)))) + 1, DEPTH_PYRAMID_MAX_LEVELS);
+    }
+
+    if (!this->createImage(
+            extent.width, extent.height, VK_FORMAT_R32_SFLOAT, VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            this->depthPyramidImage, this->depthPyramidImageMemory, 1, levels)) {
+        std::cerr << "Failed to Create Depth Pyramid Image" << std::endl;
+        return false;
+    }
+
+    this->depthPyramidImageView = this->createImageView(this->depthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, levels);
+    if (this->depthPyramidImageView == nullptr) {
+        std::cerr << "Failed to Create Depth Pyramid Image View!" << std::endl;
+        return false;
+    }
+
+    for (uint32_t i=0; i<levels; i++) {
+        VkImageView levelView = this->createImageView(this->depthPyramidImage, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 1, 1, i);
+        if (levelView == nullptr) {
+            std::cerr << "Failed to Create Depth Pyramid Image View!" << std::endl;
+            return false;
+        }
+
+        this->depthPyramidLevelViews.push_back(levelView);
+        this->depthPyramidLevelExtents.push_back({ std::max(extent.width >> i, 1u), std::max(extent.height >> i, 1u) });
+    }
+
+    // rounded up halving, level sizes are the ones the reduction in the shader produces
+    for (uint32_t i=1; i<levels; i++) {
+        this->depthPyramidLevelExtents[i] = {
+            (this->depthPyramidLevelExtents[i-1].width + 1) / 2, (this->depthPyramidLevelExtents[i-1].height + 1) / 2 };
+    }
+
+    // far depth until the first pyramid is built, nothing counts as occluded. the image stays in general layout
+    VkCommandBuffer commandBuffer = this->getUploadGraphicsCommandBuffer();
+    if (commandBuffer == nullptr) return false;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = this->depthPyramidImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = levels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkClearColorValue clearColor {};
+    clearColor.float32[0] = 1.0f;
+    vkCmdClearColorImage(commandBuffer, this->depthPyramidImage, VK_IMAGE_LAYOUT_GENERAL, &clearColor, 1, &barrier.subresourceRange);
+
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    if (!this->flushUploadRing()) return false;
+
+    VkDescriptorImageInfo depthPyramidImageInfo{};
+    depthPyramidImageInfo.sampler = this->depthPyramidSampler;
+    depthPyramidImageInfo.imageView = this->depthPyramidImageView;
+    depthPyramidImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    VkWriteDescriptorSet depthPyramidDescriptorSet = {};
+    depthPyramidDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    depthPyramidDescriptorSet.dstSet = this->cullingDescriptorSet;
+    depthPyramidDescriptorSet.dstBinding = 2;
+    depthPyramidDescriptorSet.dstArrayElement = 0;
+    depthPyramidDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    depthPyramidDescriptorSet.descriptorCount = 1;
+    depthPyramidDescriptorSet.pImageInfo = &depthPyramidImageInfo;
+
+    vkUpdateDescriptorSets(this->device, 1, &depthPyramidDescriptorSet, 0, nullptr);
+
+    if (!this->isOcclusionCullingActive()) return true;
+
+    // one reduction per level, each reads the level above it, the first one the depth attachment
+    std::vector<VkDescriptorSetLayout> layouts(levels, this->depthPyramidDescriptorSetLayout);
+
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = this->cullingDescriptorPool;
+    allocInfo.descriptorSetCount = levels;
+    allocInfo.pSetLayouts = layouts.data();
+
+    this->depthPyramidDescriptorSets.resize(levels);
+    VkResult ret = vkAllocateDescriptorSets(this->device, &allocInfo, this->depthPyramidDescriptorSets.data());
+    if (ret != VK_SUCCESS) {
+        this->depthPyramidDescriptorSets.clear();
+        std::cerr << "Failed to Allocate Depth Pyramid Descriptor Sets!" << std::endl;
+        return false;
+    }
+
+    for (uint32_t i=0; i<levels; i++) {
+        VkDescriptorImageInfo sourceImageInfo{};
+        sourceImageInfo.sampler = this->depthPyramidSampler;
+        if (i == 0) {
+            sourceImageInfo.imageView = this->transientAttachments[this->depthAttachment].imageView;
+            sourceImageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+        } else {
+            sourceImageInfo.imageView = this->depthPyramidLevelViews[i-1];
+            sourceImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        }
+
+        VkDescriptorImageInfo destinationImageInfo{};
+        destinationImageInfo.imageView = this->depthPyramidLevelViews[i];
+        destinationImageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites {};
+
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = this->depthPyramidDescriptorSets[i];
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pImageInfo = &sourceImageInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = this->depthPyramidDescriptorSets[i];
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &destinationImageInfo;
+
+        vkUpdateDescriptorSets(this->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    }
+
+    return true;
+}
+
+void Graphics::destroyDepthPyramid() {
+    if (!this->depthPyramidDescriptorSets.empty()) {
+        vkFreeDescriptorSets(
+            this->device, this->cullingDescriptorPool,
+            static_cast<uint32_t>(this->depthPyramidDescriptorSets.size()), this->depthPyramidDescriptorSets.data());
+        this->depthPyramidDescriptorSets.clear();
+    }
+
+    for (VkImageView & levelView : this->depthPyramidLevelViews) {
+        vkDestroyImageView(this->device, levelView, nullptr);
+    }
+    this->depthPyramidLevelViews.clear();
+    this->depthPyramidLevelExtents.clear();
+
+    if (this->depthPyramidImageView != nullptr) {
+        vkDestroyImageView(this->device, this->depthPyramidImageView, nullptr);
+        this->depthPyramidImageView = nullptr;
+    }
+
+    if (this->depthPyramidImage != nullptr) {
+        vkDestroyImage(this->device, this->depthPyramidImage, nullptr);
+        this->depthPyramidImage = nullptr;
+    }
+
+    this->memoryAllocator.free(this->depthPyramidImageMemory);
+}
+
+void Graphics::recordCulling(VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex, const InstanceData & instanceData) {
+    // the pyramid of the previous frame has to be complete
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullingPipeline);
+
+    const uint32_t frameDataOffset = static_cast<uint32_t>(commandBufferIndex * this->frameDataStride);
+    const std::array<uint32_t, 2> dynamicOffsets = {
+        frameDataOffset, static_cast<uint32_t>(frameDataOffset + this->alignFrameData(sizeof(struct ModelUniforms)))
+    };
+
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->cullingPipelineLayout, 0, 1, &this->cullingDescriptorSet,
+        static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+
+    CullingConstants constants;
+    constants.instanceCount = static_cast<uint32_t>(instanceData.instances.size());
+    constants.boundsOffset = static_cast<uint32_t>(instanceData.boundsOffset / sizeof(glm::vec4));
+    constants.instancesOffset = static_cast<uint32_t>(instanceData.instancesOffset / sizeof(uint32_t));
+    constants.drawIndicesOffset = static_cast<uint32_t>(instanceData.drawIndicesOffset / sizeof(uint32_t));
+    constants.culledInstancesOffset = static_cast<uint32_t>(instanceData.culledInstancesOffset / sizeof(uint32_t));
+    constants.drawCommandsOffset = static_cast<uint32_t>(instanceData.drawCommandsOffset / sizeof(uint32_t));
+    constants.depthPyramidLevels = static_cast<uint32_t>(this->depthPyramidDescriptorSets.size());
+    constants.viewportSize = glm::vec2(this->swapChainExtent.width, this->swapChainExtent.height);
+
+    vkCmdPushConstants(
+        commandBuffer, this->cullingPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(struct CullingConstants), &constants);
+    vkCmdDispatch(commandBuffer, (constants.instanceCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+    // instance counts and references are consumed by the indirect draws of the model pass
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Graphics::recordDepthPyramid(VkCommandBuffer & commandBuffer) {
+    if (this->depthPyramidDescriptorSets.empty()) return;
+
+    // the culling pass of this frame has read the levels that are about to be overwritten
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = this->depthPyramidImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = static_cast<uint32_t>(this->depthPyramidLevelViews.size());
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->depthPyramidPipeline);
+
+    barrier.subresourceRange.levelCount = 1;
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    for (size_t i=0; i<this->depthPyramidDescriptorSets.size(); i++) {
+        vkCmdBindDescriptorSets(
+            commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->depthPyramidPipelineLayout, 0, 1, &this->depthPyramidDescriptorSets[i], 0, nullptr);
+
+        const VkExtent2D sourceExtent = i == 0 ? this->swapChainExtent : this->depthPyramidLevelExtents[i-1];
+        const VkExtent2D destinationExtent = this->depthPyramidLevelExtents[i];
+
+        DepthPyramidConstants constants;
+        constants.sourceSize = glm::ivec2(sourceExtent.width, sourceExtent.height);
+        constants.destinationSize = glm::ivec2(destinationExtent.width, destinationExtent.height);
+
+        vkCmdPushConstants(
+            commandBuffer, this->depthPyramidPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(struct DepthPyramidConstants), &constants);
+        vkCmdDispatch(
+            commandBuffer, (destinationExtent.width + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE,
+            (destinationExtent.height + DEPTH_PYRAMID_GROUP_SIZE - 1) / DEPTH_PYRAMID_GROUP_SIZE, 1);
+
+        barrier.subresourceRange.baseMipLevel = static_cast<uint32_t>(i);
+        vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    }
+}
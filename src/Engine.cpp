@@ -58,17 +58,23 @@ bool Engine::loadModels() {
 
     bool ret = true; 
     
-    std::array<Model *, 8> models = {
-        new Model("batman", this->graphics.getAppPath(MODELS) / "batman.obj"),
-        new Model("teapot", this->graphics.getAppPath(MODELS) / "teapot.obj"),
-        new Model("nanosuit", this->graphics.getAppPath(MODELS) / "nanosuit.obj"),
-        new Model("cyborg", this->graphics.getAppPath(MODELS) / "cyborg.obj"),
-        new Model("mammoth", this->graphics.getAppPath(MODELS) / "woolly-mammoth-150k.obj"),
-        new Model("plane", this->graphics.getAppPath(MODELS) / "plane.obj"),
-        new Model("contraption", this->graphics.getAppPath(MODELS) / "contraption.obj"),
-        new Model("house", this->graphics.getAppPath(MODELS) / "house.obj")
+    ModelCache::resetStatistics();
+    
+    const std::filesystem::path modelsPath = this->graphics.getAppPath(MODELS);
+    
+    const std::vector<std::tuple<std::string, std::filesystem::path>> modelFiles = {
+        { "batman", modelsPath / "batman.obj" },
+        { "teapot", modelsPath / "teapot.obj" },
+        { "nanosuit", modelsPath / "nanosuit.obj" },
+        { "cyborg", modelsPath / "cyborg.obj" },
+        { "mammoth", modelsPath / "woolly-mammoth-150k.obj" },
+        { "plane", modelsPath / "plane.obj" },
+        { "contraption", modelsPath / "contraption.obj" },
+        { "house", modelsPath / "house.obj" }
     };
     
+    std::vector<Model *> models = Models::importModels(modelFiles);
+    
     for (auto * m : models) {
         if (m == nullptr) continue;
         
@@ -86,6 +92,7 @@ bool Engine::loadModels() {
     
     std::chrono::duration<double, std::milli> time_span = std::chrono::high_resolution_clock::now() - start;
     std::cout << "loaded models: " << time_span.count() <<  std::endl;
+    std::cout << "model cache hits: " << ModelCache::getHits() << " misses: " << ModelCache::getMisses() << std::endl;
     
     return ret;
 }
@@ -239,6 +246,12 @@ void Engine::loop() {
                             case SDL_SCANCODE_F:
                                 this->graphics.toggleWireFrame();
                                 break;                                
+                            case SDL_SCANCODE_O:
+                                this->graphics.toggleOcclusionCulling();
+                                break;
+                            case SDL_SCANCODE_M:
+                                this->graphics.printMemoryStatistics();
+                                break;
                             case SDL_SCANCODE_F12:
                                 isFullScreen = !isFullScreen;
                                 if (isFullScreen) {
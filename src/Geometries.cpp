@@ -18,6 +18,10 @@ glm::vec3 ColorVertex::getColor() {
 
 ModelVertex::ModelVertex(const glm::vec3 & position) {
     this->position = position;
+    this->normal = glm::vec3(0.0f);
+    this->uv = glm::vec2(0.0f);
+    this->tangent = glm::vec3(0.0f);
+    this->bitangent = glm::vec3(0.0f);
 }
 
 VkVertexInputBindingDescription ModelVertex::getBindingDescription() {
@@ -127,10 +131,26 @@ glm::vec3 ColorVertex::getPosition() {
     return this->position;
 }
 
-glm::vec3 ModelVertex::getPosition() {
+glm::vec3 ModelVertex::getPosition() const {
     return this->position;
 }
 
+glm::vec3 ModelVertex::getNormal() const {
+    return this->normal;
+}
+
+glm::vec2 ModelVertex::getUV() const {
+    return this->uv;
+}
+
+glm::vec3 ModelVertex::getTangent() const {
+    return this->tangent;
+}
+
+glm::vec3 ModelVertex::getBitangent() const {
+    return this->bitangent;
+}
+
 void ModelVertex::setUV(const glm::vec2 & uv) {
     this->uv = uv;
 }
@@ -147,20 +167,87 @@ void ModelVertex::setBitangent(const glm::vec3 & bitangent) {
     this->bitangent = bitangent;
 }
 
+static void encodeOctahedral(const glm::vec3 & direction, int16_t * encoded) {
+    const float l1Norm = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+    
+    glm::vec2 octahedral(0.0f);
+    if (l1Norm > 0.0f) {
+        octahedral = glm::vec2(direction.x, direction.y) / l1Norm;
+        if (direction.z < 0.0f) {
+            octahedral = (1.0f - glm::abs(glm::vec2(octahedral.y, octahedral.x))) *
+                glm::vec2(octahedral.x >= 0.0f ? 1.0f : -1.0f, octahedral.y >= 0.0f ? 1.0f : -1.0f);
+        }
+    }
+
+    encoded[0] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.x));
+    encoded[1] = static_cast<int16_t>(glm::packSnorm1x16(octahedral.y));
+}
+
+PackedModelVertex::PackedModelVertex(const ModelVertex & vertex, const glm::vec3 & boundsMin, const glm::vec3 & boundsExtent) {
+    const glm::vec3 position = vertex.getPosition() - boundsMin;
+    for (int i=0; i<3; i++) {
+        this->position[i] = boundsExtent[i] > 0.0f ? glm::packUnorm1x16(position[i] / boundsExtent[i]) : 0;
+    }
+
+    const glm::vec3 normal = vertex.getNormal();
+    const glm::vec3 tangent = vertex.getTangent();
+    this->position[3] = glm::dot(glm::cross(normal, tangent), vertex.getBitangent()) < 0.0f ? 0 : 65535;
+    
+    encodeOctahedral(normal, this->normal);
+    encodeOctahedral(tangent, this->tangent);
+
+    this->uv = glm::packHalf2x16(vertex.getUV());
+}
+
+VkVertexInputBindingDescription PackedModelVertex::getBindingDescription() {
+    VkVertexInputBindingDescription bindingDescription{};
+    bindingDescription.binding = 0;
+    bindingDescription.stride = sizeof(PackedModelVertex);
+    bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    return bindingDescription;
+}
+
+std::array<VkVertexInputAttributeDescription, 4> PackedModelVertex::getAttributeDescriptions() {
+    std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions{};
+
+    attributeDescriptions[0].binding = 0;
+    attributeDescriptions[0].location = 0;
+    attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+    attributeDescriptions[0].offset = offsetof(PackedModelVertex, position);
+
+    attributeDescriptions[1].binding = 0;
+    attributeDescriptions[1].location = 1;
+    attributeDescriptions[1].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[1].offset = offsetof(PackedModelVertex, normal);
+
+    attributeDescriptions[2].binding = 0;
+    attributeDescriptions[2].location = 2;
+    attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+    attributeDescriptions[2].offset = offsetof(PackedModelVertex, uv);
+
+    attributeDescriptions[3].binding = 0;
+    attributeDescriptions[3].location = 3;
+    attributeDescriptions[3].format = VK_FORMAT_R16G16_SNORM;
+    attributeDescriptions[3].offset = offsetof(PackedModelVertex, tangent);
+
+    return attributeDescriptions;
+}
+
 glm::vec3 SimpleVertex::getPosition() {
     return this->position;
 }
 
-Mesh::Mesh(const std::vector<ModelVertex> & vertices) {
-    this->vertices = vertices;
+Mesh::Mesh(std::vector<ModelVertex> vertices) {
+    this->vertices = std::move(vertices);
 }
 
-Mesh::Mesh(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> indices) : Mesh(vertices) {
-    this->indices = indices;
+Mesh::Mesh(std::vector<ModelVertex> vertices, std::vector<uint32_t> indices) : Mesh(std::move(vertices)) {
+    this->indices = std::move(indices);
 }
 
-Mesh::Mesh(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> indices, 
-           const TextureInformation & textures, const MaterialInformation & materials) : Mesh(vertices, indices) {
+Mesh::Mesh(std::vector<ModelVertex> vertices, std::vector<uint32_t> indices, 
+           const TextureInformation & textures, const MaterialInformation & materials) : Mesh(std::move(vertices), std::move(indices)) {
     this->textures = textures;
     this->materials = materials;
 }
@@ -173,6 +260,47 @@ const std::vector<uint32_t> & Mesh::getIndices() const {
     return this->indices;
 }
 
+const std::vector<glm::vec3> & Mesh::getPositions() const {
+    return this->positions;
+}
+
+const std::vector<uint32_t> & Mesh::getLodIndices(uint32_t level) const {
+    if (level == 0 || this->lods.empty()) return this->indices;
+    
+    return this->lods[std::min<size_t>(level, this->lods.size()) - 1];
+}
+
+uint32_t Mesh::getVertexCount() const {
+    return this->geometryReleased ? this->vertexCount : static_cast<uint32_t>(this->vertices.size());
+}
+
+uint32_t Mesh::getLodIndexCount(uint32_t level) const {
+    if (this->geometryReleased) return this->lodIndexCounts[std::min<size_t>(level, this->lodIndexCounts.size() - 1)];
+    
+    return static_cast<uint32_t>(this->getLodIndices(level).size());
+}
+
+uint32_t Mesh::getLodCount() const {
+    return static_cast<uint32_t>(this->geometryReleased ? this->lodIndexCounts.size() : this->lods.size() + 1);
+}
+
+VkDeviceSize Mesh::getLodFirstIndex(uint32_t level) const {
+    level = std::min(level, this->getLodCount() - 1);
+    
+    VkDeviceSize firstIndex = 0;
+    for (uint32_t l=0; l<level; l++) firstIndex += this->getLodIndexCount(l);
+
+    return firstIndex;
+}
+
+VkDeviceSize Mesh::getIndexCountForAllLods() const {
+    return this->getLodFirstIndex(this->getLodCount() - 1) + this->getLodIndexCount(this->getLodCount() - 1);
+}
+
+void Mesh::setLods(std::vector<std::vector<uint32_t>> lods) {
+    this->lods = std::move(lods);
+}
+
 void Mesh::setColor(glm::vec4 color) {
     this->materials.diffuseColor = color;
 }
@@ -189,7 +317,7 @@ void Mesh::setName(std::string name) {
     this->name = name;
 }
 
-TextureInformation Mesh::getTextureInformation() {
+const TextureInformation & Mesh::getTextureInformation() const {
     return this->textures;
 }
 
@@ -217,4 +345,68 @@ void Mesh::markAsBoundingBox() {
     this->isBbox = true;
 }
 
+void Mesh::getPositionBounds(glm::vec3 & boundsMin, glm::vec3 & boundsExtent) const {
+    if (this->vertices.empty()) {
+        boundsMin = glm::vec3(0.0f);
+        boundsExtent = glm::vec3(0.0f);
+        return;
+    }
+
+    boundsMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax = glm::vec3(std::numeric_limits<float>::lowest());
 
+    for (auto & v : this->vertices) {
+        boundsMin = glm::min(boundsMin, v.getPosition());
+        boundsMax = glm::max(boundsMax, v.getPosition());
+    }
+
+    boundsExtent = boundsMax - boundsMin;
+}
+
+VkIndexType Mesh::getIndexType() const {
+    return this->getVertexCount() < 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+VkDeviceSize Mesh::getIndexSize() const {
+    return this->getIndexType() == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+uint32_t Mesh::getGeometryHandle(ModelsContentType modelsContentType) const {
+    return this->geometryHandles[modelsContentType];
+}
+
+void Mesh::setGeometryHandle(ModelsContentType modelsContentType, uint32_t handle) {
+    this->geometryHandles[modelsContentType] = handle;
+}
+
+VkDeviceSize Mesh::releaseGeometry(GeometryRetention retention) {
+    if (this->geometryReleased || retention == RETAIN_ALL) return 0;
+    
+    const VkDeviceSize geometrySize = this->getGeometrySize();
+    
+    // drawing only needs the counts once the content sits in the model buffers
+    this->vertexCount = this->getVertexCount();
+    for (uint32_t l=0; l<this->getLodCount(); l++) this->lodIndexCounts.push_back(this->getLodIndexCount(l));
+    this->geometryReleased = true;
+    
+    if (retention == RETAIN_POSITIONS) {
+        this->positions.reserve(this->vertices.size());
+        for (const ModelVertex & vertex : this->vertices) this->positions.push_back(vertex.getPosition());
+    } else std::vector<uint32_t>().swap(this->indices);
+    
+    std::vector<ModelVertex>().swap(this->vertices);
+    std::vector<std::vector<uint32_t>>().swap(this->lods);
+    
+    if (retention == RETAIN_NONE) this->bbox = BoundingBox();
+    
+    return geometrySize - this->getGeometrySize();
+}
+
+VkDeviceSize Mesh::getGeometrySize() const {
+    VkDeviceSize geometrySize = 
+        this->vertices.capacity() * sizeof(ModelVertex) + this->indices.capacity() * sizeof(uint32_t) + 
+        this->positions.capacity() * sizeof(glm::vec3) + this->lodIndexCounts.capacity() * sizeof(uint32_t);
+    for (const std::vector<uint32_t> & lod : this->lods) geometrySize += lod.capacity() * sizeof(uint32_t);
+    
+    return geometrySize;
+}
@@ -0,0 +1,521 @@
+#include "includes/memory.h"
+
+FreeList::FreeList(VkDeviceSize size) {
+    this->size = size;
+    if (size > 0) this->freeRanges[0] = size;
+}
+
+bool FreeList::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset) {
+    if (alignment == 0) alignment = 1;
+
+    // first fit, the padding in front of an aligned offset stays in the free list
+    for (auto it = this->freeRanges.begin(); it != this->freeRanges.end(); it++) {
+        const VkDeviceSize rangeStart = it->first;
+        const VkDeviceSize rangeEnd = it->first + it->second;
+        const VkDeviceSize alignedStart = (rangeStart + alignment - 1) / alignment * alignment;
+
+        if (alignedStart + size > rangeEnd) continue;
+
+        this->freeRanges.erase(it);
+        if (alignedStart > rangeStart) this->freeRanges[rangeStart] = alignedStart - rangeStart;
+        if (alignedStart + size < rangeEnd) this->freeRanges[alignedStart + size] = rangeEnd - alignedStart - size;
+
+        offset = alignedStart;
+        this->usedSize += size;
+
+        return true;
+    }
+
+    return false;
+}
+
+bool FreeList::allocateAt(VkDeviceSize offset, VkDeviceSize size) {
+    auto it = this->freeRanges.upper_bound(offset);
+    if (it == this->freeRanges.begin()) return false;
+    it--;
+
+    const VkDeviceSize rangeStart = it->first;
+    const VkDeviceSize rangeEnd = it->first + it->second;
+    if (offset + size > rangeEnd) return false;
+
+    this->freeRanges.erase(it);
+    if (offset > rangeStart) this->freeRanges[rangeStart] = offset - rangeStart;
+    if (offset + size < rangeEnd) this->freeRanges[offset + size] = rangeEnd - offset - size;
+
+    this->usedSize += size;
+
+    return true;
+}
+
+void FreeList::free(VkDeviceSize offset, VkDeviceSize size) {
+    if (size == 0) return;
+
+    this->usedSize -= std::min(size, this->usedSize);
+
+    VkDeviceSize rangeStart = offset;
+    VkDeviceSize rangeSize = size;
+
+    auto next = this->freeRanges.lower_bound(offset);
+    if (next != this->freeRanges.end() && rangeStart + rangeSize == next->first) {
+        rangeSize += next->second;
+        next = this->freeRanges.erase(next);
+    }
+
+    if (next != this->freeRanges.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == rangeStart) {
+            previous->second += rangeSize;
+            return;
+        }
+    }
+
+    this->freeRanges[rangeStart] = rangeSize;
+}
+
+void FreeList::grow(VkDeviceSize size) {
+    if (size <= this->size) return;
+
+    const VkDeviceSize oldSize = this->size;
+    this->size = size;
+
+    // free() expects the range to be in use
+    this->usedSize += size - oldSize;
+    this->free(oldSize, size - oldSize);
+}
+
+VkDeviceSize FreeList::getSize() const {
+    return this->size;
+}
+
+VkDeviceSize FreeList::getUsedSize() const {
+    return this->usedSize;
+}
+
+VkDeviceSize FreeList::getLargestFreeRange() const {
+    VkDeviceSize largest = 0;
+    for (auto & range : this->freeRanges) largest = std::max(largest, range.second);
+
+    return largest;
+}
+
+MemoryBlock::MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void * data) : freeList(size) {
+    this->memory = memory;
+    this->data = data;
+}
+
+bool MemoryBlock::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset) {
+    return this->freeList.allocate(size, alignment, offset);
+}
+
+void MemoryBlock::free(VkDeviceSize offset, VkDeviceSize size) {
+    this->freeList.free(offset, size);
+}
+
+bool MemoryBlock::isEmpty() {
+    return this->freeList.getUsedSize() == 0;
+}
+
+VkDeviceMemory MemoryBlock::getMemory() {
+    return this->memory;
+}
+
+VkDeviceSize MemoryBlock::getSize() {
+    return this->freeList.getSize();
+}
+
+VkDeviceSize MemoryBlock::getUsedSize() {
+    return this->freeList.getUsedSize();
+}
+
+void * MemoryBlock::getData() {
+    return this->data;
+}
+
+void MemoryAllocator::init(const VkInstance & instance, const VkPhysicalDevice & physicalDevice, const VkDevice & device, bool supportsMemoryBudget) {
+    this->device = device;
+    this->physicalDevice = physicalDevice;
+
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &this->memoryProperties);
+
+    // VK_EXT_memory_budget is read through VK_KHR_get_physical_device_properties2 on a 1.0 instance
+    if (supportsMemoryBudget) {
+        this->getMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(
+            vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+    }
+
+    this->linearBlocks.resize(this->memoryProperties.memoryTypeCount);
+    this->optimalBlocks.resize(this->memoryProperties.memoryTypeCount);
+    this->heapAllocatedSizes.assign(this->memoryProperties.memoryHeapCount, 0);
+    this->heapBudgetsExceeded.assign(this->memoryProperties.memoryHeapCount, false);
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) {
+    const uint32_t heapIndex = this->memoryProperties.memoryTypes[memoryType].heapIndex;
+    const VkDeviceSize heapSize = this->memoryProperties.memoryHeaps[heapIndex].size;
+
+    // small heaps (e.g. host visible device memory) must not be eaten up by a couple of blocks
+    return std::max(MemoryAllocator::MIN_BLOCK_SIZE, std::min(MemoryAllocator::BLOCK_SIZE, heapSize / 8));
+}
+
+bool MemoryAllocator::allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory & memory, void ** data) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    VkResult ret = vkAllocateMemory(this->device, &allocInfo, nullptr, &memory);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Allocate Device Memory" << std::endl;
+        return false;
+    }
+
+    this->heapAllocatedSizes[this->memoryProperties.memoryTypes[memoryType].heapIndex] += size;
+
+    *data = nullptr;
+    if ((this->memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0) {
+        // host visible memory stays mapped, a block can only be mapped once for all of its allocations
+        ret = vkMapMemory(this->device, memory, 0, VK_WHOLE_SIZE, 0, data);
+        if (ret != VK_SUCCESS) {
+            std::cerr << "Failed to Map Device Memory" << std::endl;
+            this->freeDeviceMemory(memory, size, memoryType);
+            memory = nullptr;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void MemoryAllocator::freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType) {
+    vkFreeMemory(this->device, memory, nullptr);
+
+    VkDeviceSize & heapAllocatedSize = this->heapAllocatedSizes[this->memoryProperties.memoryTypes[memoryType].heapIndex];
+    heapAllocatedSize -= std::min(size, heapAllocatedSize);
+}
+
+std::vector<MemoryHeapBudget> MemoryAllocator::queryHeapBudgets() {
+    std::vector<MemoryHeapBudget> heapBudgets(this->memoryProperties.memoryHeapCount);
+
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties {};
+    budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+    if (this->getMemoryProperties2 != nullptr) {
+        VkPhysicalDeviceMemoryProperties2 properties {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budgetProperties;
+        this->getMemoryProperties2(this->physicalDevice, &properties);
+    }
+
+    for (uint32_t i=0; i<heapBudgets.size(); i++) {
+        MemoryHeapBudget & heapBudget = heapBudgets[i];
+        heapBudget.size = this->memoryProperties.memoryHeaps[i].size;
+        heapBudget.deviceLocal = (this->memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        heapBudget.allocatedSize = this->heapAllocatedSizes[i];
+
+        if (this->getMemoryProperties2 != nullptr) {
+            // the driver's numbers include other processes and the implementation's own allocations
+            heapBudget.budget = budgetProperties.heapBudget[i];
+            heapBudget.usage = budgetProperties.heapUsage[i];
+        } else {
+            // without the extension all we know is what we allocated ourselves
+            heapBudget.budget = static_cast<VkDeviceSize>(heapBudget.size * MemoryAllocator::HEAP_BUDGET_RATIO);
+            heapBudget.usage = heapBudget.allocatedSize;
+        }
+    }
+
+    return heapBudgets;
+}
+
+void MemoryAllocator::checkBudgets(MemoryCategory category, uint32_t heapIndex) {
+    const MemoryStatistics & stats = this->statistics[category];
+    const bool categoryExceeded = stats.budget > 0 && stats.allocatedSize > stats.budget;
+
+    // warn once when crossing, not on every allocation above the budget
+    if (categoryExceeded && !this->budgetsExceeded[category]) {
+        std::cerr << "Memory " << MemoryAllocator::CATEGORY_NAMES[category] << " exceeds its Budget: " <<
+            stats.allocatedSize / MEGA_BYTE << " of " << stats.budget / MEGA_BYTE << " MB" << std::endl;
+    }
+    this->budgetsExceeded[category] = categoryExceeded;
+
+    if (heapIndex >= this->heapBudgetsExceeded.size()) return;
+
+    const MemoryHeapBudget heapBudget = this->queryHeapBudgets()[heapIndex];
+    const bool heapExceeded = heapBudget.usage > heapBudget.budget;
+
+    if (heapExceeded && !this->heapBudgetsExceeded[heapIndex]) {
+        std::cerr << "Memory Heap " << heapIndex << " exceeds its Budget: " <<
+            heapBudget.usage / MEGA_BYTE << " of " << heapBudget.budget / MEGA_BYTE << " MB" << std::endl;
+    }
+    this->heapBudgetsExceeded[heapIndex] = heapExceeded;
+}
+
+bool MemoryAllocator::allocate(
+    const VkMemoryRequirements & requirements, uint32_t memoryType, MemoryCategory category, bool linear, MemoryAllocation & allocation) {
+    if (this->device == nullptr || memoryType >= this->memoryProperties.memoryTypeCount) return false;
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    allocation = MemoryAllocation();
+    allocation.size = requirements.size;
+    allocation.memoryType = memoryType;
+    allocation.category = category;
+    allocation.linear = linear;
+
+    const VkDeviceSize blockSize = this->getBlockSize(memoryType);
+    bool allocatedDeviceMemory = false;
+
+    if (requirements.size > blockSize / 2) {
+        // large resources get a memory object of their own instead of pinning a mostly empty block
+        if (!this->allocateDeviceMemory(requirements.size, memoryType, allocation.memory, &allocation.data)) return false;
+        allocation.dedicated = true;
+        allocatedDeviceMemory = true;
+    } else {
+        auto & blocks = linear ? this->linearBlocks[memoryType] : this->optimalBlocks[memoryType];
+
+        MemoryBlock * block = nullptr;
+        for (auto & b : blocks) {
+            if (b->allocate(requirements.size, requirements.alignment, allocation.offset)) {
+                block = b.get();
+                break;
+            }
+        }
+
+        if (block == nullptr) {
+            VkDeviceMemory memory = nullptr;
+            void * data = nullptr;
+            if (!this->allocateDeviceMemory(blockSize, memoryType, memory, &data)) return false;
+
+            blocks.push_back(std::make_unique<MemoryBlock>(memory, blockSize, data));
+            allocatedDeviceMemory = true;
+            block = blocks.back().get();
+
+            if (!block->allocate(requirements.size, requirements.alignment, allocation.offset)) return false;
+        }
+
+        allocation.memory = block->getMemory();
+        if (block->getData() != nullptr) allocation.data = static_cast<char *>(block->getData()) + allocation.offset;
+    }
+
+    MemoryStatistics & stats = this->statistics[category];
+    stats.allocations++;
+    if (allocation.dedicated) stats.dedicatedAllocations++;
+    stats.allocatedSize += allocation.size;
+    stats.peakAllocatedSize = std::max(stats.peakAllocatedSize, stats.allocatedSize);
+    if (allocation.data != nullptr) stats.hostVisibleSize += allocation.size;
+
+    // heap usage only changes with new memory objects, sub allocations don't have to ask the driver
+    this->checkBudgets(category, allocatedDeviceMemory ? this->memoryProperties.memoryTypes[memoryType].heapIndex : UINT32_MAX);
+
+    return true;
+}
+
+void MemoryAllocator::free(MemoryAllocation & allocation) {
+    if (!allocation.isValid() || this->device == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    MemoryStatistics & stats = this->statistics[allocation.category];
+    stats.allocations--;
+    if (allocation.dedicated) stats.dedicatedAllocations--;
+    stats.allocatedSize -= std::min(allocation.size, stats.allocatedSize);
+    if (allocation.data != nullptr) stats.hostVisibleSize -= std::min(allocation.size, stats.hostVisibleSize);
+    this->budgetsExceeded[allocation.category] = stats.budget > 0 && stats.allocatedSize > stats.budget;
+
+    if (allocation.dedicated) {
+        this->freeDeviceMemory(allocation.memory, allocation.size, allocation.memoryType);
+        allocation = MemoryAllocation();
+        return;
+    }
+
+    auto & blocks = allocation.linear ? this->linearBlocks[allocation.memoryType] : this->optimalBlocks[allocation.memoryType];
+    for (auto it = blocks.begin(); it != blocks.end(); it++) {
+        if ((*it)->getMemory() != allocation.memory) continue;
+
+        (*it)->free(allocation.offset, allocation.size);
+
+        // one empty block per memory type is kept around so that alternating allocations don't thrash
+        if ((*it)->isEmpty() && blocks.size() > 1) {
+            this->freeDeviceMemory((*it)->getMemory(), (*it)->getSize(), allocation.memoryType);
+            blocks.erase(it);
+        }
+        break;
+    }
+
+    allocation = MemoryAllocation();
+}
+
+MemoryStatistics MemoryAllocator::getStatistics(MemoryCategory category) {
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    return this->statistics[category];
+}
+
+std::vector<MemoryHeapBudget> MemoryAllocator::getHeapBudgets() {
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    return this->queryHeapBudgets();
+}
+
+void MemoryAllocator::setBudget(MemoryCategory category, VkDeviceSize budget) {
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    this->statistics[category].budget = budget;
+    this->checkBudgets(category, UINT32_MAX);
+}
+
+bool MemoryAllocator::hasMemoryBudgetSupport() {
+    return this->getMemoryProperties2 != nullptr;
+}
+
+void MemoryAllocator::printStatistics() {
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    for (size_t i=0; i<MEMORY_CATEGORY_COUNT; i++) {
+        std::cout << "Memory " << MemoryAllocator::CATEGORY_NAMES[i] << ": " << this->statistics[i].allocatedSize / MEGA_BYTE << " MB in " <<
+            this->statistics[i].allocations << " allocations (" << this->statistics[i].dedicatedAllocations << " dedicated), peak " <<
+            this->statistics[i].peakAllocatedSize / MEGA_BYTE << " MB, host visible " << this->statistics[i].hostVisibleSize / MEGA_BYTE << " MB";
+        if (this->statistics[i].budget > 0) std::cout << ", budget " << this->statistics[i].budget / MEGA_BYTE << " MB";
+        std::cout << std::endl;
+    }
+
+    const std::vector<MemoryHeapBudget> heapBudgets = this->queryHeapBudgets();
+    for (size_t i=0; i<heapBudgets.size(); i++) {
+        std::cout << "Memory Heap " << i << (heapBudgets[i].deviceLocal ? " (device local)" : "") << ": " <<
+            heapBudgets[i].allocatedSize / MEGA_BYTE << " MB allocated, " << heapBudgets[i].usage / MEGA_BYTE << " MB in use of " <<
+            heapBudgets[i].budget / MEGA_BYTE << " MB budget, " << heapBudgets[i].size / MEGA_BYTE << " MB size" <<
+            (this->hasMemoryBudgetSupport() ? "" : " (estimated)") << std::endl;
+    }
+
+    uint32_t numberOfBlocks = 0;
+    VkDeviceSize blockSize = 0;
+    VkDeviceSize usedSize = 0;
+    for (auto blocks : { &this->linearBlocks, &this->optimalBlocks }) {
+        for (auto & blocksPerType : *blocks) {
+            for (auto & block : blocksPerType) {
+                numberOfBlocks++;
+                blockSize += block->getSize();
+                usedSize += block->getUsedSize();
+            }
+        }
+    }
+
+    std::cout << "Memory Blocks: " << numberOfBlocks << " holding " << blockSize / MEGA_BYTE << " MB, " <<
+        usedSize / MEGA_BYTE << " MB in use" << std::endl;
+}
+
+void MemoryAllocator::destroy() {
+    if (this->device == nullptr) return;
+
+    std::lock_guard<std::mutex> lock(this->lock);
+
+    for (auto blocks : { &this->linearBlocks, &this->optimalBlocks }) {
+        for (uint32_t t=0; t<blocks->size(); t++) {
+            for (auto & block : (*blocks)[t]) this->freeDeviceMemory(block->getMemory(), block->getSize(), t);
+            (*blocks)[t].clear();
+        }
+    }
+
+    this->device = nullptr;
+}
+
+void GeometryArena::reset(VkDeviceSize capacity) {
+    this->freeList = FreeList(capacity);
+    this->ranges.clear();
+    this->freeHandles.clear();
+}
+
+void GeometryArena::grow(VkDeviceSize capacity) {
+    this->freeList.grow(capacity);
+}
+
+bool GeometryArena::allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t & handle) {
+    GeometryRange range;
+    range.size = size;
+    range.alignment = std::max<VkDeviceSize>(1, alignment);
+    range.used = true;
+
+    if (size > 0 && !this->freeList.allocate(size, range.alignment, range.offset)) return false;
+
+    if (this->freeHandles.empty()) {
+        handle = static_cast<uint32_t>(this->ranges.size());
+        this->ranges.push_back(range);
+    } else {
+        handle = this->freeHandles.back();
+        this->freeHandles.pop_back();
+        this->ranges[handle] = range;
+    }
+
+    return true;
+}
+
+void GeometryArena::free(uint32_t handle) {
+    if (handle >= this->ranges.size() || !this->ranges[handle].used) return;
+
+    this->freeList.free(this->ranges[handle].offset, this->ranges[handle].size);
+    this->ranges[handle].used = false;
+    this->freeHandles.push_back(handle);
+}
+
+VkDeviceSize GeometryArena::getOffset(uint32_t handle) const {
+    return handle < this->ranges.size() ? this->ranges[handle].offset : 0;
+}
+
+VkDeviceSize GeometryArena::getSize(uint32_t handle) const {
+    return handle < this->ranges.size() ? this->ranges[handle].size : 0;
+}
+
+VkDeviceSize GeometryArena::getCapacity() const {
+    return this->freeList.getSize();
+}
+
+VkDeviceSize GeometryArena::getUsedSize() const {
+    return this->freeList.getUsedSize();
+}
+
+float GeometryArena::getFragmentation() const {
+    const VkDeviceSize freeSize = this->freeList.getSize() - this->freeList.getUsedSize();
+    if (freeSize == 0) return 0.0f;
+
+    return 1.0f - static_cast<float>(this->freeList.getLargestFreeRange()) / freeSize;
+}
+
+std::vector<GeometryMove> GeometryArena::planCompaction() const {
+    std::vector<GeometryMove> moves;
+
+    for (uint32_t h=0; h<this->ranges.size(); h++) {
+        if (!this->ranges[h].used || this->ranges[h].size == 0) continue;
+        moves.push_back({ h, this->ranges[h].offset, 0, this->ranges[h].size });
+    }
+
+    // keeping the order means ranges only ever move towards the front
+    std::sort(moves.begin(), moves.end(), [](const GeometryMove & a, const GeometryMove & b) { return a.srcOffset < b.srcOffset; });
+
+    VkDeviceSize offset = 0;
+    for (GeometryMove & move : moves) {
+        const VkDeviceSize alignment = this->ranges[move.handle].alignment;
+        move.dstOffset = (offset + alignment - 1) / alignment * alignment;
+        offset = move.dstOffset + move.size;
+    }
+
+    return moves;
+}
+
+void GeometryArena::applyCompaction(const std::vector<GeometryMove> & moves) {
+    this->freeList = FreeList(this->freeList.getSize());
+
+    for (const GeometryMove & move : moves) {
+        GeometryRange & range = this->ranges[move.handle];
+        range.offset = move.dstOffset;
+
+        // ranges freed while the copies were running just stay free
+        if (range.used) this->freeList.allocateAt(range.offset, range.size);
+    }
+}
+
+const uint32_t GeometryArena::INVALID_HANDLE = UINT32_MAX;
+const VkDeviceSize MemoryAllocator::BLOCK_SIZE = 64 * MEGA_BYTE;
+const VkDeviceSize MemoryAllocator::MIN_BLOCK_SIZE = 4 * MEGA_BYTE;
+const float MemoryAllocator::HEAP_BUDGET_RATIO = 0.8f;
+const std::array<std::string, MEMORY_CATEGORY_COUNT> MemoryAllocator::CATEGORY_NAMES = {
+    "Geometry", "Textures", "Staging", "Uniforms", "Attachments"
+};
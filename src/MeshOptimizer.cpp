@@ -0,0 +1,492 @@
+#include <src/includes/models.h>
+
+static uint64_t hashVertex(const ModelVertex & vertex) {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char *>(&vertex);
+
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i=0; i<sizeof(ModelVertex); i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static uint64_t hashPosition(const glm::vec3 & position) {
+    uint32_t bits[3];
+    memcpy(bits, &position, sizeof(bits));
+
+    return (bits[0] * 73856093ULL) ^ (bits[1] * 19349663ULL) ^ (bits[2] * 83492791ULL);
+}
+
+static double evaluateQuadric(const glm::dmat4 & quadric, const glm::vec3 & position) {
+    const glm::dvec4 v(position, 1.0);
+    return glm::dot(v, quadric * v);
+}
+
+void MeshOptimizer::optimize(std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices, const std::string & name) {
+    if (vertices.empty() || indices.empty() || indices.size() % 3 != 0) return;
+
+    const size_t originalVertexCount = vertices.size();
+    const float originalACMR = MeshOptimizer::calculateACMR(indices, vertices.size());
+
+    MeshOptimizer::weldVertices(vertices, indices);
+
+    std::vector<uint32_t> clusters;
+    MeshOptimizer::optimizeVertexCache(indices, vertices.size(), clusters);
+    MeshOptimizer::optimizeOverdraw(vertices, indices, clusters);
+    MeshOptimizer::optimizeVertexFetch(vertices, indices);
+
+    const float optimizedACMR = MeshOptimizer::calculateACMR(indices, vertices.size());
+
+    std::stringstream report;
+    report << "Mesh " << (name.empty() ? "<unnamed>" : name) <<
+        ": vertices " << originalVertexCount << " -> " << vertices.size() <<
+        ", ACMR " << originalACMR << " -> " << optimizedACMR << std::endl;
+    std::cout << report.str();
+}
+
+uint32_t MeshOptimizer::weldVertices(std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices) {
+    size_t tableSize = 1;
+    while (tableSize < vertices.size() * 2) tableSize <<= 1;
+
+    const uint32_t empty = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> table(tableSize, empty);
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<ModelVertex> uniqueVertices;
+    uniqueVertices.reserve(vertices.size());
+
+    for (size_t i=0; i<vertices.size(); i++) {
+        size_t slot = hashVertex(vertices[i]) & (tableSize - 1);
+
+        while (table[slot] != empty && memcmp(&uniqueVertices[table[slot]], &vertices[i], sizeof(ModelVertex)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == empty) {
+            table[slot] = static_cast<uint32_t>(uniqueVertices.size());
+            uniqueVertices.push_back(vertices[i]);
+        }
+
+        remap[i] = table[slot];
+    }
+
+    for (auto & index : indices) index = remap[index];
+
+    const uint32_t removedVertices = static_cast<uint32_t>(vertices.size() - uniqueVertices.size());
+    vertices = std::move(uniqueVertices);
+
+    return removedVertices;
+}
+
+// Tipsify (Sander, Nehab, Barczak - Fast Triangle Reordering for Vertex Locality and Reduced Overdraw)
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t> & indices, const uint32_t vertexCount, std::vector<uint32_t> & clusters) {
+    const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+    const int64_t cacheSize = MeshOptimizer::CACHE_SIZE;
+
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (auto & index : indices) liveTriangles[index]++;
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (uint32_t v=0; v<vertexCount; v++) adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (uint32_t t=0; t<triangleCount; t++) {
+        for (uint32_t c=0; c<3; c++) adjacency[adjacencyFill[indices[t * 3 + c]]++] = t;
+    }
+
+    std::vector<int64_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    clusters.clear();
+
+    int64_t timeStamp = cacheSize + 1;
+    uint32_t cursor = 0;
+    int64_t fanningVertex = 0;
+
+    while (fanningVertex >= 0) {
+        candidates.clear();
+
+        for (uint32_t a=adjacencyOffsets[fanningVertex]; a<adjacencyOffsets[fanningVertex + 1]; a++) {
+            const uint32_t t = adjacency[a];
+            if (emitted[t]) continue;
+
+            for (uint32_t c=0; c<3; c++) {
+                const uint32_t v = indices[t * 3 + c];
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+
+                if (timeStamp - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = timeStamp;
+                    timeStamp++;
+                }
+            }
+
+            emitted[t] = true;
+        }
+
+        int64_t nextVertex = -1;
+        int64_t bestPriority = -1;
+        for (auto & v : candidates) {
+            if (liveTriangles[v] == 0) continue;
+
+            int64_t priority = 0;
+            if (timeStamp - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) priority = timeStamp - cacheTime[v];
+
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                nextVertex = v;
+            }
+        }
+
+        if (nextVertex == -1) {
+            // hard boundary: the cache has nothing left to offer, start a new cluster
+            if (!output.empty()) clusters.push_back(static_cast<uint32_t>(output.size() / 3));
+
+            while (!deadEnds.empty() && nextVertex == -1) {
+                const uint32_t d = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[d] > 0) nextVertex = d;
+            }
+
+            while (nextVertex == -1 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) nextVertex = cursor;
+                cursor++;
+            }
+        }
+
+        fanningVertex = nextVertex;
+    }
+
+    if (clusters.empty() || clusters.back() != triangleCount) clusters.push_back(triangleCount);
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeOverdraw(const std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices, const std::vector<uint32_t> & clusters) {
+    if (clusters.size() < 2) return;
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    std::vector<std::tuple<float, uint32_t, uint32_t>> sortedClusters;
+    std::vector<glm::vec3> clusterCentroids;
+    std::vector<glm::vec3> clusterNormals;
+
+    uint32_t clusterStart = 0;
+    for (auto & clusterEnd : clusters) {
+        glm::vec3 centroid(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+
+        for (uint32_t t=clusterStart; t<clusterEnd; t++) {
+            const glm::vec3 p0 = vertices[indices[t * 3]].getPosition();
+            const glm::vec3 p1 = vertices[indices[t * 3 + 1]].getPosition();
+            const glm::vec3 p2 = vertices[indices[t * 3 + 2]].getPosition();
+
+            const glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+            const float faceArea = glm::length(faceNormal);
+
+            centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+            normal += faceNormal;
+            area += faceArea;
+        }
+
+        meshCentroid += centroid;
+        meshArea += area;
+
+        clusterCentroids.push_back(area > 0.0f ? centroid / area : centroid);
+        clusterNormals.push_back(glm::length(normal) > 0.0f ? glm::normalize(normal) : normal);
+        sortedClusters.push_back(std::make_tuple(0.0f, clusterStart, clusterEnd));
+
+        clusterStart = clusterEnd;
+    }
+
+    if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+    // clusters facing outwards are more likely to occlude the rest, so they go first
+    for (size_t c=0; c<sortedClusters.size(); c++) {
+        std::get<0>(sortedClusters[c]) = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+    }
+
+    std::stable_sort(sortedClusters.begin(), sortedClusters.end(),
+        [](const std::tuple<float, uint32_t, uint32_t> & a, const std::tuple<float, uint32_t, uint32_t> & b) {
+            return std::get<0>(a) > std::get<0>(b);
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    for (auto & cluster : sortedClusters) {
+        output.insert(output.end(), indices.begin() + std::get<1>(cluster) * 3, indices.begin() + std::get<2>(cluster) * 3);
+    }
+
+    indices = std::move(output);
+}
+
+void MeshOptimizer::optimizeVertexFetch(std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices) {
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(vertices.size(), unused);
+
+    std::vector<ModelVertex> orderedVertices;
+    orderedVertices.reserve(vertices.size());
+
+    for (auto & index : indices) {
+        if (remap[index] == unused) {
+            remap[index] = static_cast<uint32_t>(orderedVertices.size());
+            orderedVertices.push_back(vertices[index]);
+        }
+
+        index = remap[index];
+    }
+
+    vertices = std::move(orderedVertices);
+}
+
+float MeshOptimizer::calculateACMR(const std::vector<uint32_t> & indices, const uint32_t vertexCount) {
+    if (indices.size() < 3) return 0.0f;
+
+    std::vector<int64_t> cacheTime(vertexCount, -MeshOptimizer::CACHE_SIZE - 1);
+    int64_t timeStamp = 0;
+    uint32_t misses = 0;
+
+    // FIFO cache simulation
+    for (auto & index : indices) {
+        if (timeStamp - cacheTime[index] > MeshOptimizer::CACHE_SIZE) {
+            cacheTime[index] = timeStamp;
+            timeStamp++;
+            misses++;
+        }
+    }
+
+    return static_cast<float>(misses) / (indices.size() / 3);
+}
+
+std::vector<uint32_t> MeshOptimizer::simplify(
+    const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> & indices,
+    const size_t targetIndexCount, const float targetError, float & resultError) {
+    resultError = 0.0f;
+
+    std::vector<uint32_t> result(indices);
+    if (vertices.empty() || indices.size() <= targetIndexCount || indices.size() % 3 != 0) return result;
+
+    const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+
+    // vertices sharing a position (uv/normal seams) are treated as one for topology and error
+    size_t tableSize = 1;
+    while (tableSize < vertices.size() * 2) tableSize <<= 1;
+
+    const uint32_t empty = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> table(tableSize, empty);
+    std::vector<uint32_t> positionIds(vertexCount);
+    std::vector<uint32_t> wedges;
+
+    glm::vec3 boundsMin(std::numeric_limits<float>::max());
+    glm::vec3 boundsMax(std::numeric_limits<float>::lowest());
+
+    for (uint32_t v=0; v<vertexCount; v++) {
+        const glm::vec3 position = vertices[v].getPosition();
+        boundsMin = glm::min(boundsMin, position);
+        boundsMax = glm::max(boundsMax, position);
+
+        size_t slot = hashPosition(position) & (tableSize - 1);
+        while (table[slot] != empty && vertices[table[slot]].getPosition() != position) slot = (slot + 1) & (tableSize - 1);
+
+        if (table[slot] == empty) {
+            table[slot] = v;
+            positionIds[v] = static_cast<uint32_t>(wedges.size());
+            wedges.push_back(0);
+        } else positionIds[v] = positionIds[table[slot]];
+
+        wedges[positionIds[v]]++;
+    }
+
+    const uint32_t positionCount = static_cast<uint32_t>(wedges.size());
+    const float errorLimit = targetError * glm::length(boundsMax - boundsMin);
+
+    // open borders and seams are locked so that the silhouette and the attributes stay intact
+    std::unordered_map<uint64_t, uint32_t> edges;
+    for (size_t t=0; t<result.size(); t+=3) {
+        for (uint32_t e=0; e<3; e++) {
+            const uint64_t a = positionIds[result[t + e]];
+            const uint64_t b = positionIds[result[t + (e + 1) % 3]];
+            edges[a < b ? (a << 32) | b : (b << 32) | a]++;
+        }
+    }
+
+    std::vector<bool> locked(positionCount, false);
+    for (uint32_t p=0; p<positionCount; p++) locked[p] = wedges[p] > 1;
+    for (auto & edge : edges) {
+        if (edge.second != 1) continue;
+        locked[edge.first >> 32] = true;
+        locked[edge.first & 0xFFFFFFFF] = true;
+    }
+
+    std::vector<glm::dmat4> quadrics(positionCount, glm::dmat4(0.0));
+    std::vector<double> quadricWeights(positionCount, 0.0);
+    for (size_t t=0; t<result.size(); t+=3) {
+        const glm::vec3 p0 = vertices[result[t]].getPosition();
+        const glm::vec3 p1 = vertices[result[t + 1]].getPosition();
+        const glm::vec3 p2 = vertices[result[t + 2]].getPosition();
+
+        glm::dvec3 normal = glm::cross(glm::dvec3(p1 - p0), glm::dvec3(p2 - p0));
+        const double area = glm::length(normal);
+        if (area <= 0.0) continue;
+
+        normal /= area;
+        const glm::dvec4 plane(normal, -glm::dot(normal, glm::dvec3(p0)));
+        const glm::dmat4 quadric = glm::outerProduct(plane, plane) * (area * 0.5);
+
+        for (uint32_t c=0; c<3; c++) {
+            quadrics[positionIds[result[t + c]]] += quadric;
+            quadricWeights[positionIds[result[t + c]]] += area * 0.5;
+        }
+    }
+
+    std::vector<std::tuple<float, uint32_t, uint32_t>> collapses;
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+    std::vector<uint32_t> adjacency;
+    std::vector<bool> used(positionCount);
+    std::vector<uint32_t> remap(vertexCount);
+
+    while (result.size() > targetIndexCount) {
+        collapses.clear();
+
+        for (size_t t=0; t<result.size(); t+=3) {
+            for (uint32_t e=0; e<3; e++) {
+                for (uint32_t d=0; d<2; d++) {
+                    const uint32_t from = result[t + (d == 0 ? e : (e + 1) % 3)];
+                    const uint32_t to = result[t + (d == 0 ? (e + 1) % 3 : e)];
+                    const uint32_t fromId = positionIds[from];
+                    const uint32_t toId = positionIds[to];
+                    if (locked[fromId] || fromId == toId) continue;
+
+                    const double weight = quadricWeights[fromId] + quadricWeights[toId];
+                    const double error = weight > 0.0 ? 
+                        (evaluateQuadric(quadrics[fromId], vertices[to].getPosition()) + evaluateQuadric(quadrics[toId], vertices[to].getPosition())) / weight : 0.0;
+
+                    collapses.push_back(std::make_tuple(static_cast<float>(std::sqrt(std::max(error, 0.0))), from, to));
+                }
+            }
+        }
+
+        if (collapses.empty()) break;
+        std::sort(collapses.begin(), collapses.end());
+
+        std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+        for (auto & index : result) adjacencyOffsets[index + 1]++;
+        for (uint32_t v=0; v<vertexCount; v++) adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+        adjacency.resize(result.size());
+        std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i=0; i<result.size(); i++) adjacency[adjacencyFill[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+        std::fill(used.begin(), used.end(), false);
+        for (uint32_t v=0; v<vertexCount; v++) remap[v] = v;
+
+        // an interior collapse removes 2 triangles
+        const size_t collapsesNeeded = (result.size() - targetIndexCount) / 6 + 1;
+        size_t collapsesDone = 0;
+
+        for (auto & collapse : collapses) {
+            const float error = std::get<0>(collapse);
+            const uint32_t from = std::get<1>(collapse);
+            const uint32_t to = std::get<2>(collapse);
+
+            if (error > errorLimit || collapsesDone >= collapsesNeeded) break;
+            if (used[positionIds[from]] || used[positionIds[to]]) continue;
+
+            const glm::vec3 target = vertices[to].getPosition();
+            bool flips = false;
+            for (uint32_t a=adjacencyOffsets[from]; a<adjacencyOffsets[from + 1] && !flips; a++) {
+                const uint32_t * triangle = &result[adjacency[a] * 3];
+                if (positionIds[triangle[0]] == positionIds[to] || positionIds[triangle[1]] == positionIds[to] || 
+                    positionIds[triangle[2]] == positionIds[to]) continue;
+
+                glm::vec3 before[3], after[3];
+                for (uint32_t c=0; c<3; c++) {
+                    before[c] = vertices[triangle[c]].getPosition();
+                    after[c] = triangle[c] == from ? target : before[c];
+                }
+
+                const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                flips = glm::dot(normalBefore, normalAfter) <= 0.0f;
+            }
+            if (flips) continue;
+
+            remap[from] = to;
+            quadrics[positionIds[to]] += quadrics[positionIds[from]];
+            quadricWeights[positionIds[to]] += quadricWeights[positionIds[from]];
+
+            // the whole 1-ring changes shape, keep it out of this pass
+            for (uint32_t a=adjacencyOffsets[from]; a<adjacencyOffsets[from + 1]; a++) {
+                for (uint32_t c=0; c<3; c++) used[positionIds[result[adjacency[a] * 3 + c]]] = true;
+            }
+
+            resultError = std::max(resultError, error);
+            collapsesDone++;
+        }
+
+        if (collapsesDone == 0) break;
+
+        size_t writeIndex = 0;
+        for (size_t t=0; t<result.size(); t+=3) {
+            const uint32_t a = remap[result[t]];
+            const uint32_t b = remap[result[t + 1]];
+            const uint32_t c = remap[result[t + 2]];
+            if (positionIds[a] == positionIds[b] || positionIds[b] == positionIds[c] || positionIds[a] == positionIds[c]) continue;
+
+            result[writeIndex++] = a;
+            result[writeIndex++] = b;
+            result[writeIndex++] = c;
+        }
+        result.resize(writeIndex);
+    }
+
+    return result;
+}
+
+std::vector<std::vector<uint32_t>> MeshOptimizer::generateLods(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> & indices, const std::string & name) {
+    std::vector<std::vector<uint32_t>> lods;
+    lods.reserve(MeshOptimizer::LOD_TARGET_RATIOS.size());
+    if (indices.size() / 3 < MeshOptimizer::LOD_MIN_TRIANGLES || indices.size() % 3 != 0) return lods;
+
+    const std::vector<uint32_t> * previous = &indices;
+    for (size_t l=0; l<MeshOptimizer::LOD_TARGET_RATIOS.size(); l++) {
+        float error = 0.0f;
+        const size_t targetIndexCount = static_cast<size_t>(indices.size() / 3 * MeshOptimizer::LOD_TARGET_RATIOS[l]) * 3;
+        std::vector<uint32_t> lod = MeshOptimizer::simplify(vertices, *previous, targetIndexCount, MeshOptimizer::LOD_TARGET_ERRORS[l], error);
+
+        // not worth the extra indices if it hardly simplified
+        if (lod.empty() || lod.size() > previous->size() * 9 / 10) break;
+
+        std::vector<uint32_t> clusters;
+        MeshOptimizer::optimizeVertexCache(lod, vertices.size(), clusters);
+
+        lods.push_back(std::move(lod));
+        previous = &lods.back();
+    }
+
+    if (!lods.empty()) {
+        std::stringstream report;
+        report << "Mesh " << (name.empty() ? "<unnamed>" : name) << ": LOD triangles " << indices.size() / 3;
+        for (auto & lod : lods) report << " / " << lod.size() / 3;
+        report << std::endl;
+        std::cout << report.str();
+    }
+
+    return lods;
+}
+
+const int64_t MeshOptimizer::CACHE_SIZE = 16;
+const size_t MeshOptimizer::LOD_MIN_TRIANGLES = 128;
+const std::array<float, 3> MeshOptimizer::LOD_TARGET_RATIOS = { 0.5f, 0.25f, 0.125f };
+const std::array<float, 3> MeshOptimizer::LOD_TARGET_ERRORS = { 0.01f, 0.03f, 0.08f };
@@ -0,0 +1,365 @@
+#include <src/includes/models.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static_assert(std::is_trivially_copyable<ModelVertex>::value, "ModelVertex has to be trivially copyable to be cached");
+static_assert(std::is_trivially_copyable<MaterialInformation>::value, "MaterialInformation has to be trivially copyable to be cached");
+
+struct ModelCacheHeader final {
+    char magic[4] = { 'V', 'T', 'M', 'C' };
+    uint32_t version = 0;
+    uint32_t importFlags = 0;
+    uint32_t vertexSize = sizeof(ModelVertex);
+    uint32_t materialSize = sizeof(MaterialInformation);
+    uint32_t meshCount = 0;
+    int64_t sourceModificationTime = 0;
+    uint64_t sourceSize = 0;
+};
+
+class ModelCacheReader final {
+    private:
+        const char * data = nullptr;
+        uint64_t size = 0;
+        uint64_t offset = 0;
+
+    public:
+        ModelCacheReader(const char * data, const uint64_t size) : data(data), size(size) {};
+
+        const char * read(const uint64_t length) {
+            if (this->offset + length > this->size) return nullptr;
+            const char * ptr = this->data + this->offset;
+            this->offset += length;
+            return ptr;
+        }
+
+        bool readString(std::string & value) {
+            const char * length = this->read(sizeof(uint32_t));
+            if (length == nullptr) return false;
+
+            uint32_t stringLength = 0;
+            memcpy(&stringLength, length, sizeof(uint32_t));
+
+            const char * chars = this->read(stringLength);
+            if (chars == nullptr) return false;
+
+            value.assign(chars, stringLength);
+            return true;
+        }
+
+        void align() {
+            this->offset = (this->offset + 7) & ~static_cast<uint64_t>(7);
+        }
+};
+
+bool ModelCache::readSourceStamp(const std::filesystem::path & file, int64_t & modificationTime, uint64_t & size) {
+    std::error_code error;
+
+    const std::filesystem::file_time_type lastWrite = std::filesystem::last_write_time(file, error);
+    if (error) return false;
+
+    size = std::filesystem::file_size(file, error);
+    if (error) return false;
+
+    modificationTime = static_cast<int64_t>(lastWrite.time_since_epoch().count());
+
+    return true;
+}
+
+static void writeString(std::ofstream & out, const std::string & value) {
+    const uint32_t length = static_cast<uint32_t>(value.size());
+    out.write(reinterpret_cast<const char *>(&length), sizeof(uint32_t));
+    out.write(value.data(), length);
+}
+
+static void writeAlignment(std::ofstream & out) {
+    const char padding[8] = {};
+    const uint64_t position = static_cast<uint64_t>(out.tellp());
+    const uint64_t remainder = position % 8;
+    if (remainder != 0) out.write(padding, 8 - remainder);
+}
+
+MappedFile::MappedFile(const std::filesystem::path & file) {
+    std::error_code error;
+    
+    const uint64_t fileSize = std::filesystem::file_size(file, error);
+    if (error || fileSize == 0) return;
+
+#ifndef _WIN32
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) return;
+
+    void * mappedData = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (mappedData == MAP_FAILED) return;
+
+    this->data = static_cast<char *>(mappedData);
+    this->mapped = true;
+#else
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) return;
+    
+    this->data = new char[fileSize];
+    if (!in.read(this->data, fileSize)) {
+        delete [] this->data;
+        this->data = nullptr;
+        return;
+    }
+#endif
+
+    this->size = fileSize;
+}
+
+MappedFile::~MappedFile() {
+    if (this->data == nullptr) return;
+    
+#ifndef _WIN32
+    if (this->mapped) munmap(this->data, this->size);
+#endif
+    if (!this->mapped) delete [] this->data;
+    
+    this->data = nullptr;
+}
+
+bool MappedFile::isValid() {
+    return this->data != nullptr;
+}
+
+const char * MappedFile::getData() {
+    return this->data;
+}
+
+uint64_t MappedFile::getSize() {
+    return this->size;
+}
+
+std::filesystem::path ModelCache::getCacheFile(const std::filesystem::path & file, const std::string & extension) {
+    return file.parent_path() / ModelCache::CACHE_DIRECTORY / (file.filename().string() + extension);
+}
+
+bool ModelCache::load(const std::filesystem::path & file, const uint32_t importFlags, std::vector<Mesh> & meshes) {
+    const std::filesystem::path cacheFile = ModelCache::getCacheFile(file);
+
+    std::error_code error;
+    int64_t sourceModificationTime = 0;
+    uint64_t sourceSize = 0;
+
+    if (!std::filesystem::is_regular_file(cacheFile, error) || !ModelCache::readSourceStamp(file, sourceModificationTime, sourceSize)) {
+        ModelCache::misses++;
+        return false;
+    }
+
+    MappedFile mappedFile(cacheFile);
+    if (!mappedFile.isValid() || mappedFile.getSize() < sizeof(ModelCacheHeader)) {
+        ModelCache::misses++;
+        return false;
+    }
+
+    ModelCacheReader reader(mappedFile.getData(), mappedFile.getSize());
+
+    ModelCacheHeader expected;
+    expected.version = ModelCache::VERSION;
+    expected.importFlags = importFlags;
+
+    ModelCacheHeader header;
+    memcpy(&header, reader.read(sizeof(ModelCacheHeader)), sizeof(ModelCacheHeader));
+
+    bool ret = memcmp(header.magic, expected.magic, sizeof(header.magic)) == 0 &&
+        header.version == expected.version && header.importFlags == expected.importFlags &&
+        header.vertexSize == expected.vertexSize && header.materialSize == expected.materialSize &&
+        header.sourceModificationTime == sourceModificationTime && header.sourceSize == sourceSize;
+
+    std::vector<Mesh> cachedMeshes;
+    if (ret) cachedMeshes.reserve(header.meshCount);
+
+    for (uint32_t i=0; ret && i<header.meshCount; i++) {
+        const char * counts = reader.read(2 * sizeof(uint32_t));
+        const char * material = reader.read(sizeof(MaterialInformation));
+        const char * box = reader.read(sizeof(BoundingBox));
+
+        if (counts == nullptr || material == nullptr || box == nullptr) {
+            ret = false;
+            break;
+        }
+
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+        memcpy(&vertexCount, counts, sizeof(uint32_t));
+        memcpy(&indexCount, counts + sizeof(uint32_t), sizeof(uint32_t));
+
+        MaterialInformation materials;
+        memcpy(&materials, material, sizeof(MaterialInformation));
+
+        BoundingBox bbox;
+        memcpy(&bbox, box, sizeof(BoundingBox));
+
+        std::string name;
+        TextureInformation textures;
+        if (!reader.readString(name) || !reader.readString(textures.ambientTextureLocation) ||
+            !reader.readString(textures.diffuseTextureLocation) || !reader.readString(textures.specularTextureLocation) ||
+            !reader.readString(textures.normalTextureLocation)) {
+                ret = false;
+                break;
+        }
+
+        reader.align();
+        const ModelVertex * vertices = reinterpret_cast<const ModelVertex *>(reader.read(static_cast<uint64_t>(vertexCount) * sizeof(ModelVertex)));
+        reader.align();
+        const uint32_t * indices = reinterpret_cast<const uint32_t *>(reader.read(static_cast<uint64_t>(indexCount) * sizeof(uint32_t)));
+
+        const char * lodCountData = reader.read(sizeof(uint32_t));
+
+        if ((vertexCount > 0 && vertices == nullptr) || (indexCount > 0 && indices == nullptr) || lodCountData == nullptr) {
+            ret = false;
+            break;
+        }
+
+        uint32_t lodCount = 0;
+        memcpy(&lodCount, lodCountData, sizeof(uint32_t));
+
+        std::vector<std::vector<uint32_t>> lods;
+        for (uint32_t l=0; ret && l<lodCount; l++) {
+            const char * lodIndexCountData = reader.read(sizeof(uint32_t));
+            if (lodIndexCountData == nullptr) {
+                ret = false;
+                break;
+            }
+
+            uint32_t lodIndexCount = 0;
+            memcpy(&lodIndexCount, lodIndexCountData, sizeof(uint32_t));
+
+            const char * lodIndices = reader.read(static_cast<uint64_t>(lodIndexCount) * sizeof(uint32_t));
+            if (lodIndexCount > 0 && lodIndices == nullptr) {
+                ret = false;
+                break;
+            }
+
+            std::vector<uint32_t> lod(lodIndexCount);
+            memcpy(lod.data(), lodIndices, static_cast<size_t>(lodIndexCount) * sizeof(uint32_t));
+            lods.push_back(std::move(lod));
+        }
+        if (!ret) break;
+
+        Mesh mesh = Mesh(
+            std::vector<ModelVertex>(vertices, vertices + vertexCount),
+            std::vector<uint32_t>(indices, indices + indexCount),
+            textures, materials);
+        mesh.setName(name);
+        mesh.setBoundingBox(bbox);
+        mesh.setLods(std::move(lods));
+
+        cachedMeshes.push_back(std::move(mesh));
+    }
+
+    if (!ret) {
+        ModelCache::misses++;
+        return false;
+    }
+
+    meshes = std::move(cachedMeshes);
+    ModelCache::hits++;
+
+    return true;
+}
+
+bool ModelCache::store(const std::filesystem::path & file, const uint32_t importFlags, std::vector<Mesh> & meshes) {
+    ModelCacheHeader header;
+    header.version = ModelCache::VERSION;
+    header.importFlags = importFlags;
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+
+    if (!ModelCache::readSourceStamp(file, header.sourceModificationTime, header.sourceSize)) {
+        std::cerr << "Failed to read Model Source Stamp for Cache" << std::endl;
+        return false;
+    }
+
+    const std::filesystem::path cacheFile = ModelCache::getCacheFile(file);
+    const std::filesystem::path tmpFile = cacheFile.string() + ".tmp";
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheFile.parent_path(), error);
+    if (error) {
+        std::cerr << "Failed to create Model Cache Directory " << cacheFile.parent_path() << std::endl;
+        return false;
+    }
+
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Failed to write Model Cache " << tmpFile << std::endl;
+        return false;
+    }
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(ModelCacheHeader));
+
+    for (Mesh & m : meshes) {
+        const uint32_t counts[2] = { static_cast<uint32_t>(m.getVertices().size()), static_cast<uint32_t>(m.getIndices().size()) };
+        const MaterialInformation materials = m.getMaterialInformation();
+        const TextureInformation textures = m.getTextureInformation();
+
+        out.write(reinterpret_cast<const char *>(counts), sizeof(counts));
+        out.write(reinterpret_cast<const char *>(&materials), sizeof(MaterialInformation));
+        out.write(reinterpret_cast<const char *>(&m.getBoundingBox()), sizeof(BoundingBox));
+
+        writeString(out, m.getName());
+        writeString(out, textures.ambientTextureLocation);
+        writeString(out, textures.diffuseTextureLocation);
+        writeString(out, textures.specularTextureLocation);
+        writeString(out, textures.normalTextureLocation);
+
+        writeAlignment(out);
+        out.write(reinterpret_cast<const char *>(m.getVertices().data()), m.getVertices().size() * sizeof(ModelVertex));
+        writeAlignment(out);
+        out.write(reinterpret_cast<const char *>(m.getIndices().data()), m.getIndices().size() * sizeof(uint32_t));
+
+        const uint32_t lodCount = m.getLodCount() - 1;
+        out.write(reinterpret_cast<const char *>(&lodCount), sizeof(uint32_t));
+        for (uint32_t l=1; l<=lodCount; l++) {
+            const std::vector<uint32_t> & lodIndices = m.getLodIndices(l);
+            const uint32_t lodIndexCount = static_cast<uint32_t>(lodIndices.size());
+            out.write(reinterpret_cast<const char *>(&lodIndexCount), sizeof(uint32_t));
+            out.write(reinterpret_cast<const char *>(lodIndices.data()), lodIndices.size() * sizeof(uint32_t));
+        }
+    }
+
+    out.close();
+
+    if (out.fail()) {
+        std::cerr << "Failed to write Model Cache " << tmpFile << std::endl;
+        std::filesystem::remove(tmpFile, error);
+        return false;
+    }
+
+    std::filesystem::rename(tmpFile, cacheFile, error);
+    if (error) {
+        std::cerr << "Failed to move Model Cache into place " << cacheFile << std::endl;
+        std::filesystem::remove(tmpFile, error);
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t ModelCache::getHits() {
+    return ModelCache::hits;
+}
+
+uint32_t ModelCache::getMisses() {
+    return ModelCache::misses;
+}
+
+void ModelCache::resetStatistics() {
+    ModelCache::hits = 0;
+    ModelCache::misses = 0;
+}
+
+std::atomic<uint32_t> ModelCache::hits(0);
+std::atomic<uint32_t> ModelCache::misses(0);
+
+const uint32_t ModelCache::VERSION = 3;
+const std::string ModelCache::CACHE_DIRECTORY = ".cache";
+const std::string ModelCache::CACHE_EXTENSION = ".mcache";
+const std::string ModelCache::COOKED_TEXTURE_EXTENSION = ".vttx";
@@ -3,16 +3,22 @@
 Model::Model(const std::vector< ModelVertex >& vertices, const std::vector< uint32_t > indices, std::string id) : Model(id)
 {
     this->file = "";
-    this->meshes = { Mesh(vertices, indices) };
+    this->meshes.emplace_back(vertices, indices);
     this->loaded = true;
 }
 
 Model::Model(const std::string id, const  std::filesystem::path file) : Model(id) {
     this->file = file;
+    
+    if (ModelCache::load(this->file, MODEL_IMPORT_FLAGS, this->meshes)) {
+        this->calculateBoundingBoxForModel(DEBUG_BBOX);
+        this->loaded = true;
+        return;
+    }
+    
     Assimp::Importer importer;
 
-    const aiScene *scene = importer.ReadFile(this->file.c_str(),
-            aiProcess_Triangulate | aiProcess_GenBoundingBoxes | aiProcess_CalcTangentSpace | aiProcess_FlipUVs | aiProcess_GenSmoothNormals);
+    const aiScene *scene = importer.ReadFile(this->file.c_str(), MODEL_IMPORT_FLAGS);
 
     if (scene == nullptr) {
         std::cerr << importer.GetErrorString() << std::endl;
@@ -22,6 +28,8 @@ Model::Model(const std::string id, const  std::filesystem::path file) : Model(id
     if (scene->HasMeshes()) {
         this->processNode(scene->mRootNode, scene);
         
+        ModelCache::store(this->file, MODEL_IMPORT_FLAGS, this->meshes);
+        
         this->calculateBoundingBoxForModel(DEBUG_BBOX);
                 
         this->loaded = true;
@@ -104,13 +112,35 @@ void Model::calculateBoundingBoxForModel(bool addBboxMesh) {
     mesh.setColor(glm::vec4(1.0f));
     mesh.setOpacity(0.3);
     mesh.markAsBoundingBox();
-    this->meshes.push_back(mesh);
+    this->meshes.push_back(std::move(mesh));
 }
 
 std::vector<Mesh> & Model::getMeshes() {
     return this->meshes;
 }
 
+GeometryRetention Model::getGeometryRetention() {
+    return this->geometryRetention;
+}
+
+void Model::setGeometryRetention(GeometryRetention geometryRetention) {
+    this->geometryRetention = geometryRetention;
+}
+
+VkDeviceSize Model::releaseGeometry() {
+    VkDeviceSize releasedSize = 0;
+    for (Mesh & mesh : this->meshes) releasedSize += mesh.releaseGeometry(this->geometryRetention);
+    
+    return releasedSize;
+}
+
+VkDeviceSize Model::getGeometrySize() {
+    VkDeviceSize geometrySize = 0;
+    for (const Mesh & mesh : this->meshes) geometrySize += mesh.getGeometrySize();
+    
+    return geometrySize;
+}
+
 bool Model::hasBeenLoaded() {
     return this->loaded;
 };
@@ -125,7 +155,7 @@ std::string Model::getId() {
 
 Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
      std::vector<ModelVertex> vertices;
-     std::vector<unsigned int> indices;
+     std::vector<uint32_t> indices;
      TextureInformation textures;
      MaterialInformation materials;
 
@@ -192,8 +222,12 @@ Mesh Model::processMesh(const aiMesh *mesh, const aiScene *scene) {
          for(unsigned int j = 0; j < face.mNumIndices; j++) indices.push_back(face.mIndices[j]);
      }
 
-     Mesh m = Mesh(vertices, indices, textures, materials);
+     MeshOptimizer::optimize(vertices, indices, name);
+     std::vector<std::vector<uint32_t>> lods = MeshOptimizer::generateLods(vertices, indices, name);
+
+     Mesh m = Mesh(std::move(vertices), std::move(indices), textures, materials);
      m.setName(name);
+     m.setLods(std::move(lods));
      
      BoundingBox bbox = {
         glm::vec3(mesh->mAABB.mMin.x, mesh->mAABB.mMin.y, mesh->mAABB.mMin.z),
@@ -222,12 +256,6 @@ void Models::addModel(Model* model)
 {
     if (!model->hasBeenLoaded()) return;
 
-    auto & meshes = model->getMeshes();
-    for (Mesh & m : meshes) {
-        this->processTextures(m);
-        TextureInformation info =  m.getTextureInformation();
-    }
-    
     this->models.push_back(std::unique_ptr<Model>(model));    
 }
 
@@ -257,7 +285,7 @@ void Models::addTextModel(std::string id, std::string font, std::string text, ui
                 std::unique_ptr<Model> m(Models::createPlaneModel(id, extent));
                 if (m != nullptr && m->hasBeenLoaded()) {
                     
-                    tex->setId(this->textures.size());
+                    tex->setId(this->findFreeTextureId());
                     tex->setPath(m->getId());
 
                     TextureInformation texInfo;
@@ -369,6 +397,31 @@ Model * Models::createPlaneModel(std::string id, VkExtent2D extent) {
     return m.release();
 }
 
+std::vector<Model *> Models::importModels(const std::vector<std::tuple<std::string, std::filesystem::path>> & modelFiles) {
+    std::vector<Model *> models(modelFiles.size(), nullptr);
+    if (modelFiles.empty()) return models;
+    
+    // hand out the biggest files first so that one large import does not end up last on a worker
+    std::vector<size_t> importOrder(modelFiles.size());
+    std::vector<uintmax_t> fileSizes(modelFiles.size(), 0);
+    for (size_t i=0; i<modelFiles.size(); i++) {
+        std::error_code error;
+        importOrder[i] = i;
+        fileSizes[i] = std::filesystem::file_size(std::get<1>(modelFiles[i]), error);
+        if (error) fileSizes[i] = 0;
+    }
+    std::stable_sort(importOrder.begin(), importOrder.end(), [&fileSizes](const size_t & a, const size_t & b) {
+        return fileSizes[a] > fileSizes[b];
+    });
+    
+    WorkerPool::run(importOrder.size(), [&modelFiles, &models, &importOrder](const size_t next) {
+        const size_t i = importOrder[next];
+        models[i] = new Model(std::get<0>(modelFiles[i]), std::get<1>(modelFiles[i]));
+    });
+    
+    return models;
+}
+
 VkImageView Models::findTextureImageViewById(int id) {
     for (auto & t : this->textures) {
         if (t.second->getId() == id) return t.second->getTextureImageView();
@@ -377,68 +430,143 @@ VkImageView Models::findTextureImageViewById(int id) {
     return nullptr;
 }
 
-void Models::processTextures(Mesh & mesh) {
-    TextureInformation textureInfo = mesh.getTextureInformation();
+void Models::processTextures() {
+    std::vector<Model *> allModels;
+    for (auto & model : this->models) allModels.push_back(model.get());
     
-    std::map<std::string, std::unique_ptr<Texture>>::iterator val;
+    this->loadTextures(allModels);
+}
+
+std::vector<Texture *> Models::processTextures(Model * model) {
+    if (model == nullptr) return std::vector<Texture *>();
     
-    if (!textureInfo.ambientTextureLocation.empty()) {
-        val = this->textures.find(textureInfo.ambientTextureLocation);
-        if (val == this->textures.end()) {
-            std::unique_ptr<Texture> texture = std::make_unique<Texture>();
-            texture->setPath(textureInfo.ambientTextureLocation);
-            texture->load();
-            if (texture->isValid()) {
-                textureInfo.ambientTexture = static_cast<int>(this->textures.empty() ? 0 : this->textures.size());
-                texture->setId(textureInfo.ambientTexture);
-                this->textures[textureInfo.ambientTextureLocation] = std::move(texture);
+    return this->loadTextures({ model });
+}
+
+std::vector<Texture *> Models::loadTextures(const std::vector<Model *> & models) {
+    std::vector<std::string> pendingLocations;
+    std::vector<std::unique_ptr<Texture>> pendingTextures;
+    std::vector<Texture *> loadedTextures;
+    
+    for (auto & model : models) {
+        for (Mesh & mesh : model->getMeshes()) {
+            TextureInformation textureInfo = mesh.getTextureInformation();
+            
+            for (const std::string & location : { textureInfo.ambientTextureLocation, textureInfo.diffuseTextureLocation,
+                                                  textureInfo.specularTextureLocation, textureInfo.normalTextureLocation }) {
+                if (location.empty() || this->textures.find(location) != this->textures.end() ||
+                    std::find(pendingLocations.begin(), pendingLocations.end(), location) != pendingLocations.end()) continue;
+                
+                std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+                texture->setPath(location);
+                // a per texture cap wins over the global default
+                auto topMipLevel = this->textureTopMipLevels.find(location);
+                texture->setTopMipLevel(topMipLevel != this->textureTopMipLevels.end() ? topMipLevel->second : this->textureTopMipLevel);
+                
+                pendingLocations.push_back(location);
+                pendingTextures.push_back(std::move(texture));
             }
         }
     }
-
-    if (!textureInfo.diffuseTextureLocation.empty()) {
-        val = this->textures.find(textureInfo.diffuseTextureLocation);
-        if (val == this->textures.end()) {
-            std::unique_ptr<Texture> texture = std::make_unique<Texture>();
-            texture->setPath(textureInfo.diffuseTextureLocation);
-            texture->load();
-            if (texture->isValid()) {
-                textureInfo.diffuseTexture = static_cast<int>(this->textures.empty() ? 0 : this->textures.size());
-                texture->setId(textureInfo.diffuseTexture);
-                this->textures[textureInfo.diffuseTextureLocation] = std::move(texture);
-            }
+    
+    WorkerPool::run(pendingTextures.size(), [&pendingTextures](const size_t i) {
+        pendingTextures[i]->load();
+    });
+    
+    for (size_t i=0; i<pendingTextures.size(); i++) {
+        if (!pendingTextures[i]->isValid()) continue;
+        
+        pendingTextures[i]->setId(this->findFreeTextureId());
+        loadedTextures.push_back(pendingTextures[i].get());
+        this->textures[pendingLocations[i]] = std::move(pendingTextures[i]);
+    }
+    
+    for (auto & model : models) {
+        for (Mesh & mesh : model->getMeshes()) {
+            TextureInformation textureInfo = mesh.getTextureInformation();
+            
+            textureInfo.ambientTexture = this->findTextureId(textureInfo.ambientTextureLocation);
+            textureInfo.diffuseTexture = this->findTextureId(textureInfo.diffuseTextureLocation);
+            textureInfo.specularTexture = this->findTextureId(textureInfo.specularTextureLocation);
+            textureInfo.normalTexture = this->findTextureId(textureInfo.normalTextureLocation);
+            
+            mesh.setTextureInformation(textureInfo);
         }
     }
+    
+    return loadedTextures;
+}
 
-    if (!textureInfo.specularTextureLocation.empty()) {
-        val = this->textures.find(textureInfo.specularTextureLocation);
-        if (val == this->textures.end()) {
-            std::unique_ptr<Texture> texture = std::make_unique<Texture>();
-            texture->setPath(textureInfo.specularTextureLocation);
-            texture->load();
-            if (texture->isValid()) {
-                textureInfo.specularTexture = static_cast<int>(this->textures.empty() ? 0 : this->textures.size());
-                texture->setId(textureInfo.specularTexture);
-                this->textures[textureInfo.specularTextureLocation] = std::move(texture);
-            }
-        }
+void Models::setTextureTopMipLevel(const uint32_t & topMipLevel) {
+    this->textureTopMipLevel = topMipLevel;
+}
+
+void Models::setTextureTopMipLevel(const std::string & location, const uint32_t & topMipLevel) {
+    this->textureTopMipLevels[location] = topMipLevel;
+}
+
+int Models::findTextureId(const std::string & location) {
+    if (location.empty()) return -1;
+    
+    auto texture = this->textures.find(location);
+    if (texture == this->textures.end()) return -1;
+    
+    return texture->second->getId();
+}
+
+int Models::findFreeTextureId() {
+    // ids of removed textures are handed out again so that the sampler array stays dense
+    std::vector<bool> usedIds(this->textures.size(), false);
+    for (auto & texture : this->textures) {
+        const int id = texture.second->getId();
+        if (id >= 0 && id < static_cast<int>(usedIds.size())) usedIds[id] = true;
+    }
+    
+    for (size_t i=0; i<usedIds.size(); i++) {
+        if (!usedIds[i]) return static_cast<int>(i);
     }
+    
+    return static_cast<int>(usedIds.size());
+}
+
+std::unique_ptr<Model> Models::removeModel(std::string id) {
+    for (auto it = this->models.begin(); it != this->models.end(); it++) {
+        if ((*it)->getId().compare(id) != 0) continue;
+        
+        std::unique_ptr<Model> model = std::move(*it);
+        this->models.erase(it);
+        return model;
+    }
+    
+    return nullptr;
+}
 
-    if (!textureInfo.normalTextureLocation.empty()) {
-        val = this->textures.find(textureInfo.normalTextureLocation);
-        if (val == this->textures.end()) {
-            std::unique_ptr<Texture> texture = std::make_unique<Texture>();
-            texture->setPath(textureInfo.normalTextureLocation);
-            texture->load();
-            if (texture->isValid()) {
-                textureInfo.normalTexture = static_cast<int>(this->textures.empty() ? 0 : this->textures.size());
-                texture->setId(textureInfo.normalTexture);
-                this->textures[textureInfo.normalTextureLocation] = std::move(texture);
+std::vector<std::unique_ptr<Texture>> Models::releaseUnusedTextures() {
+    std::vector<std::unique_ptr<Texture>> unusedTextures;
+    
+    std::set<std::string> usedLocations;
+    for (auto & model : this->models) {
+        for (Mesh & mesh : model->getMeshes()) {
+            TextureInformation textureInfo = mesh.getTextureInformation();
+            
+            for (const std::string & location : { textureInfo.ambientTextureLocation, textureInfo.diffuseTextureLocation,
+                                                  textureInfo.specularTextureLocation, textureInfo.normalTextureLocation }) {
+                if (!location.empty()) usedLocations.insert(location);
             }
         }
     }
     
-    mesh.setTextureInformation(textureInfo);
+    for (auto it = this->textures.begin(); it != this->textures.end();) {
+        if (it->first.compare(Models::DUMMY_TEXTURE) == 0 || usedLocations.find(it->first) != usedLocations.end()) {
+            it++;
+            continue;
+        }
+        
+        unusedTextures.push_back(std::move(it->second));
+        it = this->textures.erase(it);
+    }
+    
+    return unusedTextures;
 }
 
 std::vector<std::unique_ptr<Model>> & Models::getModels() {
@@ -452,14 +580,6 @@ Model * Models::findModel(std::string id) {
     return nullptr;
 }
 
-void Model::setSsboOffset(VkDeviceSize offset) {
-    this->ssboOffset = offset;
-}
-
-VkDeviceSize Model::getSsboOffset() {
-    return this->ssboOffset;
-}
-
 
 TextureInformation Model::addTextures(const aiMaterial * mat) {
     TextureInformation textureInfo;
@@ -544,9 +664,9 @@ void Models::setColor(glm::vec4 color) {
     }
 }
 
-void Models::cleanUpTextures(const VkDevice & device) {
+void Models::cleanUpTextures(const VkDevice & device, MemoryAllocator & allocator) {
     for (auto & texture : this->textures) {
-        texture.second->cleanUpTexture(device);
+        texture.second->cleanUpTexture(device, allocator);
     }
 }
 
@@ -558,3 +678,5 @@ const std::string Models::AMBIENT_TEXTURE = "ambient";
 const std::string Models::DIFFUSE_TEXTURE = "diffuse";
 const std::string Models::SPECULAR_TEXTURE = "specular";
 const std::string Models::TEXTURE_NORMALS = "normals";
+const std::string Models::DUMMY_TEXTURE = "dummy";
+const std::array<std::string, GEOMETRY_RETENTION_COUNT> Model::GEOMETRY_RETENTION_NAMES = { "All", "Positions", "Collision", "None" };
@@ -3,16 +3,20 @@
 bool Graphics::createSkyboxDescriptorPool() {
     std::array<VkDescriptorPoolSize, 2> poolSizes{};
 
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(this->swapChainImages.size());
+    // the sets are replaced when the frame data grows, the old ones live on until no frame in flight uses them
+    const uint32_t numberOfSets = static_cast<uint32_t>(this->swapChainImages.size() * DESCRIPTOR_SET_GENERATIONS);
+
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = numberOfSets;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(this->swapChainImages.size());
+    poolSizes[1].descriptorCount = numberOfSets;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+    poolInfo.maxSets = numberOfSets;
 
     VkResult ret = vkCreateDescriptorPool(device, &poolInfo, nullptr, &this->skyboxDescriptorPool);
     ASSERT_VULKAN(ret);
@@ -30,7 +34,7 @@ bool Graphics::createSkyboxDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding modelUniformLayoutBinding{};
     modelUniformLayoutBinding.binding = 0;
     modelUniformLayoutBinding.descriptorCount = 1;
-    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     modelUniformLayoutBinding.pImmutableSamplers = nullptr;
     modelUniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     layoutBindings.push_back(modelUniformLayoutBinding);
@@ -81,7 +85,7 @@ bool Graphics::createSkyboxDescriptorSets() {
 
     for (size_t i = 0; i < this->skyboxDescriptorSets.size(); i++) {
         VkDescriptorBufferInfo uniformBufferInfo{};
-        uniformBufferInfo.buffer = this->uniformBuffers[i];
+        uniformBufferInfo.buffer = this->frameDataBuffer;
         uniformBufferInfo.offset = 0;
         uniformBufferInfo.range = sizeof(struct ModelUniforms);
 
@@ -92,7 +96,7 @@ bool Graphics::createSkyboxDescriptorSets() {
         uniformDescriptorSet.dstSet = this->skyboxDescriptorSets[i];
         uniformDescriptorSet.dstBinding = 0;
         uniformDescriptorSet.dstArrayElement = 0;
-        uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uniformDescriptorSet.descriptorCount = 1;
         uniformDescriptorSet.pBufferInfo = &uniformBufferInfo;
         descriptorWrites.push_back(uniformDescriptorSet);
@@ -282,20 +286,6 @@ bool Graphics::createSkybox() {
 
     VkDeviceSize bufferSize = SKYBOX_VERTICES.size() * sizeof(class SimpleVertex);
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    if (!this->createBuffer(bufferSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory)) {
-        std::cerr << "Failed to get Create Skybox Staging Buffer" << std::endl;
-        return false;
-    }
-
-    void* data = nullptr;
-    vkMapMemory(this->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, SKYBOX_VERTICES.data(), bufferSize);
-    vkUnmapMemory(this->device, stagingBufferMemory);
-
     if (!this->createBuffer(
             bufferSize,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -304,29 +294,10 @@ bool Graphics::createSkybox() {
         return false;
     }
 
-    this->copyBuffer(stagingBuffer,this->skyBoxVertexBuffer, bufferSize);
-
-    vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-    vkFreeMemory(this->device, stagingBufferMemory, nullptr);
-    
-    stagingBuffer = nullptr;
-    stagingBufferMemory = nullptr;
-    VkDeviceSize skyboxCubeSize = skyboxCubeTextures.size() * skyboxCubeTextures[0]->getSize();
-    
-    if (!this->createBuffer(
-        skyboxCubeSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory)) {
-            std::cerr << "Failed to Create Skybox Staging Buffer" << std::endl;
-            return false;
-    }
-
-    data = nullptr;
-    VkDeviceSize offset = 0;
-    vkMapMemory(device, stagingBufferMemory, 0, skyboxCubeSize, 0, &data);
-    for (auto & tex : skyboxCubeTextures) {
-        memcpy(static_cast<char *>(data) + offset, tex->getPixels(), tex->getSize());
-        offset += tex->getSize();
+    if (!this->uploadToBuffer(this->skyBoxVertexBuffer, 0, SKYBOX_VERTICES.data(), bufferSize)) {
+        std::cerr << "Failed to Upload Skybox Vertices" << std::endl;
+        return false;
     }
-    vkUnmapMemory(device, stagingBufferMemory);
 
     if (!this->createImage(
         skyboxCubeTextures[0]->getWidth(), skyboxCubeTextures[0]->getHeight(), skyboxCubeTextures[0]->getImageFormat(), 
@@ -336,18 +307,22 @@ bool Graphics::createSkybox() {
             return false;
     }
 
-    transitionImageLayout(
-        this->skyboxCubeImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, skyboxCubeTextures.size());
+    this->transitionImageLayout(
+        this->getUploadCommandBuffer(), this->skyboxCubeImage, 
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, skyboxCubeTextures.size());
     
-    this->copyBufferToImage(
-        stagingBuffer, this->skyboxCubeImage, skyboxCubeTextures[0]->getWidth(), skyboxCubeTextures[0]->getHeight(), skyboxCubeTextures.size());
+    for (uint16_t i=0; i<skyboxCubeTextures.size(); i++) {
+        if (!this->uploadToImage(
+                this->skyboxCubeImage, skyboxCubeTextures[i]->getPixels(), 
+                { this->getImageCopyRegion(skyboxCubeTextures[i]->getWidth(), skyboxCubeTextures[i]->getHeight(), 0, i) })) {
+            std::cerr << "Failed to Upload Skybox Image" << std::endl;
+            return false;
+        }
+    }
     
-    transitionImageLayout(
-        this->skyboxCubeImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, skyboxCubeTextures.size());
+    if (!this->releaseImageToGraphicsQueue(this->skyboxCubeImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, skyboxCubeTextures.size()) || 
+        !this->flushUploadRing()) return false;
 
-    vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-    vkFreeMemory(this->device, stagingBufferMemory, nullptr);
-    
     this->skyboxImageView = 
         this->createImageView(this->skyboxCubeImage, skyboxCubeTextures[0]->getImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT, skyboxCubeTextures.size());
     if (this->skyboxImageView == nullptr) {
@@ -173,16 +173,20 @@ BufferSummary Graphics::getTerrainBufferSizes() {
 bool Graphics::createTerrainDescriptorPool() {
     std::array<VkDescriptorPoolSize, 2> poolSizes{};
 
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(this->swapChainImages.size());
+    // the sets are replaced when the frame data grows, the old ones live on until no frame in flight uses them
+    const uint32_t numberOfSets = static_cast<uint32_t>(this->swapChainImages.size() * DESCRIPTOR_SET_GENERATIONS);
+
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = numberOfSets;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(this->swapChainImages.size());
+    poolSizes[1].descriptorCount = numberOfSets;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+    poolInfo.maxSets = numberOfSets;
 
     VkResult ret = vkCreateDescriptorPool(device, &poolInfo, nullptr, &this->terrainDescriptorPool);
     ASSERT_VULKAN(ret);
@@ -200,7 +204,7 @@ bool Graphics::createTerrainDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding modelUniformLayoutBinding{};
     modelUniformLayoutBinding.binding = 0;
     modelUniformLayoutBinding.descriptorCount = 1;
-    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     modelUniformLayoutBinding.pImmutableSamplers = nullptr;
     modelUniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     layoutBindings.push_back(modelUniformLayoutBinding);
@@ -238,7 +242,7 @@ bool Graphics::createTerrainDescriptorSets() {
 
     for (size_t i = 0; i < this->terrainDescriptorSets.size(); i++) {
         VkDescriptorBufferInfo uniformBufferInfo{};
-        uniformBufferInfo.buffer = this->uniformBuffers[i];
+        uniformBufferInfo.buffer = this->frameDataBuffer;
         uniformBufferInfo.offset = 0;
         uniformBufferInfo.range = sizeof(struct ModelUniforms);
 
@@ -249,7 +253,7 @@ bool Graphics::createTerrainDescriptorSets() {
         uniformDescriptorSet.dstSet = this->terrainDescriptorSets[i];
         uniformDescriptorSet.dstBinding = 0;
         uniformDescriptorSet.dstArrayElement = 0;
-        uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uniformDescriptorSet.descriptorCount = 1;
         uniformDescriptorSet.pBufferInfo = &uniformBufferInfo;
         descriptorWrites.push_back(uniformDescriptorSet);
@@ -419,20 +423,6 @@ bool Graphics::createTerrain() {
     
     const BufferSummary bufferSizes = this->getTerrainBufferSizes();
     
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    if (!this->createBuffer(bufferSizes.vertexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory)) {
-        std::cerr << "Failed to get Create Terrain Staging Buffer" << std::endl;
-        return false;
-    }
-
-    void* data = nullptr;
-    vkMapMemory(this->device, stagingBufferMemory, 0, bufferSizes.vertexBufferSize, 0, &data);
-    memcpy(data, this->terrain->getVertices().data(), bufferSizes.vertexBufferSize);
-    vkUnmapMemory(this->device, stagingBufferMemory);
-
     if (!this->createBuffer(
             bufferSizes.vertexBufferSize,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -441,24 +431,12 @@ bool Graphics::createTerrain() {
         return false;
     }
 
-    this->copyBuffer(stagingBuffer,this->terrainVertexBuffer, bufferSizes.vertexBufferSize);
-
-    vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-    vkFreeMemory(this->device, stagingBufferMemory, nullptr);
+    if (!this->uploadToBuffer(this->terrainVertexBuffer, 0, this->terrain->getVertices().data(), bufferSizes.vertexBufferSize)) {
+        std::cerr << "Failed to Upload Terrain Vertices" << std::endl;
+        return false;
+    }
 
     if (bufferSizes.indexBufferSize > 0) {        
-        if (!this->createBuffer(bufferSizes.indexBufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer, stagingBufferMemory)) {
-            std::cerr << "Failed to get Create Staging Buffer" << std::endl;
-            return false;
-        }
-
-        data = nullptr;
-        vkMapMemory(this->device, stagingBufferMemory, 0, bufferSizes.indexBufferSize, 0, &data);
-        memcpy(data, this->terrain->getIndices().data(), bufferSizes.indexBufferSize);
-        vkUnmapMemory(this->device, stagingBufferMemory);
-
         if (!this->createBuffer(bufferSizes.indexBufferSize,
                 VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                 this->terrainIndexBuffer, this->terrainIndexBufferMemory)) {
@@ -466,12 +444,14 @@ bool Graphics::createTerrain() {
             return false;
         }
         
-        this->copyBuffer(stagingBuffer,this->terrainIndexBuffer, bufferSizes.indexBufferSize);
-        
-        vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-        vkFreeMemory(this->device, stagingBufferMemory, nullptr);
+        if (!this->uploadToBuffer(this->terrainIndexBuffer, 0, this->terrain->getIndices().data(), bufferSizes.indexBufferSize)) {
+            std::cerr << "Failed to Upload Terrain Indices" << std::endl;
+            return false;
+        }
     }
     
+    if (!this->flushUploadRing()) return false;
+    
     std::chrono::duration<double, std::milli> time_span = std::chrono::high_resolution_clock::now() - start;
     std::cout << "createTerrain: " << time_span.count() <<  std::endl;
 
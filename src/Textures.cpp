@@ -1,5 +1,63 @@
 #include <src/includes/models.h>
 
+static constexpr uint32_t COOKED_TEXTURE_VERSION = 1;
+
+struct CookedTextureHeader final {
+    char magic[4] = { 'V', 'T', 'T', 'X' };
+    uint32_t version = COOKED_TEXTURE_VERSION;
+    uint32_t format = VK_FORMAT_UNDEFINED;
+    uint32_t mipLevels = 0;
+    int64_t sourceModificationTime = 0;
+    uint64_t sourceSize = 0;
+};
+
+struct CookedTextureLevel final {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+static SDL_Surface * halveSurface(SDL_Surface * surface) {
+    const int width = surface->w;
+    const int height = surface->h;
+    const int halfWidth = std::max(1, width / 2);
+    const int halfHeight = std::max(1, height / 2);
+    
+    SDL_PixelFormat * format = surface->format;
+    SDL_Surface * halfSurface = SDL_CreateRGBSurface(
+        0, halfWidth, halfHeight, 32, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+    if (halfSurface == nullptr) {
+        std::cerr << "SDL_CreateRGBSurface Failed (on mip reduction): " << SDL_GetError() << std::endl;
+        return nullptr;
+    }
+    
+    SDL_LockSurface(surface);
+    
+    const uint8_t * src = static_cast<const uint8_t *>(surface->pixels);
+    uint8_t * dst = static_cast<uint8_t *>(halfSurface->pixels);
+    
+    // 2x2 box filter, edge texels are repeated for odd dimensions
+    for (int y=0; y<halfHeight; y++) {
+        const uint8_t * row0 = src + std::min(y * 2, height - 1) * surface->pitch;
+        const uint8_t * row1 = src + std::min(y * 2 + 1, height - 1) * surface->pitch;
+        uint8_t * out = dst + y * halfSurface->pitch;
+        
+        for (int x=0; x<halfWidth; x++) {
+            const int x0 = std::min(x * 2, width - 1) * 4;
+            const int x1 = std::min(x * 2 + 1, width - 1) * 4;
+            
+            for (int c=0; c<4; c++) {
+                out[x * 4 + c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+    
+    SDL_UnlockSurface(surface);
+    
+    return halfSurface;
+}
+
 int Texture::getId() {
     return this->id;
 }
@@ -32,11 +90,40 @@ void Texture::setPath(const std::filesystem::path & path) {
     this->path = path;
 }
 
+void Texture::setTopMipLevel(const uint32_t & topMipLevel) {
+    this->topMipLevel = topMipLevel;
+}
+
+const std::filesystem::path & Texture::getPath() {
+    return this->path;
+}
+
+uint32_t Texture::getTopMipLevel() {
+    return this->topMipLevel;
+}
+
+uint32_t Texture::getMipLevels() {
+    if (this->cookedFile != nullptr) return static_cast<uint32_t>(this->cookedMipLevels.size());
+    
+    const uint32_t maxDimension = std::max(this->getWidth(), this->getHeight());
+    if (maxDimension == 0) return 1;
+    
+    return static_cast<uint32_t>(std::floor(std::log2(maxDimension))) + 1;
+}
+
 void Texture::setTextureImage(VkImage & image) {
     this->textureImage = image;
 }
 
-void Texture::setTextureImageMemory(VkDeviceMemory & imageMemory) {
+VkImage Texture::getTextureImage() {
+    return this->textureImage;
+}
+
+MemoryAllocation & Texture::getTextureImageMemory() {
+    return this->textureImageMemory;
+}
+
+void Texture::setTextureImageMemory(MemoryAllocation & imageMemory) {
     this->textureImageMemory = imageMemory;
 }
 
@@ -46,10 +133,22 @@ void Texture::setTextureImageView(VkImageView & imageView) {
 
 void Texture::load() {
     if (!this->loaded) {
+        if (this->loadCooked(this->topMipLevel)) {
+            this->valid = this->getSize() != 0;
+            this->loaded = true;
+            return;
+        }
+        
         this->textureSurface = IMG_Load(this->path.c_str());
         if (this->textureSurface != nullptr) {
             if (!this->readImageFormat()) {
                 std::cout << "Unsupported Texture Format: " << this->path << std::endl;
+            } else if (this->cook() && this->loadCooked(this->topMipLevel)) {
+                SDL_FreeSurface(this->textureSurface);
+                this->textureSurface = nullptr;
+                this->valid = this->getSize() != 0;
+            } else if (!this->dropTopMipLevels()) {
+                std::cout << "Failed to reduce Texture to top Mip Level: " << this->path << std::endl;
             } else if (this->getSize() != 0) {
                 this->valid = true;
             }
@@ -58,7 +157,61 @@ void Texture::load() {
     }
 }
 
-void Texture::cleanUpTexture(const VkDevice & device) {
+bool Texture::loadMipLevels(uint32_t residentMipLevel) {
+    return this->streamable && this->loadCooked(this->topMipLevel + residentMipLevel);
+}
+
+bool Texture::isStreamable() {
+    return this->streamable;
+}
+
+uint32_t Texture::getResidentMipLevel() {
+    return this->residentMipLevel;
+}
+
+void Texture::setResidentMipLevel(uint32_t residentMipLevel) {
+    this->residentMipLevel = residentMipLevel;
+}
+
+uint32_t Texture::getImageMipLevel() {
+    return this->imageMipLevel;
+}
+
+void Texture::setImageMipLevel(uint32_t imageMipLevel) {
+    this->imageMipLevel = imageMipLevel;
+}
+
+uint32_t Texture::getStreamableMipLevels() {
+    return this->streamableMipLevels;
+}
+
+VkExtent2D Texture::getMipLevelExtent(uint32_t level) {
+    return { std::max<uint32_t>(1, this->streamableWidth >> level), std::max<uint32_t>(1, this->streamableHeight >> level) };
+}
+
+uint32_t Texture::getMipLevelForSize(uint32_t size) {
+    uint32_t level = 0;
+    while (level + 1 < this->streamableMipLevels && 
+           std::max(this->streamableWidth >> level, this->streamableHeight >> level) > size) level++;
+    
+    return level;
+}
+
+VkDeviceSize Texture::getMipChainSize(uint32_t residentMipLevel) {
+    VkDeviceSize size = 0;
+    for (uint32_t level=residentMipLevel; level<std::max<uint32_t>(1, this->streamableMipLevels); level++) {
+        size += static_cast<VkDeviceSize>(std::max<uint32_t>(1, this->streamableWidth >> level)) * 
+            std::max<uint32_t>(1, this->streamableHeight >> level) * 4;
+    }
+    
+    return size;
+}
+
+VkDeviceSize Texture::getResidentSize() {
+    return this->textureImageMemory.size;
+}
+
+void Texture::cleanUpTexture(const VkDevice & device, MemoryAllocator & allocator) {
     if (device == nullptr) return;
     
     if (this->textureImage != nullptr) {
@@ -66,10 +219,7 @@ void Texture::cleanUpTexture(const VkDevice & device) {
         this->textureImage = nullptr;
     }
 
-    if (this->textureImageMemory != nullptr) {
-        vkFreeMemory(device, this->textureImageMemory, nullptr);
-        this->textureImageMemory = nullptr;
-    }
+    allocator.free(this->textureImageMemory);
 
     if (this->textureImageView != nullptr) {
         vkDestroyImageView(device, this->textureImageView, nullptr);
@@ -78,27 +228,37 @@ void Texture::cleanUpTexture(const VkDevice & device) {
 }
 
 uint32_t Texture::getWidth() {
+    if (this->cookedFile != nullptr) return this->cookedMipLevels[0].imageExtent.width;
+    
     return this->textureSurface == nullptr ? 0 : this->textureSurface->w; 
 }
 
 uint32_t Texture::getHeight() {
+    if (this->cookedFile != nullptr) return this->cookedMipLevels[0].imageExtent.height;
+    
     return this->textureSurface == nullptr ? 0 : this->textureSurface->h;     
 }
 
 VkDeviceSize Texture::getSize() {
+    if (this->cookedFile != nullptr) return this->cookedPixelsSize;
+    
     int channels = this->textureSurface == nullptr ? 0 : textureSurface->format->BytesPerPixel;
     return this->getWidth() * this->getHeight() * channels;
 }
 
 void * Texture::getPixels() {
- return this->textureSurface == nullptr ? nullptr : this->textureSurface->pixels;
+    if (this->cookedFile != nullptr) return const_cast<char *>(this->cookedFile->getData()) + this->cookedPixelsOffset;
+    
+    return this->textureSurface == nullptr ? nullptr : this->textureSurface->pixels;
 }
 
 void Texture::freeSurface() {
     if (this->textureSurface != nullptr) {
         SDL_FreeSurface(this->textureSurface);
         this->textureSurface = nullptr;
-    }    
+    }
+    
+    this->cookedFile.reset();
 }
 
 Texture::Texture(bool empty,  VkExtent2D extent) {
@@ -179,3 +339,220 @@ bool Texture::readImageFormat() {
     return true;
 }
 
+
+bool Texture::dropTopMipLevels() {
+    for (uint32_t level=0; level<this->topMipLevel; level++) {
+        if (this->textureSurface->w <= 1 && this->textureSurface->h <= 1) break;
+        
+        SDL_Surface * halfSurface = halveSurface(this->textureSurface);
+        if (halfSurface == nullptr) return false;
+        
+        SDL_FreeSurface(this->textureSurface);
+        this->textureSurface = halfSurface;
+    }
+    
+    return true;
+}
+
+bool Texture::cook() {
+    CookedTextureHeader header;
+    header.format = this->imageFormat;
+    header.mipLevels = this->getMipLevels();
+    
+    if (!ModelCache::readSourceStamp(this->path, header.sourceModificationTime, header.sourceSize)) return false;
+    
+    const std::filesystem::path cookedFile = ModelCache::getCacheFile(this->path, ModelCache::COOKED_TEXTURE_EXTENSION);
+    const std::filesystem::path tmpFile = cookedFile.string() + ".tmp";
+    
+    std::error_code error;
+    std::filesystem::create_directories(cookedFile.parent_path(), error);
+    if (error) {
+        std::cerr << "Failed to create Cooked Texture Directory " << cookedFile.parent_path() << std::endl;
+        return false;
+    }
+    
+    std::ofstream out(tmpFile, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Failed to write Cooked Texture " << tmpFile << std::endl;
+        return false;
+    }
+    
+    std::vector<CookedTextureLevel> levels(header.mipLevels);
+    uint64_t offset = 0;
+    uint32_t width = this->getWidth();
+    uint32_t height = this->getHeight();
+    for (auto & level : levels) {
+        level.offset = offset;
+        level.width = width;
+        level.height = height;
+        level.size = static_cast<uint64_t>(width) * height * 4;
+        offset += level.size;
+        
+        width = std::max<uint32_t>(1, width / 2);
+        height = std::max<uint32_t>(1, height / 2);
+    }
+    
+    out.write(reinterpret_cast<const char *>(&header), sizeof(CookedTextureHeader));
+    out.write(reinterpret_cast<const char *>(levels.data()), levels.size() * sizeof(CookedTextureLevel));
+    
+    bool ret = true;
+    SDL_Surface * level = this->textureSurface;
+    for (uint32_t i=0; i<header.mipLevels; i++) {
+        if (i > 0) {
+            SDL_Surface * halfSurface = halveSurface(level);
+            if (level != this->textureSurface) SDL_FreeSurface(level);
+            level = halfSurface;
+            
+            if (level == nullptr) {
+                ret = false;
+                break;
+            }
+        }
+        
+        SDL_LockSurface(level);
+        for (int y=0; y<level->h; y++) {
+            out.write(static_cast<const char *>(level->pixels) + y * level->pitch, level->w * 4);
+        }
+        SDL_UnlockSurface(level);
+    }
+    if (level != nullptr && level != this->textureSurface) SDL_FreeSurface(level);
+    
+    out.close();
+    
+    if (!ret || out.fail()) {
+        std::cerr << "Failed to write Cooked Texture " << tmpFile << std::endl;
+        std::filesystem::remove(tmpFile, error);
+        return false;
+    }
+    
+    std::filesystem::rename(tmpFile, cookedFile, error);
+    if (error) {
+        std::filesystem::remove(tmpFile, error);
+        return false;
+    }
+    
+    return true;
+}
+
+static std::unique_ptr<MappedFile> openCookedTexture(
+    const std::filesystem::path & path, CookedTextureHeader & header, std::vector<CookedTextureLevel> & levels, uint64_t & dataOffset) {
+    if (path.empty()) return nullptr;
+    
+    const std::filesystem::path cookedFile = ModelCache::getCacheFile(path, ModelCache::COOKED_TEXTURE_EXTENSION);
+    
+    std::error_code error;
+    if (!std::filesystem::is_regular_file(cookedFile, error)) return nullptr;
+    
+    int64_t sourceModificationTime = 0;
+    uint64_t sourceSize = 0;
+    if (!ModelCache::readSourceStamp(path, sourceModificationTime, sourceSize)) return nullptr;
+    
+    std::unique_ptr<MappedFile> mappedFile = std::make_unique<MappedFile>(cookedFile);
+    if (!mappedFile->isValid() || mappedFile->getSize() < sizeof(CookedTextureHeader)) return nullptr;
+    
+    CookedTextureHeader expected;
+    memcpy(&header, mappedFile->getData(), sizeof(CookedTextureHeader));
+    
+    if (memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version ||
+        header.sourceModificationTime != sourceModificationTime || header.sourceSize != sourceSize || header.mipLevels == 0) return nullptr;
+    
+    dataOffset = sizeof(CookedTextureHeader) + header.mipLevels * sizeof(CookedTextureLevel);
+    if (dataOffset > mappedFile->getSize()) return nullptr;
+    
+    levels.resize(header.mipLevels);
+    memcpy(levels.data(), mappedFile->getData() + sizeof(CookedTextureHeader), header.mipLevels * sizeof(CookedTextureLevel));
+    
+    return mappedFile;
+}
+
+bool Texture::loadCooked(uint32_t firstLevel) {
+    CookedTextureHeader header;
+    std::vector<CookedTextureLevel> levels;
+    uint64_t dataOffset = 0;
+    
+    std::unique_ptr<MappedFile> mappedFile = openCookedTexture(this->path, header, levels, dataOffset);
+    if (mappedFile == nullptr) return false;
+    
+    firstLevel = std::min(firstLevel, header.mipLevels - 1);
+    const uint64_t firstLevelOffset = levels[firstLevel].offset;
+    
+    std::vector<VkBufferImageCopy> mipLevels;
+    for (uint32_t i=firstLevel; i<header.mipLevels; i++) {
+        if (dataOffset + levels[i].offset + levels[i].size > mappedFile->getSize()) return false;
+        
+        VkBufferImageCopy region{};
+        region.bufferOffset = levels[i].offset - firstLevelOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i - firstLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = { levels[i].width, levels[i].height, 1 };
+        mipLevels.push_back(region);
+    }
+    
+    this->imageFormat = static_cast<VkFormat>(header.format);
+    this->cookedMipLevels = mipLevels;
+    this->cookedPixelsOffset = dataOffset + firstLevelOffset;
+    this->cookedPixelsSize = levels[header.mipLevels - 1].offset + levels[header.mipLevels - 1].size - firstLevelOffset;
+    this->cookedFile = std::move(mappedFile);
+    
+    if (!this->streamable) {
+        const uint32_t topLevel = std::min(this->topMipLevel, header.mipLevels - 1);
+        this->streamable = true;
+        this->streamableMipLevels = header.mipLevels - topLevel;
+        this->streamableWidth = levels[topLevel].width;
+        this->streamableHeight = levels[topLevel].height;
+    }
+    
+    return true;
+}
+
+bool Texture::readCookedMipLevels(
+    const std::filesystem::path & path, uint32_t topMipLevel, uint32_t firstLevel, uint32_t levelCount, 
+    void * destination, VkDeviceSize size, std::vector<VkBufferImageCopy> & regions) {
+    CookedTextureHeader header;
+    std::vector<CookedTextureLevel> levels;
+    uint64_t dataOffset = 0;
+    
+    std::unique_ptr<MappedFile> mappedFile = openCookedTexture(path, header, levels, dataOffset);
+    if (mappedFile == nullptr || levelCount == 0) return false;
+    
+    // counted from the top level like the streamable levels are
+    firstLevel += std::min(topMipLevel, header.mipLevels - 1);
+    if (firstLevel + levelCount > header.mipLevels) return false;
+    
+    // the levels are stored one after the other, they are copied as one block
+    const uint64_t firstLevelOffset = levels[firstLevel].offset;
+    const uint64_t levelsSize = levels[firstLevel + levelCount - 1].offset + levels[firstLevel + levelCount - 1].size - firstLevelOffset;
+    if (levelsSize > size || dataOffset + firstLevelOffset + levelsSize > mappedFile->getSize()) return false;
+    
+    memcpy(destination, mappedFile->getData() + dataOffset + firstLevelOffset, levelsSize);
+    
+    regions.clear();
+    for (uint32_t i=firstLevel; i<firstLevel + levelCount; i++) {
+        VkBufferImageCopy region{};
+        region.bufferOffset = levels[i].offset - firstLevelOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i - firstLevel;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = { levels[i].width, levels[i].height, 1 };
+        regions.push_back(region);
+    }
+    
+    return true;
+}
+
+bool Texture::hasCookedMipLevels() {
+    return this->cookedFile != nullptr;
+}
+
+std::vector<VkBufferImageCopy> Texture::getCookedMipLevels() {
+    return this->cookedMipLevels;
+}
@@ -1,16 +1,6 @@
 #include "includes/graphics.h"
 
-void Graphics::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = this->beginSingleTimeCommands();
-
-    VkBufferCopy copyRegion{};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    endSingleTimeCommands(commandBuffer);
-}
-
-bool Graphics::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+bool Graphics::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation & bufferMemory) {
     
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -34,32 +24,29 @@ bool Graphics::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemor
         return false;
     }
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = memoryTypeIndex;
-
+    MemoryCategory category = GEOMETRY_MEMORY;
+    if ((usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) != 0) category = UNIFORM_MEMORY;
+    else if (usage == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) category = STAGING_MEMORY;
 
-    ret = vkAllocateMemory(this->device, &allocInfo, nullptr, &bufferMemory);
-    if (ret != VK_SUCCESS) {
-        std::cerr << "Failed to get Allocate Memory for Vertex Buffer" << std::endl;
+    if (!this->memoryAllocator.allocate(memRequirements, memoryTypeIndex, category, true, bufferMemory)) {
+        std::cerr << "Failed to get Allocate Memory for Buffer" << std::endl;
         return false;
     }
 
-    vkBindBufferMemory(this->device, buffer, bufferMemory, 0);
+    vkBindBufferMemory(this->device, buffer, bufferMemory.memory, bufferMemory.offset);
 
     return true;
 }
 
 bool Graphics::createImage(
-    int32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint16_t arrayLayers) {
+    int32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation & imageMemory, uint16_t arrayLayers, uint32_t mipLevels) {
         VkImageCreateInfo imageInfo{};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
         imageInfo.imageType = VK_IMAGE_TYPE_2D;
         imageInfo.extent.width = width;
         imageInfo.extent.height = height;
         imageInfo.extent.depth = 1;
-        imageInfo.mipLevels = 1;
+        imageInfo.mipLevels = mipLevels;
         imageInfo.arrayLayers = arrayLayers;
         imageInfo.format = format;
         imageInfo.tiling = tiling;
@@ -88,29 +75,24 @@ bool Graphics::createImage(
             return false;            
         }
 
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = memoryTypeIndex;
-        
-        ret = vkAllocateMemory(this->device, &allocInfo, nullptr, &imageMemory);
-        ASSERT_VULKAN(ret);
+        MemoryCategory category = 
+            (usage & (VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT)) != 0 ? ATTACHMENT_MEMORY : TEXTURE_MEMORY;
 
-        if (ret != VK_SUCCESS) {
+        if (!this->memoryAllocator.allocate(memRequirements, memoryTypeIndex, category, tiling == VK_IMAGE_TILING_LINEAR, imageMemory)) {
             std::cerr << "Failed to Allocate Image Memory" << std::endl;
             return false;
         }
         
-        vkBindImageMemory(this->device, image, imageMemory, 0);
+        vkBindImageMemory(this->device, image, imageMemory.memory, imageMemory.offset);
         
         return true;
 }
 
-VkCommandBuffer Graphics::beginSingleTimeCommands() {
+VkCommandBuffer Graphics::beginSingleTimeCommands(VkCommandPool commandPool) {
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = this->commandPool;
+    allocInfo.commandPool = commandPool;
     allocInfo.commandBufferCount = 1;
 
     VkCommandBuffer commandBuffer = nullptr;
@@ -139,22 +121,8 @@ VkCommandBuffer Graphics::beginSingleTimeCommands() {
     return commandBuffer;
 }
 
-void Graphics::endSingleTimeCommands(VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
-bool Graphics::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint16_t layerCount) {
-    VkCommandBuffer commandBuffer = this->beginSingleTimeCommands();
+bool Graphics::transitionImageLayout(
+    VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint16_t layerCount, uint32_t mipLevels, uint32_t baseMipLevel) {
     if (commandBuffer == nullptr) return false;
 
     VkImageMemoryBarrier barrier{};
@@ -165,8 +133,8 @@ bool Graphics::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkI
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
     barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = mipLevels;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = layerCount;
 
@@ -208,31 +176,420 @@ bool Graphics::transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkI
         1, &barrier
     );
 
-    this->endSingleTimeCommands(commandBuffer);
-    
     return true;
 }
 
-void Graphics::copyBufferToImage(VkBuffer & buffer, VkImage & image, uint32_t width, uint32_t height, uint16_t layerCount) {
-    VkCommandBuffer commandBuffer = this->beginSingleTimeCommands();
-    if (commandBuffer == nullptr) return;
+bool Graphics::supportsMipMapGeneration(VkFormat format) {
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(this->physicalDevice, format, &formatProperties);
+
+    return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) &&
+        (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_SRC_BIT) &&
+        (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_BLIT_DST_BIT);
+}
+
+bool Graphics::generateMipMaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels) {
+    if (commandBuffer == nullptr) return false;
+
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.levelCount = 1;
+
+    int32_t mipWidth = width;
+    int32_t mipHeight = height;
+
+    for (uint32_t i = 1; i < mipLevels; i++) {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkImageBlit blit{};
+        blit.srcOffsets[0] = { 0, 0, 0 };
+        blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.baseArrayLayer = 0;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[0] = { 0, 0, 0 };
+        blit.dstOffsets[1] = { mipWidth > 1 ? mipWidth / 2 : 1, mipHeight > 1 ? mipHeight / 2 : 1, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.baseArrayLayer = 0;
+        blit.dstSubresource.layerCount = 1;
+
+        vkCmdBlitImage(
+            commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+        vkCmdPipelineBarrier(
+            commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &barrier);
+
+        if (mipWidth > 1) mipWidth /= 2;
+        if (mipHeight > 1) mipHeight /= 2;
+    }
+
+    barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, nullptr, 0, nullptr, 1, &barrier);
+
+    return true;
+}
 
-    std::vector<VkBufferImageCopy> regions;
-    VkBufferImageCopy region;
+VkBufferImageCopy Graphics::getImageCopyRegion(uint32_t width, uint32_t height, uint32_t mipLevel, uint32_t layer) {
+    VkBufferImageCopy region{};
     region.bufferOffset = 0;
     region.bufferRowLength = 0;
     region.bufferImageHeight = 0;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = layerCount;
+    region.imageSubresource.mipLevel = mipLevel;
+    region.imageSubresource.baseArrayLayer = layer;
+    region.imageSubresource.layerCount = 1;
     region.imageOffset = {0, 0, 0};
     region.imageExtent = { width, height, 1};
-    regions.push_back(region);
+    
+    return region;
+}
+
+bool Graphics::hasDedicatedTransferQueue() {
+    return this->transferQueueIndex != this->graphicsQueueIndex;
+}
+
+VkCommandBuffer Graphics::getUploadCommandBuffer() {
+    if (this->uploadTransferCommandBuffer == nullptr) 
+        this->uploadTransferCommandBuffer = this->beginSingleTimeCommands(this->uploadCommandPool);
+    
+    return this->uploadTransferCommandBuffer;
+}
+
+VkCommandBuffer Graphics::getUploadGraphicsCommandBuffer() {
+    if (!this->hasDedicatedTransferQueue()) return this->getUploadCommandBuffer();
+    
+    if (this->uploadGraphicsCommandBuffer == nullptr) 
+        this->uploadGraphicsCommandBuffer = this->beginSingleTimeCommands(this->uploadGraphicsCommandPool);
+    
+    return this->uploadGraphicsCommandBuffer;
+}
+
+bool Graphics::releaseImageToGraphicsQueue(VkImage image, VkImageLayout newLayout, uint16_t layerCount, uint32_t mipLevels, uint32_t baseMipLevel) {
+    VkCommandBuffer transferCommandBuffer = this->getUploadCommandBuffer();
+    VkCommandBuffer graphicsCommandBuffer = this->getUploadGraphicsCommandBuffer();
+    if (transferCommandBuffer == nullptr || graphicsCommandBuffer == nullptr) return false;
+    
+    const bool isShaderReadable = newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    const VkPipelineStageFlags destinationStage = isShaderReadable ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+    
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = newLayout;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = isShaderReadable ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = baseMipLevel;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = layerCount;
+    
+    if (!this->hasDedicatedTransferQueue()) {
+        vkCmdPipelineBarrier(transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        return true;
+    }
+    
+    // the same barrier releases on the transfer queue and acquires on the graphics queue, each side ignores the other's masks
+    barrier.srcQueueFamilyIndex = this->transferQueueIndex;
+    barrier.dstQueueFamilyIndex = this->graphicsQueueIndex;
+    
+    vkCmdPipelineBarrier(
+        transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    vkCmdPipelineBarrier(
+        graphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    
+    return true;
+}
+
+bool Graphics::reserveUploadRing(VkDeviceSize size, VkDeviceSize & offset) {
+    if (size > UPLOAD_RING_SIZE) return false;
+    
+    while (true) {
+        if (this->uploadRingUsed == 0) this->uploadRingHead = this->uploadRingTail = 0;
+        
+        const VkDeviceSize alignedHead = (this->uploadRingHead + UPLOAD_RING_ALIGNMENT - 1) & ~(UPLOAD_RING_ALIGNMENT - 1);
+        bool fits = false;
+        VkDeviceSize start = alignedHead;
+        
+        if (this->uploadRingHead > this->uploadRingTail || this->uploadRingUsed == 0) {
+            // free space is at the end and, once wrapped around, in front of the tail
+            if (alignedHead + size <= UPLOAD_RING_SIZE) fits = true;
+            else if (size <= this->uploadRingTail) {
+                start = 0;
+                fits = true;
+            }
+        } else fits = alignedHead + size <= this->uploadRingTail;
+        
+        if (fits) {
+            if (this->getUploadCommandBuffer() == nullptr) return false;
+            
+            const VkDeviceSize consumed = (start == 0 && this->uploadRingHead > 0 ? UPLOAD_RING_SIZE - this->uploadRingHead : start - this->uploadRingHead) + size;
+            this->uploadRingUsed += consumed;
+            this->uploadRingPending += consumed;
+            this->uploadRingHead = (start + size) % UPLOAD_RING_SIZE;
+            offset = start;
+            
+            return true;
+        }
+        
+        if (this->uploadBatches.empty()) {
+            // everything left in the ring was written but not submitted yet
+            if (this->uploadRingPending == 0 || !this->flushUploadRing()) return false;
+            continue;
+        }
+        
+        VkFence oldestFence = this->uploadBatches.front().fence;
+        if (oldestFence != nullptr) vkWaitForFences(this->device, 1, &oldestFence, VK_TRUE, UINT64_MAX);
+        this->releaseUploadRegions();
+    }
+}
+
+void Graphics::recordUploadCopy(VkBuffer dstBuffer, VkDeviceSize ringOffset, VkDeviceSize dstOffset, VkDeviceSize size) {
+    // consecutive pieces of the same buffer are merged into a single copy region
+    if (this->uploadRingCopyBuffer == dstBuffer && 
+            this->uploadRingCopy.srcOffset + this->uploadRingCopy.size == ringOffset &&
+            this->uploadRingCopy.dstOffset + this->uploadRingCopy.size == dstOffset) {
+        this->uploadRingCopy.size += size;
+        return;
+    }
+    
+    this->recordPendingUploadCopy();
+    
+    this->uploadRingCopyBuffer = dstBuffer;
+    this->uploadRingCopy.srcOffset = ringOffset;
+    this->uploadRingCopy.dstOffset = dstOffset;
+    this->uploadRingCopy.size = size;
+}
+
+void Graphics::recordPendingUploadCopy() {
+    if (this->uploadRingCopyBuffer == nullptr) return;
+    
+    vkCmdCopyBuffer(this->uploadTransferCommandBuffer, this->uploadRingBuffer, this->uploadRingCopyBuffer, 1, &this->uploadRingCopy);
+    
+    if (this->hasDedicatedTransferQueue()) {
+        VkBufferMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = this->transferQueueIndex;
+        barrier.dstQueueFamilyIndex = this->graphicsQueueIndex;
+        barrier.buffer = this->uploadRingCopyBuffer;
+        barrier.offset = this->uploadRingCopy.dstOffset;
+        barrier.size = this->uploadRingCopy.size;
+        this->uploadBufferBarriers.push_back(barrier);
+    }
+    
+    this->uploadRingCopyBuffer = nullptr;
+}
+
+bool Graphics::uploadToBuffer(VkBuffer buffer, VkDeviceSize dstOffset, const void * data, VkDeviceSize size) {
+    for (VkDeviceSize uploaded = 0; uploaded < size; uploaded += UPLOAD_RING_CHUNK_SIZE) {
+        const VkDeviceSize chunkSize = std::min(UPLOAD_RING_CHUNK_SIZE, size - uploaded);
+        
+        VkDeviceSize ringOffset = 0;
+        if (!this->reserveUploadRing(chunkSize, ringOffset)) return false;
+        
+        memcpy(static_cast<char *>(this->uploadRingData) + ringOffset, static_cast<const char *>(data) + uploaded, chunkSize);
+        this->recordUploadCopy(buffer, ringOffset, dstOffset + uploaded, chunkSize);
+    }
+    
+    return true;
+}
+
+bool Graphics::uploadToImage(VkImage image, const void * pixels, const std::vector<VkBufferImageCopy> & regions) {
+    for (const VkBufferImageCopy & region : regions) {
+        const VkDeviceSize rowSize = static_cast<VkDeviceSize>(region.imageExtent.width) * TEXEL_SIZE;
+        const VkDeviceSize layerSize = rowSize * region.imageExtent.height;
+        uint32_t rowsPerChunk = static_cast<uint32_t>(std::max<VkDeviceSize>(1, UPLOAD_RING_CHUNK_SIZE / rowSize));
+        
+        // bands have to start at multiples of the transfer queue's granularity, a granularity of 0 allows whole levels only
+        const uint32_t granularity = this->transferImageGranularity.height;
+        if (granularity == 0) rowsPerChunk = region.imageExtent.height;
+        else if (rowsPerChunk > granularity) rowsPerChunk -= rowsPerChunk % granularity;
+        else rowsPerChunk = granularity;
+        
+        // big levels are streamed as bands of rows
+        for (uint32_t l=0; l<region.imageSubresource.layerCount; l++) {
+            for (uint32_t row=0; row<region.imageExtent.height; row += rowsPerChunk) {
+                const uint32_t rows = std::min(rowsPerChunk, region.imageExtent.height - row);
+                
+                VkDeviceSize ringOffset = 0;
+                if (!this->reserveUploadRing(rows * rowSize, ringOffset)) return false;
+                
+                memcpy(
+                    static_cast<char *>(this->uploadRingData) + ringOffset, 
+                    static_cast<const char *>(pixels) + region.bufferOffset + l * layerSize + row * rowSize, rows * rowSize);
+                
+                VkBufferImageCopy band = region;
+                band.bufferOffset = ringOffset;
+                band.bufferRowLength = 0;
+                band.bufferImageHeight = 0;
+                band.imageSubresource.baseArrayLayer = region.imageSubresource.baseArrayLayer + l;
+                band.imageSubresource.layerCount = 1;
+                band.imageOffset.y = region.imageOffset.y + row;
+                band.imageExtent.height = rows;
+                
+                vkCmdCopyBufferToImage(
+                    this->uploadTransferCommandBuffer, this->uploadRingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &band);
+            }
+        }
+    }
+    
+    return true;
+}
 
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+bool Graphics::flushUploadRing() {
+    if (this->uploadTransferCommandBuffer == nullptr && this->uploadGraphicsCommandBuffer == nullptr) return true;
+    
+    this->recordPendingUploadCopy();
+    
+    UploadBatch batch;
+    batch.transferCommandBuffer = this->getUploadCommandBuffer();
+    batch.ringSize = this->uploadRingPending;
+    if (batch.transferCommandBuffer == nullptr) return false;
+
+    if (this->hasDedicatedTransferQueue()) {
+        if (!this->uploadBufferBarriers.empty()) {
+            vkCmdPipelineBarrier(
+                batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 
+                0, nullptr, this->uploadBufferBarriers.size(), this->uploadBufferBarriers.data(), 0, nullptr);
+            VkCommandBuffer graphicsCommandBuffer = this->getUploadGraphicsCommandBuffer();
+            if (graphicsCommandBuffer != nullptr) vkCmdPipelineBarrier(
+                graphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 
+                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 
+                0, nullptr, this->uploadBufferBarriers.size(), this->uploadBufferBarriers.data(), 0, nullptr);
+            this->uploadBufferBarriers.clear();
+        }
+        batch.graphicsCommandBuffer = this->uploadGraphicsCommandBuffer;
+    } else {
+        // later submissions fall into the second scope of the barrier, so they see the copied data without any waiting here
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = 
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT | 
+            VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            batch.transferCommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    
+    this->uploadTransferCommandBuffer = nullptr;
+    this->uploadGraphicsCommandBuffer = nullptr;
+    this->uploadRingPending = 0;
+    
+    vkEndCommandBuffer(batch.transferCommandBuffer);
+    if (batch.graphicsCommandBuffer != nullptr) vkEndCommandBuffer(batch.graphicsCommandBuffer);
+    
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkResult ret = vkCreateFence(this->device, &fenceInfo, nullptr, &batch.fence);
+    
+    if (ret == VK_SUCCESS && batch.graphicsCommandBuffer != nullptr) {
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        ret = vkCreateSemaphore(this->device, &semaphoreInfo, nullptr, &batch.semaphore);
+    }
+    
+    if (ret == VK_SUCCESS) {
+        // the graphics side waits for the copies and carries the fence, it signalling means the whole batch is done
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.transferCommandBuffer;
+        submitInfo.signalSemaphoreCount = batch.semaphore != nullptr ? 1 : 0;
+        submitInfo.pSignalSemaphores = &batch.semaphore;
+
+        ret = vkQueueSubmit(this->transferQueue, 1, &submitInfo, batch.semaphore != nullptr ? VK_NULL_HANDLE : batch.fence);
+        
+        if (ret == VK_SUCCESS && batch.graphicsCommandBuffer != nullptr) {
+            const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            
+            VkSubmitInfo graphicsSubmitInfo{};
+            graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            graphicsSubmitInfo.waitSemaphoreCount = 1;
+            graphicsSubmitInfo.pWaitSemaphores = &batch.semaphore;
+            graphicsSubmitInfo.pWaitDstStageMask = &waitStage;
+            graphicsSubmitInfo.commandBufferCount = 1;
+            graphicsSubmitInfo.pCommandBuffers = &batch.graphicsCommandBuffer;
+            
+            ret = vkQueueSubmit(this->graphicsQueue, 1, &graphicsSubmitInfo, batch.fence);
+            
+            // the copies are on their way, only the fence can't be relied upon anymore
+            if (ret != VK_SUCCESS) vkQueueWaitIdle(this->transferQueue);
+        }
+    }
+    
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to Submit Uploads" << std::endl;
+        if (batch.fence != nullptr) vkDestroyFence(this->device, batch.fence, nullptr);
+        batch.fence = nullptr;
+        this->uploadBatches.push_back(batch);
+        this->submittedUploadBatches++;
+        return false;
+    }
+    
+    this->uploadBatches.push_back(batch);
+    this->submittedUploadBatches++;
+    
+    return true;
+}
 
-    endSingleTimeCommands(commandBuffer);    
+void Graphics::releaseUploadRegions(bool wait) {
+    while (!this->uploadBatches.empty()) {
+        UploadBatch & batch = this->uploadBatches.front();
+        
+        if (batch.fence != nullptr) {
+            if (wait) vkWaitForFences(this->device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            else if (vkGetFenceStatus(this->device, batch.fence) != VK_SUCCESS) break;
+            
+            vkDestroyFence(this->device, batch.fence, nullptr);
+        }
+        if (batch.semaphore != nullptr) vkDestroySemaphore(this->device, batch.semaphore, nullptr);
+        if (batch.transferCommandBuffer != nullptr) 
+            vkFreeCommandBuffers(this->device, this->uploadCommandPool, 1, &batch.transferCommandBuffer);
+        if (batch.graphicsCommandBuffer != nullptr) 
+            vkFreeCommandBuffers(this->device, this->uploadGraphicsCommandPool, 1, &batch.graphicsCommandBuffer);
+        
+        this->uploadRingUsed -= batch.ringSize;
+        this->uploadRingTail = (this->uploadRingTail + batch.ringSize) % UPLOAD_RING_SIZE;
+        this->uploadBatches.pop_front();
+        this->completedUploadBatches++;
+    }
 }
 
 bool Graphics::createTextureSampler(VkSampler & sampler, VkSamplerAddressMode addressMode) {
@@ -253,6 +610,9 @@ bool Graphics::createTextureSampler(VkSampler & sampler, VkSamplerAddressMode ad
     samplerInfo.compareEnable = VK_FALSE;
     samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
     samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    samplerInfo.mipLodBias = 0.0f;
+    samplerInfo.minLod = 0.0f;
+    samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
     VkResult ret = vkCreateSampler(this->device, &samplerInfo, nullptr, &sampler);
     if (ret != VK_SUCCESS) {
@@ -263,61 +623,84 @@ bool Graphics::createTextureSampler(VkSampler & sampler, VkSamplerAddressMode ad
     return true;
 }
 
-void Graphics::copyModelsContentIntoBuffer(void* data, ModelsContentType modelsContentType, VkDeviceSize maxSize) {
-    VkDeviceSize overallSize = 0;
-    
-    auto & allModels = this->models.getModels();
-    
-    for (auto & model : allModels) {
-        if (modelsContentType == SSBO) {
-            model->setSsboOffset(overallSize);
-        }
-
-        for (Mesh & mesh : model->getMeshes()) {            
-            VkDeviceSize dataSize = 0;
-            switch(modelsContentType) {
-                case INDEX:
-                    dataSize = mesh.getIndices().size() * sizeof(uint32_t);
-                    if (overallSize + dataSize <= maxSize) {
-                        memcpy(static_cast<char *>(data) + overallSize, mesh.getIndices().data(), dataSize);
-                        overallSize += dataSize;
-                    }
-                    break;
-                case VERTEX:
-                    dataSize = mesh.getVertices().size() * sizeof(class ModelVertex);
-                    if (overallSize + dataSize <= maxSize) {
-                        memcpy(static_cast<char *>(data)+overallSize, mesh.getVertices().data(), dataSize);
-                        overallSize += dataSize;
-                    }
-                    break;
-                case SSBO:
-                    TextureInformation textureInfo = mesh.getTextureInformation();
-                    MaterialInformation materialInfo = mesh.getMaterialInformation();
-                    MeshProperties modelProps = { 
-                        textureInfo.ambientTexture,
-                        textureInfo.diffuseTexture,
-                        textureInfo.specularTexture,
-                        textureInfo.normalTexture,
-                        materialInfo.ambientColor,
-                        materialInfo.emissiveFactor,
-                        materialInfo.diffuseColor,
-                        materialInfo.opacity,
-                        materialInfo.specularColor,
-                        materialInfo.shininess
-                    };
-                    
-                    dataSize = sizeof(struct MeshProperties);             
-                    if (overallSize + dataSize <= maxSize) {
-                        memcpy(static_cast<char *>(data)+overallSize, &modelProps, dataSize);
-                        overallSize += dataSize;
-                    }
-                    break;
+void Graphics::copyMeshContentIntoBuffer(Mesh & mesh, void* data, ModelsContentType modelsContentType) {
+    switch(modelsContentType) {
+        case INDEX:
+        {
+            // lods follow the full resolution indices back to back
+            char * lodData = static_cast<char *>(data);
+            for (uint32_t l=0; l<mesh.getLodCount(); l++) {
+                const std::vector<uint32_t> & lodIndices = mesh.getLodIndices(l);
+                if (mesh.getIndexType() == VK_INDEX_TYPE_UINT16) {
+                    uint16_t * indices = reinterpret_cast<uint16_t *>(lodData);
+                    for (auto & index : lodIndices) *indices++ = static_cast<uint16_t>(index);
+                } else memcpy(lodData, lodIndices.data(), lodIndices.size() * sizeof(uint32_t));
+                lodData += lodIndices.size() * mesh.getIndexSize();
             }
+            break;
         }
+        case VERTEX:
+        {
+            glm::vec3 boundsMin, boundsExtent;
+            mesh.getPositionBounds(boundsMin, boundsExtent);
+
+            PackedModelVertex * vertices = static_cast<PackedModelVertex *>(data);
+            for (auto & vertex : mesh.getVertices()) *vertices++ = PackedModelVertex(vertex, boundsMin, boundsExtent);
+            break;
+        }
+        case SSBO:
+            glm::vec3 boundsMin, boundsExtent;
+            mesh.getPositionBounds(boundsMin, boundsExtent);
+            
+            TextureInformation textureInfo = mesh.getTextureInformation();
+            MaterialInformation materialInfo = mesh.getMaterialInformation();
+            MeshProperties modelProps = { 
+                textureInfo.ambientTexture,
+                textureInfo.diffuseTexture,
+                textureInfo.specularTexture,
+                textureInfo.normalTexture,
+                materialInfo.ambientColor,
+                materialInfo.emissiveFactor,
+                materialInfo.diffuseColor,
+                materialInfo.opacity,
+                materialInfo.specularColor,
+                materialInfo.shininess,
+                glm::vec4(boundsMin, 0.0f),
+                glm::vec4(boundsExtent, 1.0f)
+            };
+            
+            memcpy(data, &modelProps, sizeof(struct MeshProperties));
+            break;
+    }
+}
+
+VkDeviceSize Graphics::getMeshContentSize(const Mesh & mesh, ModelsContentType modelsContentType) {
+    switch(modelsContentType) {
+        case INDEX:
+            return mesh.getIndexCountForAllLods() * mesh.getIndexSize();
+        case VERTEX:
+            return mesh.getVertices().size() * sizeof(class PackedModelVertex);
+        case SSBO:
+        default:
+            return sizeof(struct MeshProperties);
+    }
+}
+
+VkDeviceSize Graphics::getMeshContentAlignment(const Mesh & mesh, ModelsContentType modelsContentType) {
+    // vertex and ssbo ranges are addressed by element index in the draw calls
+    switch(modelsContentType) {
+        case INDEX:
+            return mesh.getIndexSize();
+        case VERTEX:
+            return sizeof(class PackedModelVertex);
+        case SSBO:
+        default:
+            return sizeof(struct MeshProperties);
     }
 }
 
-VkImageView Graphics::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t layerCount) {
+VkImageView Graphics::createImageView(
+    VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t layerCount, uint32_t mipLevels, uint32_t baseMipLevel) {
     VkImageViewCreateInfo viewInfo{};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.image = image;
@@ -328,8 +711,8 @@ VkImageView Graphics::createImageView(VkImage image, VkFormat format, VkImageAsp
     viewInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
     viewInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
     viewInfo.subresourceRange.aspectMask = aspectFlags;
-    viewInfo.subresourceRange.baseMipLevel = 0;
-    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+    viewInfo.subresourceRange.levelCount = mipLevels;
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = layerCount;
 
@@ -349,19 +732,14 @@ void Graphics::cleanupSwapChain() {
     
     vkDeviceWaitIdle(this->device);
     
-    for (uint16_t j=0;j<this->depthImages.size();j++) {
-        if (this->depthImagesView[j] != nullptr) {
-            vkDestroyImageView(this->device, this->depthImagesView[j], nullptr);
-            this->depthImagesView[j] = nullptr;            
-        }
-        if (this->depthImages[j] != nullptr) {
-            vkDestroyImage(this->device, this->depthImages[j], nullptr);
-            this->depthImages[j] = nullptr;            
-        }
-        if (this->depthImagesMemory[j] != nullptr) {
-            vkFreeMemory(this->device, this->depthImagesMemory[j], nullptr);
-            this->depthImagesMemory[j] = nullptr;            
-        }
+    this->releaseRetiredResources(true);
+    
+    this->destroyTransientAttachments();
+    this->destroyDepthPyramid();
+    
+    {
+        std::lock_guard<std::mutex> lock(this->instanceDataLock);
+        this->recordedInstanceData.clear();
     }
 
     for (auto & framebuffer : this->swapChainFramebuffers) {
@@ -371,9 +749,7 @@ void Graphics::cleanupSwapChain() {
         }
     }
 
-    if (this->commandPool != nullptr) {
-        vkResetCommandPool(this->device, this->commandPool, VK_COMMAND_POOL_RESET_RELEASE_RESOURCES_BIT);
-    }
+    this->destroyFrameCommands();
 
     if (this->graphicsPipeline != nullptr) {
         vkDestroyPipeline(this->device, this->graphicsPipeline, nullptr);
@@ -426,6 +802,17 @@ void Graphics::cleanupVulkan() {
     if (this->terrainVertShaderModule != nullptr) vkDestroyShaderModule(this->device, this->terrainVertShaderModule, nullptr);
     if (this->skyboxFragShaderModule != nullptr) vkDestroyShaderModule(this->device, this->skyboxFragShaderModule, nullptr);
     if (this->skyboxVertShaderModule != nullptr) vkDestroyShaderModule(this->device, this->skyboxVertShaderModule, nullptr);
+    if (this->cullingShaderModule != nullptr) vkDestroyShaderModule(this->device, this->cullingShaderModule, nullptr);
+    if (this->depthPyramidShaderModule != nullptr) vkDestroyShaderModule(this->device, this->depthPyramidShaderModule, nullptr);
+    
+    if (this->cullingPipeline != nullptr) vkDestroyPipeline(this->device, this->cullingPipeline, nullptr);
+    if (this->cullingPipelineLayout != nullptr) vkDestroyPipelineLayout(this->device, this->cullingPipelineLayout, nullptr);
+    if (this->depthPyramidPipeline != nullptr) vkDestroyPipeline(this->device, this->depthPyramidPipeline, nullptr);
+    if (this->depthPyramidPipelineLayout != nullptr) vkDestroyPipelineLayout(this->device, this->depthPyramidPipelineLayout, nullptr);
+    
+    if (this->depthPyramidSampler != nullptr) {
+        vkDestroySampler(this->device, this->depthPyramidSampler, nullptr);
+    }
 
     if (this->textureSampler != nullptr) {
         vkDestroySampler(this->device, this->textureSampler, nullptr);
@@ -439,25 +826,41 @@ void Graphics::cleanupVulkan() {
         vkDestroyImage(device, this->skyboxCubeImage, nullptr);        
     }
 
-    if (this->skyboxCubeImageMemory != nullptr) {
-        vkFreeMemory(device, this->skyboxCubeImageMemory, nullptr);
-    }
+    this->memoryAllocator.free(this->skyboxCubeImageMemory);
 
     if (this->skyboxImageView != nullptr) {
         vkDestroyImageView(device, this->skyboxImageView, nullptr);
     }
 
-    this->models.cleanUpTextures(this->device);
+    this->models.cleanUpTextures(this->device, this->memoryAllocator);
+    
+    // nothing may still be writing into the staging buffers
+    this->textureStreamQueue.stopQueue();
+    for (TextureStreamRequest & request : this->textureStreamRequests) {
+        if (request.imageView != nullptr) vkDestroyImageView(this->device, request.imageView, nullptr);
+        if (request.ownsImage && request.image != nullptr) vkDestroyImage(this->device, request.image, nullptr);
+        this->memoryAllocator.free(request.imageMemory);
+        if (request.stagingBuffer != nullptr) vkDestroyBuffer(this->device, request.stagingBuffer, nullptr);
+        this->memoryAllocator.free(request.stagingBufferMemory);
+    }
+    this->textureStreamRequests.clear();
     
     if (this->descriptorPool != nullptr) {
         vkDestroyDescriptorPool(this->device, this->descriptorPool, nullptr);
     }
+    for (auto & generations : this->descriptorPoolGenerations) {
+        if (generations.first != this->descriptorPool) vkDestroyDescriptorPool(this->device, generations.first, nullptr);
+    }
+    this->descriptorPoolGenerations.clear();
     if (this->terrainDescriptorPool != nullptr) {
         vkDestroyDescriptorPool(this->device, this->terrainDescriptorPool, nullptr);
     }
     if (this->skyboxDescriptorPool != nullptr) {
         vkDestroyDescriptorPool(this->device, this->skyboxDescriptorPool, nullptr);
     }
+    if (this->cullingDescriptorPool != nullptr) {
+        vkDestroyDescriptorPool(this->device, this->cullingDescriptorPool, nullptr);
+    }
     
     if (this->descriptorSetLayout != nullptr) {
         vkDestroyDescriptorSetLayout(this->device, this->descriptorSetLayout, nullptr);
@@ -468,31 +871,39 @@ void Graphics::cleanupVulkan() {
     if (this->skyboxDescriptorSetLayout != nullptr) {
         vkDestroyDescriptorSetLayout(this->device, this->skyboxDescriptorSetLayout, nullptr);
     }
+    if (this->cullingDescriptorSetLayout != nullptr) {
+        vkDestroyDescriptorSetLayout(this->device, this->cullingDescriptorSetLayout, nullptr);
+    }
+    if (this->depthPyramidDescriptorSetLayout != nullptr) {
+        vkDestroyDescriptorSetLayout(this->device, this->depthPyramidDescriptorSetLayout, nullptr);
+    }
 
     if (this->vertexBuffer != nullptr) vkDestroyBuffer(this->device, this->vertexBuffer, nullptr);
-    if (this->vertexBufferMemory != nullptr) vkFreeMemory(this->device, this->vertexBufferMemory, nullptr);
+    this->memoryAllocator.free(this->vertexBufferMemory);
 
     if (this->indexBuffer != nullptr) vkDestroyBuffer(this->device, this->indexBuffer, nullptr);
-    if (this->indexBufferMemory != nullptr) vkFreeMemory(this->device, this->indexBufferMemory, nullptr);
+    this->memoryAllocator.free(this->indexBufferMemory);
+
+    if (this->geometryCompaction != nullptr) {
+        if (this->geometryCompaction->buffer != nullptr) vkDestroyBuffer(this->device, this->geometryCompaction->buffer, nullptr);
+        this->memoryAllocator.free(this->geometryCompaction->bufferMemory);
+        this->geometryCompaction = nullptr;
+    }
 
     if (this->terrainVertexBuffer != nullptr) vkDestroyBuffer(this->device, this->terrainVertexBuffer, nullptr);
-    if (this->terrainVertexBufferMemory != nullptr) vkFreeMemory(this->device, this->terrainVertexBufferMemory, nullptr);
+    this->memoryAllocator.free(this->terrainVertexBufferMemory);
 
     if (this->terrainIndexBuffer != nullptr) vkDestroyBuffer(this->device, this->terrainIndexBuffer, nullptr);
-    if (this->terrainIndexBufferMemory != nullptr) vkFreeMemory(this->device, this->terrainIndexBufferMemory, nullptr);
+    this->memoryAllocator.free(this->terrainIndexBufferMemory);
 
     if (this->skyBoxVertexBuffer != nullptr) vkDestroyBuffer(this->device, this->skyBoxVertexBuffer, nullptr);
-    if (this->skyBoxVertexBufferMemory != nullptr) vkFreeMemory(this->device, this->skyBoxVertexBufferMemory, nullptr);
+    this->memoryAllocator.free(this->skyBoxVertexBufferMemory);
 
     if (this->ssboBuffer != nullptr) vkDestroyBuffer(this->device, this->ssboBuffer, nullptr);
-    if (this->ssboBufferMemory != nullptr) vkFreeMemory(this->device, this->ssboBufferMemory, nullptr);
+    this->memoryAllocator.free(this->ssboBufferMemory);
     
-    for (size_t i = 0; i < this->uniformBuffers.size(); i++) {
-        if (this->uniformBuffers[i] != nullptr) vkDestroyBuffer(this->device, this->uniformBuffers[i], nullptr);
-    }
-    for (size_t i = 0; i < this->uniformBuffersMemory.size(); i++) {
-        if (this->uniformBuffersMemory[i] != nullptr) vkFreeMemory(this->device, this->uniformBuffersMemory[i], nullptr);
-    }
+    if (this->frameDataBuffer != nullptr) vkDestroyBuffer(this->device, this->frameDataBuffer, nullptr);
+    this->memoryAllocator.free(this->frameDataBufferMemory);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
         if (this->renderFinishedSemaphores.size() == MAX_FRAMES_IN_FLIGHT) {
@@ -521,10 +932,30 @@ void Graphics::cleanupVulkan() {
         }
     }
     
-    if (this->device != nullptr && this->commandPool != nullptr) {
-        vkDestroyCommandPool(this->device, this->commandPool, nullptr);
+    this->releaseUploadRegions(true);
+    if (this->uploadTransferCommandBuffer != nullptr) {
+        vkFreeCommandBuffers(this->device, this->uploadCommandPool, 1, &this->uploadTransferCommandBuffer);
+        this->uploadTransferCommandBuffer = nullptr;
+    }
+    if (this->uploadGraphicsCommandBuffer != nullptr) {
+        vkFreeCommandBuffers(this->device, this->uploadGraphicsCommandPool, 1, &this->uploadGraphicsCommandBuffer);
+        this->uploadGraphicsCommandBuffer = nullptr;
+    }
+    
+    if (this->uploadRingBuffer != nullptr) vkDestroyBuffer(this->device, this->uploadRingBuffer, nullptr);
+    this->memoryAllocator.free(this->uploadRingBufferMemory);
+    this->uploadRingData = nullptr;
+
+    if (this->device != nullptr && this->uploadCommandPool != nullptr) {
+        vkDestroyCommandPool(this->device, this->uploadCommandPool, nullptr);
+    }
+
+    if (this->device != nullptr && this->uploadGraphicsCommandPool != nullptr) {
+        vkDestroyCommandPool(this->device, this->uploadGraphicsCommandPool, nullptr);
     }
 
+    this->memoryAllocator.destroy();
+
     if (this->device != nullptr) vkDestroyDevice(this->device, nullptr);
 
     if (this->vkSurface != nullptr) vkDestroySurfaceKHR(this->vkInstance, this->vkSurface, nullptr);
@@ -548,15 +979,7 @@ BufferSummary Graphics::getModelsBufferSizes(bool printInfo) {
     auto & allModels = this->models.getModels();
     
     for (auto & model : allModels) {
-        auto meshes = model->getMeshes();
-        for (Mesh & mesh : meshes) {
-            VkDeviceSize vertexSize = mesh.getVertices().size();
-            VkDeviceSize indexSize = mesh.getIndices().size();
-
-            bufferSizes.vertexBufferSize += vertexSize * sizeof(class ModelVertex);
-            bufferSizes.indexBufferSize += indexSize * sizeof(uint32_t);
-            bufferSizes.ssboBufferSize += sizeof(struct MeshProperties);
-        }
+        this->addModelBufferSizes(model.get(), bufferSizes);
     }
     
     if (printInfo) {
@@ -567,3 +990,34 @@ BufferSummary Graphics::getModelsBufferSizes(bool printInfo) {
     
     return bufferSizes;
 }
+
+void Graphics::addModelBufferSizes(Model * model, BufferSummary & bufferSizes) {
+    const std::array<ModelsContentType, 3> contentTypes = { VERTEX, INDEX, SSBO };
+    std::array<VkDeviceSize *, 3> sizes = { &bufferSizes.vertexBufferSize, &bufferSizes.indexBufferSize, &bufferSizes.ssboBufferSize };
+
+    for (Mesh & mesh : model->getMeshes()) {
+        for (size_t i=0; i<contentTypes.size(); i++) {
+            const VkDeviceSize alignment = this->getMeshContentAlignment(mesh, contentTypes[i]);
+            *sizes[i] = (*sizes[i] + alignment - 1) / alignment * alignment + this->getMeshContentSize(mesh, contentTypes[i]);
+        }
+    }
+}
+
+void Graphics::retireResource(std::function<void()> release) {
+    this->retiredResources.push_back(std::make_tuple(this->renderedFrames, release));
+}
+
+void Graphics::releaseRetiredResources(bool force) {
+    // a frame slot is only reused after its fence signaled, so once MAX_FRAMES_IN_FLIGHT
+    // more frames were submitted nothing recorded before the retirement can still be executing
+    auto it = this->retiredResources.begin();
+    while (it != this->retiredResources.end()) {
+        if (!force && std::get<0>(*it) + MAX_FRAMES_IN_FLIGHT > this->renderedFrames) {
+            it++;
+            continue;
+        }
+        
+        std::get<1>(*it)();
+        it = this->retiredResources.erase(it);
+    }
+}
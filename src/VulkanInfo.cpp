@@ -236,6 +236,22 @@ void Graphics::queryVkInstanceExtensions() {
         this->vkExtensionNames.resize(extensionCount);
         SDL_Vulkan_GetInstanceExtensions(this->sdlWindow, &extensionCount, this->vkExtensionNames.data());
     }
+
+    // needed to query heap budgets on a 1.0 instance
+    extensionCount = 0;
+    std::vector<VkExtensionProperties> availableExtensions;
+    if (vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, nullptr) == VK_SUCCESS && extensionCount > 0) {
+        availableExtensions.resize(extensionCount);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, availableExtensions.data());
+    }
+
+    for (auto & extProp : availableExtensions) {
+        if (std::string(extProp.extensionName).compare("VK_KHR_get_physical_device_properties2") != 0) continue;
+
+        this->vkExtensionNames.push_back("VK_KHR_get_physical_device_properties2");
+        this->hasPhysicalDeviceProperties2 = true;
+        break;
+    }
 }
 
 std::vector<VkExtensionProperties> Graphics::queryPhysicalDeviceExtensions(const VkPhysicalDevice & device) {
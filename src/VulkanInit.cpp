@@ -99,8 +99,8 @@ bool Graphics::createGraphicsPipeline() {
     VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
     vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-    const VkVertexInputBindingDescription bindingDescription = ModelVertex::getBindingDescription();
-    const std::array<VkVertexInputAttributeDescription, 5> attributeDescriptions = ModelVertex::getAttributeDescriptions();
+    const VkVertexInputBindingDescription bindingDescription = PackedModelVertex::getBindingDescription();
+    const std::array<VkVertexInputAttributeDescription, 4> attributeDescriptions = PackedModelVertex::getAttributeDescriptions();
 
     vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
     vertexInputCreateInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
@@ -176,17 +176,10 @@ bool Graphics::createGraphicsPipeline() {
     colorBlending.blendConstants[2] = 0.0f;
     colorBlending.blendConstants[3] = 0.0f;
 
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(struct ModelProperties);
-    
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.pSetLayouts = &this->descriptorSetLayout;
     pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
     VkResult ret = vkCreatePipelineLayout(this->device, &pipelineLayoutInfo, nullptr, &this->graphicsPipelineLayout);
     ASSERT_VULKAN(ret);
@@ -243,11 +236,12 @@ bool Graphics::createRenderPass() {
     depthAttachment.format = depthFormat;
     depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
     depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-    depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    depthAttachment.storeOp = this->isOcclusionCullingActive() ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.finalLayout = this->isOcclusionCullingActive() ? 
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentRef{};
     colorAttachmentRef.attachment = 0;
@@ -263,13 +257,31 @@ bool Graphics::createRenderPass() {
     subpass.pColorAttachments = &colorAttachmentRef;
     subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+    std::vector<VkSubpassDependency> dependencies;
+    
     VkSubpassDependency dependency{};
     dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
     dependency.dstSubpass = 0;
-    dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-    dependency.srcAccessMask = 0;
+    // the depth attachment is shared, the previous frame's depth writes and pyramid reads have to be done before the clear
+    dependency.srcStageMask = 
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | 
+        VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
     dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+    dependencies.push_back(dependency);
+    
+    // the depth pyramid is built from the stored depth right after the pass
+    if (this->isOcclusionCullingActive()) {
+        VkSubpassDependency depthPyramidDependency{};
+        depthPyramidDependency.srcSubpass = 0;
+        depthPyramidDependency.dstSubpass = VK_SUBPASS_EXTERNAL;
+        depthPyramidDependency.srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        depthPyramidDependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        depthPyramidDependency.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        depthPyramidDependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        dependencies.push_back(depthPyramidDependency);
+    }
 
     std::array<VkAttachmentDescription, 2> attachments = {colorAttachment, depthAttachment};
     
@@ -279,8 +291,8 @@ bool Graphics::createRenderPass() {
     renderPassInfo.pAttachments = attachments.data();
     renderPassInfo.subpassCount = 1;
     renderPassInfo.pSubpasses = &subpass;
-    renderPassInfo.dependencyCount = 1;
-    renderPassInfo.pDependencies = &dependency;
+    renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+    renderPassInfo.pDependencies = dependencies.data();
 
     VkResult ret = vkCreateRenderPass(this->device, &renderPassInfo, nullptr, &this->renderPass);
     ASSERT_VULKAN(ret);
@@ -314,18 +326,53 @@ bool Graphics::createLogicalDeviceAndQueues() {
     queueCreateInfo.pNext = nullptr;
     queueCreateInfo.queueFamilyIndex = bestPhysicalQueueIndex;
     queueCreateInfo.queueCount = 2;
-    const float priority = 1.0f;
-    queueCreateInfo.pQueuePriorities = &priority;
+    const std::array<float, 2> priorities = { 1.0f, 1.0f };
+    queueCreateInfo.pQueuePriorities = priorities.data();
 
     queueCreateInfos.push_back(queueCreateInfo);
 
-    const std::vector<const char * > extensionsToEnable = { 
+    // uploads go to a transfer only family if there is one, a family without compute is what dma engines usually expose
+    int transferQueueIndex = -1;
+    const std::vector<VkQueueFamilyProperties> queueFamilyProperties = this->getPhysicalDeviceQueueFamilyProperties(this->physicalDevice);
+    for (uint32_t i=0; i<queueFamilyProperties.size(); i++) {
+        const VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
+        if (static_cast<int>(i) == bestPhysicalQueueIndex || queueFamilyProperties[i].queueCount == 0 ||
+            (flags & VK_QUEUE_TRANSFER_BIT) == 0 || (flags & VK_QUEUE_GRAPHICS_BIT) != 0) continue;
+        
+        if (transferQueueIndex == -1 || (flags & VK_QUEUE_COMPUTE_BIT) == 0) transferQueueIndex = i;
+    }
+    
+    if (transferQueueIndex != -1) {
+        queueCreateInfo.queueFamilyIndex = transferQueueIndex;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfos.push_back(queueCreateInfo);
+    }
+
+    std::vector<const char * > extensionsToEnable = { 
         "VK_KHR_swapchain"
     };
+    
+    this->supportsMemoryBudget = 
+        this->hasPhysicalDeviceProperties2 && this->doesPhysicalDeviceSupportExtension(this->physicalDevice, "VK_EXT_memory_budget");
+    if (this->supportsMemoryBudget) extensionsToEnable.push_back("VK_EXT_memory_budget");
+
+    const bool supportsDrawIndirectCount = this->doesPhysicalDeviceSupportExtension(this->physicalDevice, "VK_KHR_draw_indirect_count");
+    if (supportsDrawIndirectCount) extensionsToEnable.push_back("VK_KHR_draw_indirect_count");
+
+    VkPhysicalDeviceFeatures supportedFeatures {};
+    vkGetPhysicalDeviceFeatures(this->physicalDevice, &supportedFeatures);
+    VkPhysicalDeviceProperties properties {};
+    vkGetPhysicalDeviceProperties(this->physicalDevice, &properties);
+
+    // without a first instance the indirect draws can't address their instance references, draws stay direct then
+    this->supportsDrawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance == VK_TRUE;
+    this->supportsMultiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+    this->maxDrawIndirectCount = this->supportsMultiDrawIndirect ? std::max(properties.limits.maxDrawIndirectCount, 1u) : 1;
 
     VkPhysicalDeviceFeatures deviceFeatures {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
-    deviceFeatures.multiDrawIndirect = VK_TRUE;
+    deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
     deviceFeatures.fillModeNonSolid = VK_TRUE;
 
     VkDeviceCreateInfo createInfo {};
@@ -348,6 +395,16 @@ bool Graphics::createLogicalDeviceAndQueues() {
     vkGetDeviceQueue(this->device, this->graphicsQueueIndex , 0, &this->graphicsQueue);
     vkGetDeviceQueue(this->device, this->presentQueueIndex , 0, &this->presentQueue);
 
+    this->transferQueueIndex = transferQueueIndex != -1 ? transferQueueIndex : this->graphicsQueueIndex;
+    vkGetDeviceQueue(this->device, this->transferQueueIndex , 0, &this->transferQueue);
+    this->transferImageGranularity = queueFamilyProperties[this->transferQueueIndex].minImageTransferGranularity;
+    if (this->hasDedicatedTransferQueue()) std::cout << "Using Transfer Queue Family " << this->transferQueueIndex << std::endl;
+
+    if (supportsDrawIndirectCount) {
+        this->cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+            vkGetDeviceProcAddr(this->device, "vkCmdDrawIndexedIndirectCountKHR"));
+    }
+
     return true;
 }
 
@@ -396,10 +453,13 @@ bool Graphics::initVulkan(const std::string & appName, uint32_t version) {
 
     if (!this->createLogicalDeviceAndQueues()) return false;
 
+    this->memoryAllocator.init(this->vkInstance, this->physicalDevice, this->device, this->supportsMemoryBudget);
+
     if (!this->createSwapChain()) return false;
     if (!this->createImageViews()) return false;
     if (!this->createRenderPass()) return false;
     if (!this->createCommandPool()) return false;
+    if (!this->createUploadRing()) return false;
     
     this->hasTerrain = this->createTerrain();
     this->hasSkybox = this->createSkybox();
@@ -455,35 +515,65 @@ bool Graphics::createCommandPool() {
     poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
     poolInfo.queueFamilyIndex = this->graphicsQueueIndex;
 
-    VkResult ret = vkCreateCommandPool(this->device, &poolInfo, nullptr, &this->commandPool);
+    VkResult ret = VK_SUCCESS;
+
+    // uploads happen on the main thread while the worker queue records, pools must not be shared
+    if (this->hasDedicatedTransferQueue()) {
+        ret = vkCreateCommandPool(this->device, &poolInfo, nullptr, &this->uploadGraphicsCommandPool);
+        ASSERT_VULKAN(ret);
+
+        if (ret != VK_SUCCESS) {
+            std::cerr << "Failed to Create Upload Graphics Command Pool" << std::endl;
+            return false;
+        }
+    }
+
+    poolInfo.queueFamilyIndex = this->transferQueueIndex;
+    ret = vkCreateCommandPool(this->device, &poolInfo, nullptr, &this->uploadCommandPool);
     ASSERT_VULKAN(ret);
 
     if (ret != VK_SUCCESS) {
-        std::cerr << "Failed to Create Command Pool" << std::endl;
+        std::cerr << "Failed to Create Upload Command Pool" << std::endl;
         return false;
     }
 
     return true;
 }
 
+bool Graphics::createUploadRing() {
+    if (!this->createBuffer(
+            UPLOAD_RING_SIZE,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            this->uploadRingBuffer, this->uploadRingBufferMemory)) {
+        std::cerr << "Failed to Create Upload Ring Buffer" << std::endl;
+        return false;
+    }
+
+    // host visible memory stays mapped for the lifetime of its block
+    this->uploadRingData = this->uploadRingBufferMemory.data;
+
+    return true;
+}
+
 bool Graphics::createUniformBuffers() {
     if (!this->createTextureSampler(this->textureSampler, VK_SAMPLER_ADDRESS_MODE_REPEAT)) return false;
     
     if (!this->createDescriptorSetLayout()) return false;
     
-    VkDeviceSize bufferSize = sizeof(struct ModelUniforms);
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(this->physicalDevice, &properties);
 
-    this->uniformBuffers.resize(this->swapChainImages.size());
-    this->uniformBuffersMemory.resize(this->swapChainImages.size());
+    // the culling pass addresses the frame data in vec4 units
+    this->frameDataAlignment = std::max({
+        properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment, static_cast<VkDeviceSize>(16) });
+    this->frameDataUsage.assign(this->swapChainImages.size(), 0);
 
-    for (size_t i = 0; i < this->swapChainImages.size(); i++) {
-        this->createBuffer(
-            bufferSize, 
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-            this->uniformBuffers[i], this->uniformBuffersMemory[i]);
-    }
+    if (!this->createFrameDataBuffer(this->alignFrameData(std::max(FRAME_DATA_SIZE, this->getSceneFrameDataSize())))) return false;
     
     if (!this->createDescriptorSets()) return false;
+    
+    // without it the model pass falls back to the frustum test on the cpu side
+    if (this->vertexBuffer != nullptr && !this->createCulling()) std::cerr << "GPU Culling is not available" << std::endl;
 
     if (this->hasTerrain) {
         if (!this->createTerrainDescriptorSetLayout()) return false;
@@ -499,48 +589,190 @@ bool Graphics::createUniformBuffers() {
     return true;
 }
 
-bool Graphics::createDepthResources() {
-    this->depthImages.resize(this->swapChainImages.size());
-    this->depthImagesMemory.resize(this->depthImages.size());
-    this->depthImagesView.resize(this->depthImages.size());
+bool Graphics::createFrameDataBuffer(VkDeviceSize stride) {
+    this->frameDataStride = stride;
     
+    // the instance references are bound further into a slice, the tail keeps the last slice's range inside the buffer
+    if (!this->createBuffer(
+            this->frameDataStride * (this->swapChainImages.size() + 1), 
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+            this->frameDataBuffer, this->frameDataBufferMemory)) {
+        std::cerr << "Failed to Create Frame Data Buffer" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool Graphics::createDepthResources() {
     VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
     if (!this->findDepthFormat(depthFormat)) {
     
         return false;
     };
 
-    for (uint16_t i=0;i<this->depthImages.size();i++) {
-        if (!this->createImage(swapChainExtent.width, swapChainExtent.height, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, this->depthImages[i], this->depthImagesMemory[i])) {
-            std::cerr << "Faild to create Depth Image!" << std::endl;
+    // sampled by the depth pyramid pass, which makes it live past the render pass
+    if (this->isOcclusionCullingActive()) {
+        this->depthAttachment = this->addTransientAttachment(
+            depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+    } else {
+        this->depthAttachment = this->addTransientAttachment(depthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+    }
+    
+    if (!this->createTransientAttachments()) {
+        std::cerr << "Faild to create Depth Image!" << std::endl;
+        return false;
+    }
+    
+    return true;
+}
+
+uint32_t Graphics::addTransientAttachment(
+    VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, uint32_t firstPass, uint32_t lastPass) {
+    TransientAttachment attachment;
+    attachment.format = format;
+    attachment.usage = usage;
+    attachment.aspectFlags = aspectFlags;
+    attachment.firstPass = firstPass;
+    attachment.lastPass = lastPass;
+    
+    this->transientAttachments.push_back(attachment);
+    
+    return static_cast<uint32_t>(this->transientAttachments.size() - 1);
+}
+
+bool Graphics::createTransientAttachments() {
+    if (this->transientAttachments.empty()) return true;
+    
+    VkMemoryRequirements memoryRequirements {};
+    memoryRequirements.alignment = 1;
+    memoryRequirements.memoryTypeBits = UINT32_MAX;
+    bool lazilyAllocated = true;
+    
+    for (TransientAttachment & attachment : this->transientAttachments) {
+        VkImageCreateInfo imageInfo{};
+        imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        imageInfo.imageType = VK_IMAGE_TYPE_2D;
+        imageInfo.extent.width = this->swapChainExtent.width;
+        imageInfo.extent.height = this->swapChainExtent.height;
+        imageInfo.extent.depth = 1;
+        imageInfo.mipLevels = 1;
+        imageInfo.arrayLayers = 1;
+        imageInfo.format = attachment.format;
+        imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+        imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        // contents are cleared on load and dropped on store, tilers never have to back them with memory
+        // unless something outside of the render pass samples them
+        imageInfo.usage = attachment.usage;
+        if ((attachment.usage & ~(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) == 0) {
+            imageInfo.usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        } else lazilyAllocated = false;
+        imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+        imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        
+        VkResult ret = vkCreateImage(this->device, &imageInfo, nullptr, &attachment.image);
+        ASSERT_VULKAN(ret);
+        
+        if (ret != VK_SUCCESS) {
+            std::cerr << "Failed to Create Image" << std::endl;
             return false;
         }
+        
+        vkGetImageMemoryRequirements(this->device, attachment.image, &attachment.memoryRequirements);
+        memoryRequirements.alignment = std::max(memoryRequirements.alignment, attachment.memoryRequirements.alignment);
+        memoryRequirements.memoryTypeBits &= attachment.memoryRequirements.memoryTypeBits;
+    }
+    
+    // biggest first, each takes the lowest offset not used by an attachment whose passes overlap with its own
+    std::vector<TransientAttachment *> placedAttachments;
+    for (TransientAttachment & attachment : this->transientAttachments) placedAttachments.push_back(&attachment);
+    std::sort(placedAttachments.begin(), placedAttachments.end(), [](TransientAttachment * a, TransientAttachment * b) {
+        return a->memoryRequirements.size > b->memoryRequirements.size;
+    });
+    
+    for (size_t i=0; i<placedAttachments.size(); i++) {
+        TransientAttachment * attachment = placedAttachments[i];
+        
+        VkDeviceSize offset = 0;
+        bool overlaps = true;
+        while (overlaps) {
+            overlaps = false;
+            for (size_t j=0; j<i; j++) {
+                const TransientAttachment * other = placedAttachments[j];
+                if (other->lastPass < attachment->firstPass || other->firstPass > attachment->lastPass) continue;
+                if (other->offset >= offset + attachment->memoryRequirements.size || 
+                    other->offset + other->memoryRequirements.size <= offset) continue;
+                
+                offset = (other->offset + other->memoryRequirements.size + memoryRequirements.alignment - 1) / 
+                    memoryRequirements.alignment * memoryRequirements.alignment;
+                overlaps = true;
+            }
+        }
+        
+        attachment->offset = offset;
+        memoryRequirements.size = std::max(memoryRequirements.size, offset + attachment->memoryRequirements.size);
+    }
+    
+    uint32_t memoryTypeIndex;
+    if ((!lazilyAllocated || !this->findMemoryType(
+            memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, memoryTypeIndex)) &&
+        !this->findMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memoryTypeIndex)) {
+        std::cerr << "Failed to get Memory Type Requested" << std::endl;
+        return false;
+    }
+    
+    if (!this->memoryAllocator.allocate(memoryRequirements, memoryTypeIndex, ATTACHMENT_MEMORY, false, this->transientAttachmentMemory)) {
+        std::cerr << "Failed to Allocate Image Memory" << std::endl;
+        return false;
+    }
     
-        this->depthImagesView[i] = this->createImageView(this->depthImages[i], depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-        if (this->depthImagesView[i] == nullptr) {
-            std::cerr << "Faild to create Depth Image View!" << std::endl;
-            return false;        
+    // aliased attachments start out undefined in every pass that uses them, their render passes clear or discard on load
+    for (TransientAttachment & attachment : this->transientAttachments) {
+        vkBindImageMemory(
+            this->device, attachment.image, this->transientAttachmentMemory.memory, this->transientAttachmentMemory.offset + attachment.offset);
+        
+        attachment.imageView = this->createImageView(attachment.image, attachment.format, attachment.aspectFlags);
+        if (attachment.imageView == nullptr) {
+            std::cerr << "Failed to Create Image View" << std::endl;
+            return false;
         }
     }
     
     return true;
 }
 
+void Graphics::destroyTransientAttachments() {
+    for (TransientAttachment & attachment : this->transientAttachments) {
+        if (attachment.imageView != nullptr) vkDestroyImageView(this->device, attachment.imageView, nullptr);
+        if (attachment.image != nullptr) vkDestroyImage(this->device, attachment.image, nullptr);
+    }
+    
+    this->transientAttachments.clear();
+    this->memoryAllocator.free(this->transientAttachmentMemory);
+}
+
 bool Graphics::createDescriptorPool() {
-    std::array<VkDescriptorPoolSize, 3> poolSizes{};
+    std::array<VkDescriptorPoolSize, 4> poolSizes{};
+
+    // room for the sets in use plus the ones replaced at runtime that frames in flight still reference
+    const uint32_t numberOfSets = static_cast<uint32_t>(this->swapChainImages.size() * DESCRIPTOR_SET_GENERATIONS);
 
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    poolSizes[0].descriptorCount = static_cast<uint32_t>(this->swapChainImages.size());
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    poolSizes[0].descriptorCount = numberOfSets;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[1].descriptorCount = static_cast<uint32_t>(this->swapChainImages.size());
+    poolSizes[1].descriptorCount = numberOfSets;
     poolSizes[2].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    poolSizes[2].descriptorCount = static_cast<uint32_t>(MAX_TEXTURES * this->swapChainImages.size());
+    poolSizes[2].descriptorCount = MAX_TEXTURES * numberOfSets;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+    poolSizes[3].descriptorCount = 2 * numberOfSets;
 
     VkDescriptorPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
     poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
     poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = static_cast<uint32_t>(swapChainImages.size());
+    poolInfo.maxSets = numberOfSets;
 
     VkResult ret = vkCreateDescriptorPool(device, &poolInfo, nullptr, &this->descriptorPool);
     ASSERT_VULKAN(ret);
@@ -557,7 +789,7 @@ bool Graphics::createFramebuffers() {
 
      for (size_t i = 0; i < this->swapChainImageViews.size(); i++) {
          std::array<VkImageView, 2> attachments = {
-             this->swapChainImageViews[i], this->depthImagesView[i]
+             this->swapChainImageViews[i], this->transientAttachments[this->depthAttachment].imageView
          };
 
          VkFramebufferCreateInfo framebufferInfo{};
@@ -638,7 +870,7 @@ bool Graphics::createDescriptorSetLayout() {
     VkDescriptorSetLayoutBinding modelUniformLayoutBinding{};
     modelUniformLayoutBinding.binding = 0;
     modelUniformLayoutBinding.descriptorCount = 1;
-    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    modelUniformLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     modelUniformLayoutBinding.pImmutableSamplers = nullptr;
     modelUniformLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     layoutBindings.push_back(modelUniformLayoutBinding);
@@ -651,10 +883,21 @@ bool Graphics::createDescriptorSetLayout() {
     ssboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     layoutBindings.push_back(ssboLayoutBinding);
 
-    uint32_t numberOfTextures = this->models.getTextures().size();
+    // per instance transforms and references of a recorded frame, both live behind the uniforms in the frame data
+    for (uint32_t binding : { 3, 4 }) {
+        VkDescriptorSetLayoutBinding instanceLayoutBinding{};
+        instanceLayoutBinding.binding = binding;
+        instanceLayoutBinding.descriptorCount = 1;
+        instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        instanceLayoutBinding.pImmutableSamplers = nullptr;
+        instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        layoutBindings.push_back(instanceLayoutBinding);
+    }
+
+    // fixed size so that textures added at runtime don't require a new layout and pipeline
     VkDescriptorSetLayoutBinding samplersLayoutBinding{};
     samplersLayoutBinding.binding = 2;
-    samplersLayoutBinding.descriptorCount = numberOfTextures > 0 ? numberOfTextures : 0;
+    samplersLayoutBinding.descriptorCount = MAX_TEXTURES;
     samplersLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     samplersLayoutBinding.pImmutableSamplers = nullptr;
     samplersLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -678,6 +921,23 @@ bool Graphics::createDescriptorSetLayout() {
 bool Graphics::createDescriptorSets() {
     if (this->vertexBuffer == nullptr) return true;
     
+    return this->allocateDescriptorSets(this->descriptorSets);
+}
+
+bool Graphics::allocateDescriptorSets(std::vector<VkDescriptorSet> & sets) {
+    // slots without a texture still need a valid view, they are never sampled
+    VkImageView fallbackImageView = nullptr;
+    for (auto & texture : this->models.getTextures()) {
+        if (texture.second->getTextureImageView() != nullptr) {
+            fallbackImageView = texture.second->getTextureImageView();
+            break;
+        }
+    }
+    if (fallbackImageView == nullptr) {
+        std::cerr << "Failed to find any Texture Image View for Descriptor Sets!" << std::endl;
+        return false;
+    }
+
     std::vector<VkDescriptorSetLayout> layouts(this->swapChainImages.size(), this->descriptorSetLayout);
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -685,41 +945,32 @@ bool Graphics::createDescriptorSets() {
     allocInfo.descriptorSetCount = static_cast<uint32_t>(this->swapChainImages.size());
     allocInfo.pSetLayouts = layouts.data();
 
-    this->descriptorSets.resize(this->swapChainImages.size());
-    VkResult ret = vkAllocateDescriptorSets(this->device, &allocInfo, this->descriptorSets.data());
+    sets.resize(this->swapChainImages.size());
+    VkResult ret = vkAllocateDescriptorSets(this->device, &allocInfo, sets.data());
     if (ret != VK_SUCCESS) {
         std::cerr << "Failed to Allocate Descriptor Sets!" << std::endl;
         return false;
     }
-
-    std::map<std::string, std::unique_ptr<Texture>> & textures = this->models.getTextures();
-    uint32_t numberOfTextures = textures.size();        
+    this->descriptorPoolGenerations[this->descriptorPool]++;
 
     std::vector<VkDescriptorImageInfo> descriptorImageInfos;
-    if (numberOfTextures > 0) {
-        for (uint32_t i = 0; i < numberOfTextures; ++i) {
-            VkDescriptorImageInfo texureDescriptorInfo = {};
-            texureDescriptorInfo.sampler = this->textureSampler;
-            texureDescriptorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            texureDescriptorInfo.imageView = this->models.findTextureImageViewById(i);
-            descriptorImageInfos.push_back(texureDescriptorInfo);
-        }
-    } else {
-            VkDescriptorImageInfo texureDescriptorInfo = {};
-            texureDescriptorInfo.sampler = nullptr;
-            texureDescriptorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            texureDescriptorInfo.imageView = this->models.findTextureImageViewById(-1);
-            descriptorImageInfos.push_back(texureDescriptorInfo);        
+    for (int i = 0; i < MAX_TEXTURES; ++i) {
+        VkDescriptorImageInfo texureDescriptorInfo = {};
+        texureDescriptorInfo.sampler = this->textureSampler;
+        texureDescriptorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        texureDescriptorInfo.imageView = this->models.findTextureImageViewById(i);
+        if (texureDescriptorInfo.imageView == nullptr) texureDescriptorInfo.imageView = fallbackImageView;
+        descriptorImageInfos.push_back(texureDescriptorInfo);
     }
 
     VkDescriptorBufferInfo ssboBufferInfo{};
     ssboBufferInfo.buffer = this->ssboBuffer;
     ssboBufferInfo.offset = 0;
-    ssboBufferInfo.range = this->getModelsBufferSizes().ssboBufferSize;
+    ssboBufferInfo.range = VK_WHOLE_SIZE;
 
-    for (size_t i = 0; i < this->descriptorSets.size(); i++) {
+    for (size_t i = 0; i < sets.size(); i++) {
         VkDescriptorBufferInfo uniformBufferInfo{};
-        uniformBufferInfo.buffer = this->uniformBuffers[i];
+        uniformBufferInfo.buffer = this->frameDataBuffer;
         uniformBufferInfo.offset = 0;
         uniformBufferInfo.range = sizeof(struct ModelUniforms);
 
@@ -727,17 +978,17 @@ bool Graphics::createDescriptorSets() {
 
         VkWriteDescriptorSet uniformDescriptorSet = {};
         uniformDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        uniformDescriptorSet.dstSet = this->descriptorSets[i];
+        uniformDescriptorSet.dstSet = sets[i];
         uniformDescriptorSet.dstBinding = 0;
         uniformDescriptorSet.dstArrayElement = 0;
-        uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniformDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uniformDescriptorSet.descriptorCount = 1;
         uniformDescriptorSet.pBufferInfo = &uniformBufferInfo;
         descriptorWrites.push_back(uniformDescriptorSet);
 
         VkWriteDescriptorSet ssboDescriptorSet = {};
         ssboDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        ssboDescriptorSet.dstSet = this->descriptorSets[i];
+        ssboDescriptorSet.dstSet = sets[i];
         ssboDescriptorSet.dstBinding = 1;
         ssboDescriptorSet.dstArrayElement = 0;
         ssboDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -745,14 +996,32 @@ bool Graphics::createDescriptorSets() {
         ssboDescriptorSet.pBufferInfo = &ssboBufferInfo;
         descriptorWrites.push_back(ssboDescriptorSet);
 
+        VkDescriptorBufferInfo instanceBufferInfo{};
+        instanceBufferInfo.buffer = this->frameDataBuffer;
+        instanceBufferInfo.offset = 0;
+        // the dynamic offset moves the range onto a frame's slice, it must not run past it
+        instanceBufferInfo.range = this->frameDataStride - this->alignFrameData(sizeof(struct ModelUniforms));
+
+        for (uint32_t binding : { 3, 4 }) {
+            VkWriteDescriptorSet instanceDescriptorSet = {};
+            instanceDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            instanceDescriptorSet.dstSet = sets[i];
+            instanceDescriptorSet.dstBinding = binding;
+            instanceDescriptorSet.dstArrayElement = 0;
+            instanceDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            instanceDescriptorSet.descriptorCount = 1;
+            instanceDescriptorSet.pBufferInfo = &instanceBufferInfo;
+            descriptorWrites.push_back(instanceDescriptorSet);
+        }
+
         VkWriteDescriptorSet samplerDescriptorSet = {};
         samplerDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         samplerDescriptorSet.dstBinding = 2;
         samplerDescriptorSet.dstArrayElement = 0;
         samplerDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        samplerDescriptorSet.descriptorCount = numberOfTextures > 0 ? numberOfTextures : 1;
+        samplerDescriptorSet.descriptorCount = static_cast<uint32_t>(descriptorImageInfos.size());
         samplerDescriptorSet.pImageInfo = descriptorImageInfos.data();
-        samplerDescriptorSet.dstSet = this->descriptorSets[i];
+        samplerDescriptorSet.dstSet = sets[i];
         descriptorWrites.push_back(samplerDescriptorSet);
 
         vkUpdateDescriptorSets(this->device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
@@ -29,15 +29,24 @@ void Graphics::init(const std::string & appName, uint32_t version, const std::fi
         this->active = true;
         
         TTF_Init();
+        // load the image codecs up front, IMG_Load runs on several threads at once when textures are decoded
+        const int imageFormats = IMG_INIT_JPG | IMG_INIT_PNG | IMG_INIT_TIF | IMG_INIT_WEBP;
+        if ((IMG_Init(imageFormats) & imageFormats) != imageFormats) {
+            std::cerr << "Failed to Init all Image Formats: " << IMG_GetError() << std::endl;
+        }
     }    
 }
 
 bool Graphics::prepareModels() {
+    this->models.processTextures();
+    
     if (!this->createBuffersFromModel()) return false;
     
     this->prepareModelTextures();
     if (!this->createUniformBuffers()) return false;
 
+    this->printMemoryStatistics();
+
     return true;
 }
 
@@ -52,39 +61,102 @@ bool Graphics::isActive() {
 }
 
 bool Graphics::createCommandBuffers() {
-    this->commandBuffers.resize(this->swapChainFramebuffers.size());
+    this->commandBuffers.assign(this->swapChainFramebuffers.size(), nullptr);
+    
+    this->frameCommands.resize(this->swapChainFramebuffers.size() * CommandBufferQueue::SLOTS_PER_FRAME);
+    for (auto & frameCommands : this->frameCommands) {
+        if (!this->createFrameCommands(frameCommands)) return false;
+    }
+    
+    // the recording thread hands out its batches to these together with itself
+    if (this->recordingWorkers == nullptr) {
+        this->recordingWorkers = std::make_unique<WorkerPool>(std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+    }
     
     this->startCommandBufferQueue();
 
     return true;
 }
 
-void Graphics::destroyCommandBuffer(VkCommandBuffer commandBuffer) {
-    vkFreeCommandBuffers(this->device, this->commandPool, 1, &commandBuffer);
-}
-
-VkCommandBuffer Graphics::createCommandBuffer(uint16_t commandBufferIndex) {
-    if (this->requiresUpdateSwapChain) return nullptr;
+bool Graphics::createFrameCommands(FrameCommands & frameCommands) {
+    // one slice for skybox and terrain, the model draws are split across as many slices as there are cores
+    const size_t numberOfSlices = 1 + std::max<size_t>(1, std::thread::hardware_concurrency());
     
-    VkCommandBuffer commandBuffer = nullptr;
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.queueFamilyIndex = this->graphicsQueueIndex;
     
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.commandPool = this->commandPool;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
     allocInfo.commandBufferCount = 1;
 
-    VkResult ret = vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-    if (ret != VK_SUCCESS) {
-        std::cerr << "Failed to Allocate Command Buffer!" << std::endl;
-        return nullptr;
+    for (size_t i=0; i<=numberOfSlices; i++) {
+        VkCommandPool pool = nullptr;
+        VkResult ret = vkCreateCommandPool(this->device, &poolInfo, nullptr, &pool);
+        ASSERT_VULKAN(ret);
+
+        if (ret != VK_SUCCESS) {
+            std::cerr << "Failed to Create Frame Command Pool" << std::endl;
+            return false;
+        }
+        
+        // the buffers stay allocated, resetting the pools is all it takes to record them again
+        VkCommandBuffer commandBuffer = nullptr;
+        allocInfo.commandPool = pool;
+        allocInfo.level = i == 0 ? VK_COMMAND_BUFFER_LEVEL_PRIMARY : VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        
+        ret = vkAllocateCommandBuffers(this->device, &allocInfo, &commandBuffer);
+        if (ret != VK_SUCCESS) {
+            vkDestroyCommandPool(this->device, pool, nullptr);
+            std::cerr << "Failed to Allocate Frame Command Buffer!" << std::endl;
+            return false;
+        }
+        
+        if (i == 0) {
+            frameCommands.commandPool = pool;
+            frameCommands.commandBuffer = commandBuffer;
+        } else {
+            frameCommands.secondaryCommandPools.push_back(pool);
+            frameCommands.secondaryCommandBuffers.push_back(commandBuffer);
+        }
+    }
+    
+    return true;
+}
+
+void Graphics::destroyFrameCommands() {
+    for (auto & frameCommands : this->frameCommands) {
+        if (frameCommands.commandPool != nullptr) vkDestroyCommandPool(this->device, frameCommands.commandPool, nullptr);
+        
+        for (auto & pool : frameCommands.secondaryCommandPools) {
+            vkDestroyCommandPool(this->device, pool, nullptr);
+        }
+    }
+    
+    this->frameCommands.clear();
+}
+
+VkCommandBuffer Graphics::createCommandBuffer(uint16_t commandBufferIndex, uint16_t slot) {
+    if (this->requiresUpdateSwapChain) return nullptr;
+    
+    // the queue never hands out the slot of a frame that may still be executing
+    FrameCommands & frameCommands = this->frameCommands[commandBufferIndex * CommandBufferQueue::SLOTS_PER_FRAME + slot];
+    
+    vkResetCommandPool(this->device, frameCommands.commandPool, 0);
+    for (auto & pool : frameCommands.secondaryCommandPools) {
+        vkResetCommandPool(this->device, pool, 0);
+    }
+    
+    VkCommandBuffer commandBuffer = frameCommands.commandBuffer;
+    {
+        std::lock_guard<std::mutex> lock(this->instanceDataLock);
+        this->recordedInstanceData.erase(commandBuffer);
     }
 
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-    ret = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    VkResult ret = vkBeginCommandBuffer(commandBuffer, &beginInfo);
     if (ret != VK_SUCCESS) {
         std::cerr << "Failed to begin Recording Command Buffer!" << std::endl;
         return nullptr;
@@ -92,6 +164,64 @@ VkCommandBuffer Graphics::createCommandBuffer(uint16_t commandBufferIndex) {
 
     if (this->requiresUpdateSwapChain) return nullptr;
     
+    InstanceData instanceData;
+    const bool useIndices = this->indexBuffer != nullptr;
+    const bool hasDraws = this->graphicsPipeline != nullptr && this->collectDraws(commandBufferIndex, useIndices, instanceData);
+    
+    if (this->requiresUpdateSwapChain || this->requiredFrameDataStride > this->frameDataStride) return nullptr;
+    
+    // compute can't be recorded inside the render pass
+    if (hasDraws && instanceData.culled) this->recordCulling(commandBuffer, commandBufferIndex, instanceData);
+    
+    // the background goes into the first slice, the model draws are split evenly across the others.
+    // indirect draws are a handful of calls no matter the scene, splitting them up would not gain anything
+    const uint32_t numberOfDrawCommands = static_cast<uint32_t>(instanceData.drawCommands.size());
+    size_t numberOfDrawSlices = 0;
+    if (hasDraws) {
+        numberOfDrawSlices = instanceData.indirect ? 1 : std::clamp<size_t>(
+            (numberOfDrawCommands + MIN_DRAW_COMMANDS_PER_SLICE - 1) / MIN_DRAW_COMMANDS_PER_SLICE, 
+            1, frameCommands.secondaryCommandBuffers.size() - 1);
+    }
+    const uint32_t drawCommandsPerSlice = numberOfDrawSlices == 0 ? 0 :
+        static_cast<uint32_t>((numberOfDrawCommands + numberOfDrawSlices - 1) / numberOfDrawSlices);
+    
+    const std::vector<VkCommandBuffer> secondaryCommandBuffers(
+        frameCommands.secondaryCommandBuffers.begin(), frameCommands.secondaryCommandBuffers.begin() + 1 + numberOfDrawSlices);
+    std::vector<uint32_t> drawCallsPerSlice(secondaryCommandBuffers.size(), 0);
+    std::atomic<bool> succeeded(true);
+    
+    this->recordingWorkers->execute(secondaryCommandBuffers.size(), [&](size_t slice) {
+        VkCommandBuffer secondaryCommandBuffer = secondaryCommandBuffers[slice];
+        if (!this->beginSecondaryCommandBuffer(secondaryCommandBuffer, commandBufferIndex)) {
+            succeeded = false;
+            return;
+        }
+        
+        if (slice == 0) {
+            this->recordBackground(secondaryCommandBuffer, commandBufferIndex);
+        } else {
+            if (this->vertexBuffer != nullptr) {
+                vkCmdBindPipeline(secondaryCommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+
+                VkBuffer vertexBuffers[] = {this->vertexBuffer};
+                VkDeviceSize offsets[] = {0};
+                vkCmdBindVertexBuffers(secondaryCommandBuffer, 0, 1, vertexBuffers, offsets);
+            }
+            
+            const uint32_t firstDrawCommand = std::min(static_cast<uint32_t>(slice - 1) * drawCommandsPerSlice, numberOfDrawCommands);
+            drawCallsPerSlice[slice] = this->draw(
+                secondaryCommandBuffer, commandBufferIndex, instanceData, useIndices, 
+                firstDrawCommand, std::min(firstDrawCommand + drawCommandsPerSlice, numberOfDrawCommands));
+        }
+        
+        if (vkEndCommandBuffer(secondaryCommandBuffer) != VK_SUCCESS) {
+            std::cerr << "Failed to end Recording Secondary Command Buffer!" << std::endl;
+            succeeded = false;
+        }
+    });
+    
+    if (this->requiresUpdateSwapChain || !succeeded) return nullptr;
+    
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
     renderPassInfo.renderPass = this->renderPass;
@@ -106,14 +236,60 @@ VkCommandBuffer Graphics::createCommandBuffer(uint16_t commandBufferIndex) {
     renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
     renderPassInfo.pClearValues = clearValues.data();
     
-    if (this->requiresUpdateSwapChain) return nullptr;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()), secondaryCommandBuffers.data());
+
+    vkCmdEndRenderPass(commandBuffer);
+    
+    if (!this->depthPyramidDescriptorSets.empty()) this->recordDepthPyramid(commandBuffer);
+
+    ret = vkEndCommandBuffer(commandBuffer);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to end  Recording Command Buffer!" << std::endl;
+        return nullptr;
+    }
+    
+    if (hasDraws) {
+        this->drawCalls = std::accumulate(drawCallsPerSlice.begin(), drawCallsPerSlice.end(), 0u);
+        this->indirectDraws = instanceData.indirect ? numberOfDrawCommands : 0;
+        this->instancesDrawn = static_cast<uint32_t>(instanceData.instances.size());
+        
+        std::lock_guard<std::mutex> lock(this->instanceDataLock);
+        this->recordedInstanceData[commandBuffer] = std::move(instanceData);
+    }
+
+    return commandBuffer;
+}
+
+bool Graphics::beginSecondaryCommandBuffer(VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex) {
+    VkCommandBufferInheritanceInfo inheritanceInfo{};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = this->renderPass;
+    inheritanceInfo.subpass = 0;
+    inheritanceInfo.framebuffer = this->swapChainFramebuffers[commandBufferIndex];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    VkResult ret = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    if (ret != VK_SUCCESS) {
+        std::cerr << "Failed to begin Recording Secondary Command Buffer!" << std::endl;
+        return false;
+    }
     
-    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    return true;
+}
+
+void Graphics::recordBackground(VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex) {
+    const uint32_t frameDataOffset = static_cast<uint32_t>(commandBufferIndex * this->frameDataStride);
         
     if (this->hasSkybox) {
         vkCmdBindDescriptorSets(
             commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-            this->skyboxGraphicsPipelineLayout, 0, 1, &this->skyboxDescriptorSets[commandBufferIndex], 0, nullptr);
+            this->skyboxGraphicsPipelineLayout, 0, 1, &this->skyboxDescriptorSets[commandBufferIndex], 1, &frameDataOffset);
     
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->skyboxGraphicsPipeline);
 
@@ -127,7 +303,7 @@ VkCommandBuffer Graphics::createCommandBuffer(uint16_t commandBufferIndex) {
     if (this->hasTerrain) {
         vkCmdBindDescriptorSets(
             commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-            this->terrainGraphicsPipelineLayout, 0, 1, &this->terrainDescriptorSets[commandBufferIndex], 0, nullptr);
+            this->terrainGraphicsPipelineLayout, 0, 1, &this->terrainDescriptorSets[commandBufferIndex], 1, &frameDataOffset);
     
         vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->terrainGraphicsPipeline);
 
@@ -140,50 +316,153 @@ VkCommandBuffer Graphics::createCommandBuffer(uint16_t commandBufferIndex) {
             vkCmdDrawIndexed(commandBuffer, this->terrain->getIndices().size(), 1, 0, 0, 0);
         } else vkCmdDraw(commandBuffer, this->terrain->getVertices().size(), 1, 0, 0);
     }
+}
 
-    if (this->graphicsPipeline != nullptr && !this->requiresUpdateSwapChain) {
-        if (this->vertexBuffer != nullptr) {
-            vkCmdBindDescriptorSets(
-                commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                this->graphicsPipelineLayout, 0, 1, &this->descriptorSets[commandBufferIndex], 0, nullptr);
-            
-            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->graphicsPipeline);
+void Graphics::updateUniformBuffer(uint32_t currentImage) {
+    ModelUniforms modelUniforms {};
+    modelUniforms.camera = glm::vec4(Camera::instance()->getPosition(),1);
+    modelUniforms.sun = glm::vec4(0.0f, 100.0f, 100.0f, 1);
+    modelUniforms.viewMatrix = Camera::instance()->getViewMatrix();
+    modelUniforms.projectionMatrix = Camera::instance()->getProjectionMatrix();
 
-            VkBuffer vertexBuffers[] = {this->vertexBuffer};
-            VkDeviceSize offsets[] = {0};
-            vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-        }
-            
-        if (this->indexBuffer != nullptr) {
-            vkCmdBindIndexBuffer(commandBuffer, this->indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-            this->draw(commandBuffer, true);
-        } else {
-            this->draw(commandBuffer, false);       
-        }
+    // the slice is handed out anew every frame, the uniforms always come first
+    this->frameDataUsage[currentImage] = 0;
+    
+    VkDeviceSize offset = 0;
+    void * data = this->allocateFrameData(currentImage, sizeof(modelUniforms), offset);
+    if (data != nullptr) memcpy(data, &modelUniforms, sizeof(modelUniforms));
+}
+
+void * Graphics::allocateFrameData(uint32_t frameIndex, VkDeviceSize size, VkDeviceSize & offset) {
+    if (frameIndex >= this->frameDataUsage.size() || this->frameDataBufferMemory.data == nullptr) return nullptr;
+    
+    const VkDeviceSize start = this->alignFrameData(this->frameDataUsage[frameIndex]);
+    if (start + size > this->frameDataStride) {
+        std::cerr << "Frame Data exceeds " << this->frameDataStride << " bytes" << std::endl;
+        return nullptr;
     }
+    
+    this->frameDataUsage[frameIndex] = start + size;
+    offset = frameIndex * this->frameDataStride + start;
+    
+    return static_cast<char *>(this->frameDataBufferMemory.data) + offset;
+}
 
-    vkCmdEndRenderPass(commandBuffer);
+void Graphics::updateFrameDataSize() {
+    const VkDeviceSize requiredStride = this->requiredFrameDataStride;
+    if (requiredStride <= this->frameDataStride) return;
+    
+    // leaves room for the scene to grow some more before the next resize
+    const VkDeviceSize stride = this->alignFrameData(std::max(requiredStride, this->frameDataStride * 2));
+    
+    bool succeeded = false;
+    this->workerQueue.runExclusively([this, stride, &succeeded]() {
+        // frames in flight keep reading the old buffer through the old sets, both are retired like a replaced model buffer
+        const VkBuffer oldBuffer = this->frameDataBuffer;
+        MemoryAllocation oldBufferMemory = this->frameDataBufferMemory;
+        const VkDeviceSize oldStride = this->frameDataStride;
+        const std::vector<VkDescriptorSet> oldSkyboxSets = this->skyboxDescriptorSets;
+        const std::vector<VkDescriptorSet> oldTerrainSets = this->terrainDescriptorSets;
+        const VkDescriptorSet oldCullingSet = this->cullingDescriptorSet;
+        
+        this->frameDataBuffer = nullptr;
+        this->frameDataBufferMemory = MemoryAllocation();
+        
+        // the main sets go last, replacing them can't be undone
+        succeeded = this->createFrameDataBuffer(stride) &&
+            (oldSkyboxSets.empty() || this->createSkyboxDescriptorSets()) &&
+            (oldTerrainSets.empty() || this->createTerrainDescriptorSets()) &&
+            (oldCullingSet == nullptr || this->createCullingDescriptorSet()) &&
+            (this->descriptorSets.empty() || this->replaceDescriptorSets());
+        
+        const VkDevice device = this->device;
+        const VkDescriptorPool skyboxPool = this->skyboxDescriptorPool;
+        const VkDescriptorPool terrainPool = this->terrainDescriptorPool;
+        const VkDescriptorPool cullingPool = this->cullingDescriptorPool;
+        auto freeSets = [device](VkDescriptorPool pool, const std::vector<VkDescriptorSet> & sets) {
+            if (!sets.empty()) vkFreeDescriptorSets(device, pool, static_cast<uint32_t>(sets.size()), sets.data());
+        };
+        
+        if (!succeeded) {
+            if (this->skyboxDescriptorSets != oldSkyboxSets) freeSets(skyboxPool, this->skyboxDescriptorSets);
+            if (this->terrainDescriptorSets != oldTerrainSets) freeSets(terrainPool, this->terrainDescriptorSets);
+            if (this->cullingDescriptorSet != oldCullingSet) freeSets(cullingPool, { this->cullingDescriptorSet });
+            if (this->frameDataBuffer != nullptr) vkDestroyBuffer(this->device, this->frameDataBuffer, nullptr);
+            this->memoryAllocator.free(this->frameDataBufferMemory);
+            
+            this->skyboxDescriptorSets = oldSkyboxSets;
+            this->terrainDescriptorSets = oldTerrainSets;
+            this->cullingDescriptorSet = oldCullingSet;
+            this->frameDataBuffer = oldBuffer;
+            this->frameDataBufferMemory = oldBufferMemory;
+            this->frameDataStride = oldStride;
+            return;
+        }
+        
+        this->retireResource([this, freeSets, skyboxPool, terrainPool, cullingPool, oldSkyboxSets, oldTerrainSets, oldCullingSet, oldBuffer, oldBufferMemory]() mutable {
+            freeSets(skyboxPool, oldSkyboxSets);
+            freeSets(terrainPool, oldTerrainSets);
+            if (oldCullingSet != nullptr) freeSets(cullingPool, { oldCullingSet });
+            if (oldBuffer != nullptr) vkDestroyBuffer(this->device, oldBuffer, nullptr);
+            this->memoryAllocator.free(oldBufferMemory);
+        });
+    });
+    
+    if (!succeeded) std::cerr << "Failed to Grow Frame Data to " << stride << " bytes" << std::endl;
+}
 
-    ret = vkEndCommandBuffer(commandBuffer);
-    if (ret != VK_SUCCESS) {
-        std::cerr << "Failed to end  Recording Command Buffer!" << std::endl;
-        return nullptr;
+VkDeviceSize Graphics::getSceneFrameDataSize() {
+    // every component counted as visible, later additions grow the frame data on demand
+    VkDeviceSize numberOfTransforms = 0;
+    VkDeviceSize numberOfInstances = 0;
+    for (auto & model : this->models.getModels()) {
+        const VkDeviceSize numberOfComponents = this->components.getAllComponentsForModel(model->getId()).size();
+        numberOfTransforms += numberOfComponents;
+        numberOfInstances += numberOfComponents * model->getMeshes().size();
     }
+    
+    return this->alignFrameData(sizeof(struct ModelUniforms)) + this->getInstanceDataSize(numberOfTransforms, numberOfInstances);
+}
 
-    return commandBuffer;
+VkDeviceSize Graphics::alignFrameData(VkDeviceSize offset) {
+    return (offset + this->frameDataAlignment - 1) / this->frameDataAlignment * this->frameDataAlignment;
 }
 
-void Graphics::updateUniformBuffer(uint32_t currentImage) {
-    ModelUniforms modelUniforms {};
-    modelUniforms.camera = glm::vec4(Camera::instance()->getPosition(),1);
-    modelUniforms.sun = glm::vec4(0.0f, 100.0f, 100.0f, 1);
-    modelUniforms.viewMatrix = Camera::instance()->getViewMatrix();
-    modelUniforms.projectionMatrix = Camera::instance()->getProjectionMatrix();
+void Graphics::updateInstanceData(uint32_t currentImage, VkCommandBuffer commandBuffer) {
+    std::lock_guard<std::mutex> lock(this->instanceDataLock);
+    
+    auto instanceData = this->recordedInstanceData.find(commandBuffer);
+    if (instanceData == this->recordedInstanceData.end()) return;
+    
+    // lands right behind the uniforms, where the recorded dynamic offsets point
+    const InstanceData & data = instanceData->second;
+    this->markTexturesUsed(data.textures, this->getTextureClock());
+    
+    VkDeviceSize offset = 0;
+    char * frameData = static_cast<char *>(this->allocateFrameData(currentImage, data.size, offset));
+    if (frameData == nullptr) return;
+    
+    memcpy(frameData, data.transforms.data(), data.transforms.size() * sizeof(struct ModelProperties));
+    memcpy(frameData + data.instancesOffset, data.instances.data(), data.instances.size() * sizeof(struct InstanceProperties));
+    memcpy(frameData + data.drawCommandsOffset, data.drawCommands.data(), data.drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    memcpy(frameData + data.drawCountsOffset, data.drawCounts.data(), sizeof(data.drawCounts));
+    
+    if (data.culled) {
+        memcpy(frameData + data.boundsOffset, data.bounds.data(), data.bounds.size() * sizeof(struct InstanceBounds));
+        memcpy(frameData + data.drawIndicesOffset, data.drawIndices.data(), data.drawIndices.size() * sizeof(uint32_t));
+    }
+}
 
-    void* data;
-    vkMapMemory(this->device, this->uniformBuffersMemory[currentImage], 0, sizeof(modelUniforms), 0, &data);
-    memcpy(data, &modelUniforms, sizeof(modelUniforms));
-    vkUnmapMemory(this->device, this->uniformBuffersMemory[currentImage]);
+VkDeviceSize Graphics::getInstanceDataSize(VkDeviceSize numberOfTransforms, VkDeviceSize numberOfInstances) {
+    // every instance reference may start a draw of its own, the culling arrays are included whether they are used or not
+    return 
+        this->alignFrameData(numberOfTransforms * sizeof(struct ModelProperties)) + 
+        this->alignFrameData(numberOfInstances * sizeof(struct InstanceProperties)) + 
+        this->alignFrameData(numberOfInstances * sizeof(VkDrawIndexedIndirectCommand)) + 
+        this->alignFrameData(2 * sizeof(uint32_t)) + 
+        this->alignFrameData(numberOfTransforms * sizeof(struct InstanceBounds)) + 
+        this->alignFrameData(numberOfInstances * sizeof(uint32_t)) + 
+        numberOfInstances * sizeof(struct InstanceProperties);
 }
     
 void Graphics::drawFrame() {    
@@ -200,6 +479,12 @@ void Graphics::drawFrame() {
         return;
     }
     
+    this->releaseRetiredResources();
+    this->releaseUploadRegions();
+    this->updateGeometryCompaction();
+    this->updateTextureResidency();
+    this->updateFrameDataSize();
+    
     uint32_t imageIndex;
     ret = vkAcquireNextImageKHR(
         this->device, this->swapChain, UINT64_MAX, this->imageAvailableSemaphores[this->currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -210,39 +495,38 @@ void Graphics::drawFrame() {
         return;
     }
 
-    if (this->commandBuffers[imageIndex] != nullptr) {
-        this->workerQueue.queueCommandBufferForDeletion(this->commandBuffers[imageIndex]);
-    }
-
-    VkCommandBuffer latestCommandBuffer = this->workerQueue.getNextCommandBuffer(imageIndex);
-    std::chrono::high_resolution_clock::time_point nextBufferFetchStart = std::chrono::high_resolution_clock::now();
-    while (latestCommandBuffer == nullptr) {
-        std::chrono::duration<double, std::milli> fetchPeriod = std::chrono::high_resolution_clock::now() - nextBufferFetchStart;
-        if (fetchPeriod.count() > 2000) {
-            std::cout << "Could not get new buffer for quite a while!" << std::endl;
-            break;
-        }
-        latestCommandBuffer = this->workerQueue.getNextCommandBuffer(imageIndex);
-    }
-    std::chrono::duration<double, std::milli> timer = std::chrono::high_resolution_clock::now() - nextBufferFetchStart;
-    //if (timer.count() < 50) {
-    //    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(50 - timer.count()));
-    //}
-    //timer = std::chrono::high_resolution_clock::now() - nextBufferFetchStart;
-    //std::cout << "Fetch Time: " << timer.count() << " | " << this->workerQueue.getNumberOfItems(imageIndex) << std::endl;
-    
-    if (latestCommandBuffer == nullptr) return;
-    this->commandBuffers[imageIndex] = latestCommandBuffer;
-
-    this->updateUniformBuffer(imageIndex);
-        
+    // the recording submitted for this image last time is done with from here on, the queue may swap it for a newer one
     if (this->imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
         ret = vkWaitForFences(device, 1, &this->imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
         if (ret != VK_SUCCESS) {
              std::cerr << "vkWaitForFences 2 Failed" << std::endl;
         }
     }
-    this->imagesInFlight[imageIndex] = this->inFlightFences[this->currentFrame];
+
+    VkCommandBuffer latestCommandBuffer = this->workerQueue.acquireCommandBuffer(imageIndex);
+    if (latestCommandBuffer == nullptr && this->requiredFrameDataStride > this->frameDataStride) {
+        // the recording ran out of frame data, growing it records the frame again
+        this->updateFrameDataSize();
+        latestCommandBuffer = this->workerQueue.acquireCommandBuffer(imageIndex);
+    }
+    
+    // the acquired image is handed back either way, without a recording it is presented with what it held before
+    const bool hasCommandBuffer = latestCommandBuffer != nullptr;
+    bool presentable = true;
+    if (hasCommandBuffer) {
+        this->commandBuffers[imageIndex] = latestCommandBuffer;
+        
+        // the slice of this image is only safe to overwrite once the frame that last read it has finished
+        this->updateUniformBuffer(imageIndex);
+        this->updateInstanceData(imageIndex, this->commandBuffers[imageIndex]);
+        this->imagesInFlight[imageIndex] = this->inFlightFences[this->currentFrame];
+    } else {
+        std::cout << "Could not get a recorded command buffer, skipping the frame" << std::endl;
+        
+        // an image that was never rendered to isn't in present layout, recreating the swap chain releases it instead
+        presentable = this->imagesInFlight[imageIndex] != VK_NULL_HANDLE;
+        if (!presentable) this->requiresUpdateSwapChain = true;
+    }
 
     VkSubmitInfo submitInfo{};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -253,11 +537,11 @@ void Graphics::drawFrame() {
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
 
-    submitInfo.commandBufferCount = this->commandBuffers.empty() ? 0 : 1;
+    submitInfo.commandBufferCount = !hasCommandBuffer || this->commandBuffers.empty() ? 0 : 1;
     submitInfo.pCommandBuffers = &this->commandBuffers[imageIndex];
 
     VkSemaphore signalSemaphores[] = {this->renderFinishedSemaphores[this->currentFrame]};
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = presentable ? 1 : 0;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     ret = vkResetFences(this->device, 1, &this->inFlightFences[this->currentFrame]);
@@ -269,6 +553,9 @@ void Graphics::drawFrame() {
     if (ret != VK_SUCCESS) {
         std::cerr << "Failed to Submit Draw Command Buffer!" << std::endl;
     }
+    ++this->renderedFrames;
+    
+    if (!presentable) return;
     
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -300,7 +587,8 @@ void Graphics::drawFrame() {
     time_span = now - this->lastTimeMeasure;
     if (time_span.count() >= 1000) {
         this->lastTimeMeasure = now;
-        std::cout << "FPS: " << this->frameCount <<  std::endl;
+        std::cout << "FPS: " << this->frameCount << " | Draw Calls: " << this->drawCalls << 
+            " (" << this->indirectDraws << " indirect, " << this->instancesDrawn << " without instancing)" << std::endl;
         this->frameCount = 0;
     }
 }
@@ -310,186 +598,586 @@ bool Graphics::createBuffersFromModel() {
      
     if (bufferSizes.vertexBufferSize == 0) return true;
 
-    if (this->vertexBuffer != nullptr) vkDestroyBuffer(this->device, this->vertexBuffer, nullptr);
-    if (this->vertexBufferMemory != nullptr) vkFreeMemory(this->device, this->vertexBufferMemory, nullptr);
-
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    if (!this->createBuffer(
-            bufferSizes.vertexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory)) {
-        std::cerr << "Failed to get Create Staging Buffer" << std::endl;
-        return false;
+    if (!this->createModelBuffers(bufferSizes)) return false;
+    
+    std::vector<Model *> allModels;
+    for (auto & model : this->models.getModels()) {
+        if (!this->allocateModelGeometry(model.get())) return false;
+        allModels.push_back(model.get());
     }
+    
+    if (!this->uploadModelsContent(VERTEX, allModels) || 
+        !this->uploadModelsContent(INDEX, allModels) || 
+        !this->uploadModelsContent(SSBO, allModels)) return false;
+    
+    this->releaseModelGeometry(allModels);
+    
+    return true;
+}
 
-    void* data = nullptr;
-    vkMapMemory(this->device, stagingBufferMemory, 0, bufferSizes.vertexBufferSize, 0, &data);
-    this->copyModelsContentIntoBuffer(data, VERTEX, bufferSizes.vertexBufferSize);
-    vkUnmapMemory(this->device, stagingBufferMemory);
+bool Graphics::createModelBuffers(const BufferSummary & capacity) {
+    const std::array<ModelsContentType, 3> contentTypes = { VERTEX, INDEX, SSBO };
+    const std::array<VkDeviceSize, 3> capacities = { capacity.vertexBufferSize, capacity.indexBufferSize, capacity.ssboBufferSize };
 
-    if (!this->createBuffer(
-            bufferSizes.vertexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            this->vertexBuffer, this->vertexBufferMemory)) {
-        std::cerr << "Failed to get Create Vertex Buffer" << std::endl;
-        return false;
+    for (size_t i=0; i<contentTypes.size(); i++) {
+        this->geometryArenas[contentTypes[i]].reset(0);
+        if (capacities[i] == 0) continue;
+        
+        VkBuffer buffer = nullptr;
+        MemoryAllocation bufferMemory;
+        if (!this->createModelBuffer(contentTypes[i], capacities[i], buffer, bufferMemory)) return false;
+        
+        this->replaceModelBuffer(contentTypes[i], buffer, bufferMemory);
+        this->geometryArenas[contentTypes[i]].reset(capacities[i]);
     }
-
-    this->copyBuffer(stagingBuffer,this->vertexBuffer, bufferSizes.vertexBufferSize);
-
-    vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-    vkFreeMemory(this->device, stagingBufferMemory, nullptr);
     
-    // meshes (SSBOs)
-    if (!this->createSsboBufferFromModel(bufferSizes.ssboBufferSize, false)) return false;
-        
-    // indices
-    if (bufferSizes.indexBufferSize == 0) return true;
-
-    if (this->indexBuffer != nullptr) vkDestroyBuffer(this->device, this->indexBuffer, nullptr);
-    if (this->indexBufferMemory != nullptr) vkFreeMemory(this->device, this->indexBufferMemory, nullptr);
+    return true;
+}
 
-    if (!this->createBuffer(
-            bufferSizes.indexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-            stagingBuffer, stagingBufferMemory)) {
-        std::cerr << "Failed to get Create Staging Buffer" << std::endl;
-        return false;
+bool Graphics::createModelBuffer(ModelsContentType modelsContentType, VkDeviceSize capacity, VkBuffer & buffer, MemoryAllocation & bufferMemory) {
+    // growing and compacting copy the contents over into a new buffer
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    switch(modelsContentType) {
+        case VERTEX:
+            usage |= VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+            break;
+        case INDEX:
+            usage |= VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+            break;
+        case SSBO:
+            usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            break;
     }
-
-    data = nullptr;
-    vkMapMemory(this->device, stagingBufferMemory, 0, bufferSizes.indexBufferSize, 0, &data);
-    this->copyModelsContentIntoBuffer(data, INDEX, bufferSizes.indexBufferSize);
-    vkUnmapMemory(this->device, stagingBufferMemory);
-
-    if (!this->createBuffer(
-            bufferSizes.indexBufferSize,
-            VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            this->indexBuffer, this->indexBufferMemory)) {
-        std::cerr << "Failed to get Create Vertex Buffer" << std::endl;
+    
+    if (!this->createBuffer(capacity, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory)) {
+        std::cerr << "Failed to get Create Models Buffer" << std::endl;
         return false;
     }
     
-    this->copyBuffer(stagingBuffer,this->indexBuffer, bufferSizes.indexBufferSize);
-
-    vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-    vkFreeMemory(this->device, stagingBufferMemory, nullptr);
-    
     return true;
 }
 
-bool Graphics::createSsboBufferFromModel(VkDeviceSize bufferSize, bool makeHostWritable)
-{
-    if (bufferSize == 0) return true;
-
-    if (this->ssboBuffer != nullptr) vkDestroyBuffer(this->device, this->ssboBuffer, nullptr);
-    if (this->ssboBufferMemory != nullptr) vkFreeMemory(this->device, this->ssboBufferMemory, nullptr);
-
-    if (!makeHostWritable) {
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        if (!this->createBuffer(bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                stagingBuffer, stagingBufferMemory)) {
-            std::cerr << "Failed to get Create Staging Buffer" << std::endl;
-            return false;
-        }
-
-        void* data = nullptr;
-        vkMapMemory(this->device, stagingBufferMemory, 0, bufferSize, 0, &data);
-        this->copyModelsContentIntoBuffer(data, SSBO, bufferSize);
-        vkUnmapMemory(this->device, stagingBufferMemory);
-
-        if (!this->createBuffer(bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                this->ssboBuffer, this->ssboBufferMemory)) {
-            std::cerr << "Failed to get Create SSBO Buffer" << std::endl;
-            return false;
-        }
-
-        this->copyBuffer(stagingBuffer,this->ssboBuffer, bufferSize);
+VkBuffer & Graphics::getModelBuffer(ModelsContentType modelsContentType) {
+    switch(modelsContentType) {
+        case INDEX:
+            return this->indexBuffer;
+        case SSBO:
+            return this->ssboBuffer;
+        case VERTEX:
+        default:
+            return this->vertexBuffer;
+    }
+}
 
-        vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-        vkFreeMemory(this->device, stagingBufferMemory, nullptr);        
-    } else {
-        if (!this->createBuffer(
-                bufferSize,
-                VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                this->ssboBuffer, this->ssboBufferMemory)) {
-            std::cerr << "Failed to get Create Vertex Buffer" << std::endl;
-            return false;
-        }
+MemoryAllocation & Graphics::getModelBufferMemory(ModelsContentType modelsContentType) {
+    switch(modelsContentType) {
+        case INDEX:
+            return this->indexBufferMemory;
+        case SSBO:
+            return this->ssboBufferMemory;
+        case VERTEX:
+        default:
+            return this->vertexBufferMemory;
+    }
+}
 
-        void * data = nullptr;
-        vkMapMemory(this->device, ssboBufferMemory, 0, bufferSize, 0, &data);
-        this->copyModelsContentIntoBuffer(data, SSBO, bufferSize);
-        vkUnmapMemory(this->device, ssboBufferMemory);        
+void Graphics::replaceModelBuffer(ModelsContentType modelsContentType, VkBuffer buffer, MemoryAllocation & bufferMemory) {
+    VkBuffer oldBuffer = this->getModelBuffer(modelsContentType);
+    MemoryAllocation oldBufferMemory = this->getModelBufferMemory(modelsContentType);
+    
+    if (oldBuffer != nullptr || oldBufferMemory.isValid()) {
+        this->retireResource([this, oldBuffer, oldBufferMemory]() mutable {
+            if (oldBuffer != nullptr) vkDestroyBuffer(this->device, oldBuffer, nullptr);
+            this->memoryAllocator.free(oldBufferMemory);
+        });
     }
     
-    return true;
+    this->getModelBuffer(modelsContentType) = buffer;
+    this->getModelBufferMemory(modelsContentType) = bufferMemory;
 }
 
-void Graphics::draw(VkCommandBuffer & commandBuffer, bool useIndices) {
-    VkDeviceSize lastVertexOffset = 0;
-    VkDeviceSize lastIndexOffset = 0;
-    uint32_t firstInstanceMesh = 0;
-
-    auto & allModels = this->models.getModels();
+bool Graphics::allocateModelGeometry(Model * model) {
+    const std::array<ModelsContentType, 3> contentTypes = { VERTEX, INDEX, SSBO };
     
-    for (auto & model :  allModels) {
-        auto meshes = model->getMeshes();
-        
-        for (Mesh & mesh : meshes) {
-            VkDeviceSize vertexSize = mesh.getVertices().size();
-            VkDeviceSize indexSize = mesh.getIndices().size();
+    for (Mesh & mesh : model->getMeshes()) {
+        for (ModelsContentType contentType : contentTypes) {
+            if (mesh.getGeometryHandle(contentType) != GeometryArena::INVALID_HANDLE) continue;
             
-            if (this->requiresUpdateSwapChain) return;
+            const VkDeviceSize size = this->getMeshContentSize(mesh, contentType);
+            const VkDeviceSize alignment = this->getMeshContentAlignment(mesh, contentType);
             
-            auto allComponents = this->components.getAllComponentsForModel(model->getId());
-            for (auto & comp : allComponents) {
-                if (!comp->isVisible() || (this->useFrustumCulling && !Camera::instance()->isInFrustum(comp->getPosition()))) continue;
-                
-                ModelProperties props = { comp->getModelMatrix()};
-                
-                vkCmdPushConstants(
-                    commandBuffer, this->graphicsPipelineLayout,
-                    VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(struct ModelProperties), &props);
-
-                if (useIndices) {                
-                    vkCmdDrawIndexed(commandBuffer, indexSize , 1, lastIndexOffset, lastVertexOffset, firstInstanceMesh);
-                } else {
-                    vkCmdDraw(commandBuffer, vertexSize, 1, 0, firstInstanceMesh);
-                }
+            uint32_t handle = GeometryArena::INVALID_HANDLE;
+            if (!this->geometryArenas[contentType].allocate(size, alignment, handle) && 
+                (!this->growModelBuffer(contentType, size + alignment) || 
+                 !this->geometryArenas[contentType].allocate(size, alignment, handle))) {
+                std::cerr << "Failed to allocate Geometry of Model " << model->getId() << std::endl;
+                this->freeModelGeometry(model);
+                return false;
             }
-                        
-            lastIndexOffset += indexSize;
-            lastVertexOffset += vertexSize;
-            firstInstanceMesh++;
+            
+            mesh.setGeometryHandle(contentType, handle);
         }
     }
+    
+    return true;
 }
 
-Component * Graphics::addComponentWithModel(std::string id, std::string modelId) {
-    Model * model = this->models.findModel(modelId);
-    if (model == nullptr) return nullptr;
+void Graphics::freeModelGeometry(Model * model) {
+    const std::array<ModelsContentType, 3> contentTypes = { VERTEX, INDEX, SSBO };
     
-    return this->components.addComponent(new Component(id, model));
+    for (Mesh & mesh : model->getMeshes()) {
+        for (ModelsContentType contentType : contentTypes) {
+            this->geometryArenas[contentType].free(mesh.getGeometryHandle(contentType));
+            mesh.setGeometryHandle(contentType, GeometryArena::INVALID_HANDLE);
+        }
+    }
 }
 
+void Graphics::releaseModelGeometry(const std::vector<Model *> & models) {
+    VkDeviceSize releasedSize = 0;
+    for (Model * model : models) releasedSize += model->releaseGeometry();
+    
+    if (releasedSize == 0) return;
+    
+    size_t residentSize = 0;
+    size_t peakResidentSize = 0;
+    std::cout << "Released CPU Geometry: " << releasedSize / MEGA_BYTE << " MB";
+    if (Utils::getResidentSetSize(residentSize, peakResidentSize)) {
+        std::cout << ", Resident Set Size: " << residentSize / MEGA_BYTE << " MB, peak " << peakResidentSize / MEGA_BYTE << " MB";
+    }
+    std::cout << std::endl;
+}
 
-void Graphics::addText(std::string id, std::string font, std::string text, uint16_t size) {
-    this->models.addTextModel(id, this->getAppPath(FONTS) / font, text, size);
+bool Graphics::growModelBuffer(ModelsContentType modelsContentType, VkDeviceSize requiredSize) {
+    GeometryArena & arena = this->geometryArenas[modelsContentType];
+    const VkDeviceSize oldCapacity = arena.getCapacity();
+    
+    // doubling keeps the number of reallocations logarithmic
+    const VkDeviceSize capacity = std::max(oldCapacity * 2, oldCapacity + requiredSize);
+    
+    VkBuffer buffer = nullptr;
+    MemoryAllocation bufferMemory;
+    if (!this->createModelBuffer(modelsContentType, capacity, buffer, bufferMemory)) return false;
+    
+    // everything keeps its offset, so the handles stay valid and only the new tail is free
+    bool succeeded = true;
+    if (this->getModelBuffer(modelsContentType) != nullptr && oldCapacity > 0) {
+        succeeded = this->recordModelBufferCopies(this->getModelBuffer(modelsContentType), buffer, { { 0, 0, oldCapacity } }) && 
+            this->flushUploadRing();
+        
+        // uploads into the grown range go through the transfer queue and must not be overtaken by the copy
+        this->releaseUploadRegions(true);
+    }
+    
+    if (!succeeded) {
+        std::cerr << "Failed to grow Models Buffer" << std::endl;
+        vkDestroyBuffer(this->device, buffer, nullptr);
+        this->memoryAllocator.free(bufferMemory);
+        return false;
+    }
+    
+    this->replaceModelBuffer(modelsContentType, buffer, bufferMemory);
+    arena.grow(capacity);
+    
+    return true;
 }
 
-void Graphics::addModel(Model * model) {
-     std::unique_ptr<Model> modelPtr(model);
-     if (model->hasBeenLoaded()) this->models.addModel(modelPtr.release());
+bool Graphics::recordModelBufferCopies(VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy> & regions) {
+    // the model buffers belong to the graphics queue family, so are copied on it
+    VkCommandBuffer commandBuffer = this->getUploadGraphicsCommandBuffer();
+    if (commandBuffer == nullptr) return false;
+    
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    
+    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, static_cast<uint32_t>(regions.size()), regions.data());
+    
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, 
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
+        0, 1, &barrier, 0, nullptr, 0, nullptr);
+    
+    return true;
 }
 
-void Graphics::addModel(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> indices, std::string name) {
-     std::unique_ptr<Model> model = std::make_unique<Model>(vertices, indices, name);
-     if (model->hasBeenLoaded()) this->models.addModel(model.release());
+void Graphics::updateGeometryCompaction() {
+    if (this->geometryCompaction != nullptr) {
+        if (this->completedUploadBatches >= this->geometryCompaction->uploadBatch) this->finishGeometryCompaction();
+        return;
+    }
+    
+    const std::array<ModelsContentType, 3> contentTypes = { VERTEX, INDEX, SSBO };
+    for (ModelsContentType contentType : contentTypes) {
+        const GeometryArena & arena = this->geometryArenas[contentType];
+        const VkDeviceSize freeSize = arena.getCapacity() - arena.getUsedSize();
+        
+        // only worth it if removed models left enough space scattered in holes
+        if (freeSize < arena.getCapacity() * GEOMETRY_COMPACTION_MIN_FREE || 
+            arena.getFragmentation() < GEOMETRY_COMPACTION_THRESHOLD) continue;
+        
+        if (!this->startGeometryCompaction(contentType)) std::cerr << "Failed to compact Models Buffer" << std::endl;
+        return;
+    }
+}
+
+bool Graphics::startGeometryCompaction(ModelsContentType modelsContentType) {
+    std::unique_ptr<GeometryCompaction> compaction = std::make_unique<GeometryCompaction>();
+    compaction->modelsContentType = modelsContentType;
+    compaction->moves = this->geometryArenas[modelsContentType].planCompaction();
+    
+    // frames keep reading the old buffer, the packed copy is swapped in once the gpu is done with it
+    if (!this->createModelBuffer(
+        modelsContentType, this->geometryArenas[modelsContentType].getCapacity(), compaction->buffer, compaction->bufferMemory)) return false;
+    
+    std::vector<VkBufferCopy> regions;
+    for (const GeometryMove & move : compaction->moves) {
+        if (!regions.empty() && regions.back().srcOffset + regions.back().size == move.srcOffset && 
+            regions.back().dstOffset + regions.back().size == move.dstOffset) {
+            regions.back().size += move.size;
+            continue;
+        }
+        regions.push_back({ move.srcOffset, move.dstOffset, move.size });
+    }
+    
+    if (!regions.empty() && (
+        !this->recordModelBufferCopies(this->getModelBuffer(modelsContentType), compaction->buffer, regions) || !this->flushUploadRing())) {
+        this->releaseUploadRegions(true);
+        vkDestroyBuffer(this->device, compaction->buffer, nullptr);
+        this->memoryAllocator.free(compaction->bufferMemory);
+        return false;
+    }
+    
+    compaction->uploadBatch = this->submittedUploadBatches;
+    this->geometryCompaction = std::move(compaction);
+    
+    return true;
+}
+
+void Graphics::finishGeometryCompaction(bool wait) {
+    if (this->geometryCompaction == nullptr) return;
+    
+    if (wait) this->releaseUploadRegions(true);
+    
+    std::unique_ptr<GeometryCompaction> compaction = std::move(this->geometryCompaction);
+    bool succeeded = true;
+    
+    this->workerQueue.runExclusively([this, &compaction, &succeeded]() {
+        this->geometryArenas[compaction->modelsContentType].applyCompaction(compaction->moves);
+        this->replaceModelBuffer(compaction->modelsContentType, compaction->buffer, compaction->bufferMemory);
+        
+        if (compaction->modelsContentType == SSBO) succeeded = this->replaceDescriptorSets();
+    });
+    
+    if (!succeeded) std::cerr << "Failed to replace Descriptor Sets after Compaction" << std::endl;
+}
+
+bool Graphics::uploadModelsContent(ModelsContentType modelsContentType, const std::vector<Model *> & models) {
+    VkBuffer buffer = this->getModelBuffer(modelsContentType);
+    const GeometryArena & arena = this->geometryArenas[modelsContentType];
+    
+    // meshes are packed straight into the mapped upload ring, only meshes exceeding a chunk are packed in host memory first
+    for (Model * model : models) {
+        for (Mesh & mesh : model->getMeshes()) {
+            const uint32_t handle = mesh.getGeometryHandle(modelsContentType);
+            const VkDeviceSize meshOffset = arena.getOffset(handle);
+            const VkDeviceSize meshSize = arena.getSize(handle);
+            if (meshSize == 0) continue;
+            
+            if (meshSize <= UPLOAD_RING_CHUNK_SIZE) {
+                VkDeviceSize ringOffset = 0;
+                if (!this->reserveUploadRing(meshSize, ringOffset)) return false;
+                
+                this->copyMeshContentIntoBuffer(mesh, static_cast<char *>(this->uploadRingData) + ringOffset, modelsContentType);
+                this->recordUploadCopy(buffer, ringOffset, meshOffset, meshSize);
+                continue;
+            }
+            
+            std::vector<char> meshContent(meshSize);
+            this->copyMeshContentIntoBuffer(mesh, meshContent.data(), modelsContentType);
+            if (!this->uploadToBuffer(buffer, meshOffset, meshContent.data(), meshSize)) return false;
+        }
+    }
+    
+    return this->flushUploadRing();
+}
+
+bool Graphics::collectDraws(uint16_t commandBufferIndex, bool useIndices, InstanceData & instanceData) {
+    // the draw list goes into the frame data, one indirect submission per index type
+    instanceData.indirect = useIndices && this->supportsDrawIndirectFirstInstance;
+    instanceData.culled = instanceData.indirect && this->isCullingActive();
+    
+    auto & allModels = this->models.getModels();
+    
+    // each model is gathered on a worker of its own, its transform indices and first instances start at 0 until merged
+    std::vector<ModelDraws> modelDraws(allModels.size());
+    
+    this->recordingWorkers->execute(allModels.size(), [&](size_t m) {
+        auto & model = allModels[m];
+        ModelDraws & draws = modelDraws[m];
+        
+        // the visible components as (lod, transform index), sorted so that components sharing a lod are adjacent
+        std::vector<std::pair<uint32_t, uint32_t>> visibleComponents;
+        
+        auto allComponents = this->components.getAllComponentsForModel(model->getId());
+        for (auto & comp : allComponents) {
+            if (!comp->isVisible()) continue;
+            
+            comp->updateLod(this->getProjectedScreenSize(model->getBoundingBox(), comp->getModelMatrix()));
+            if (!instanceData.culled && this->useFrustumCulling && !Camera::instance()->isInFrustum(comp->getPosition())) continue;
+            
+            visibleComponents.push_back(std::make_pair(comp->getLod(), static_cast<uint32_t>(draws.transforms.size())));
+            draws.transforms.push_back({ comp->getModelMatrix() });
+            if (instanceData.culled) {
+                const BoundingBox & bbox = model->getBoundingBox();
+                draws.bounds.push_back({ glm::vec4(bbox.min, 1.0f), glm::vec4(bbox.max, 1.0f) });
+            }
+        }
+        
+        if (visibleComponents.empty()) return;
+        
+        std::sort(visibleComponents.begin(), visibleComponents.end());
+        draws.instances.reserve(visibleComponents.size() * model->getMeshes().size());
+        
+        for (Mesh & mesh : model->getMeshes()) {
+            if (this->requiresUpdateSwapChain) return;
+            
+            // 16 and 32 bit ranges are aligned to their index size, with the index buffer bound at 0 the first index is absolute
+            const uint32_t firstIndex = 
+                static_cast<uint32_t>(this->geometryArenas[INDEX].getOffset(mesh.getGeometryHandle(INDEX)) / mesh.getIndexSize());
+            const uint32_t vertexOffset = 
+                this->geometryArenas[VERTEX].getOffset(mesh.getGeometryHandle(VERTEX)) / sizeof(class PackedModelVertex);
+            const uint32_t ssboIndex = this->geometryArenas[SSBO].getOffset(mesh.getGeometryHandle(SSBO)) / sizeof(struct MeshProperties);
+            auto & meshDrawCommands = draws.drawCommands[mesh.getIndexType() == VK_INDEX_TYPE_UINT16 ? 0 : 1];
+            
+            this->collectTextures(mesh, draws.textures);
+            
+            // one instanced draw per lod that is in use for this mesh, without indices the index count is the vertex count
+            const uint32_t lastLod = mesh.getLodCount() - 1;
+            for (size_t c=0; c<visibleComponents.size();) {
+                const uint32_t lod = std::min(visibleComponents[c].first, lastLod);
+                const uint32_t firstInstance = static_cast<uint32_t>(draws.instances.size());
+                
+                for (; c<visibleComponents.size() && std::min(visibleComponents[c].first, lastLod) == lod; c++) {
+                    draws.instances.push_back({ visibleComponents[c].second, ssboIndex });
+                }
+                
+                const uint32_t instanceCount = static_cast<uint32_t>(draws.instances.size()) - firstInstance;
+                
+                if (useIndices) {
+                    meshDrawCommands.push_back({
+                        mesh.getLodIndexCount(lod), instanceCount, static_cast<uint32_t>(firstIndex + mesh.getLodFirstIndex(lod)), 
+                        static_cast<int32_t>(vertexOffset), firstInstance
+                    });
+                } else {
+                    meshDrawCommands.push_back({ mesh.getVertexCount(), instanceCount, 0, static_cast<int32_t>(vertexOffset), firstInstance });
+                }
+            }
+        }
+    });
+    
+    if (this->requiresUpdateSwapChain) return false;
+    
+    size_t numberOfTransforms = 0;
+    size_t numberOfInstances = 0;
+    for (const ModelDraws & draws : modelDraws) {
+        numberOfTransforms += draws.transforms.size();
+        numberOfInstances += draws.instances.size();
+    }
+    
+    if (numberOfTransforms == 0) return false;
+    
+    instanceData.transforms.reserve(numberOfTransforms);
+    instanceData.bounds.reserve(instanceData.culled ? numberOfTransforms : 0);
+    instanceData.instances.reserve(numberOfInstances);
+    
+    // the models' ranges are laid out one after the other in model order
+    std::array<std::vector<VkDrawIndexedIndirectCommand>, 2> drawCommands;
+    for (ModelDraws & draws : modelDraws) {
+        const uint32_t firstTransform = static_cast<uint32_t>(instanceData.transforms.size());
+        const uint32_t firstInstance = static_cast<uint32_t>(instanceData.instances.size());
+        
+        instanceData.transforms.insert(instanceData.transforms.end(), draws.transforms.begin(), draws.transforms.end());
+        instanceData.bounds.insert(instanceData.bounds.end(), draws.bounds.begin(), draws.bounds.end());
+        
+        for (InstanceProperties & instance : draws.instances) {
+            instance.modelPropertiesIndex += firstTransform;
+            instanceData.instances.push_back(instance);
+        }
+        
+        for (size_t t=0; t<drawCommands.size(); t++) {
+            for (VkDrawIndexedIndirectCommand & drawCommand : draws.drawCommands[t]) {
+                drawCommand.firstInstance += firstInstance;
+                drawCommands[t].push_back(drawCommand);
+            }
+        }
+        
+        instanceData.textures.insert(instanceData.textures.end(), draws.textures.begin(), draws.textures.end());
+    }
+    
+    std::sort(instanceData.textures.begin(), instanceData.textures.end());
+    instanceData.textures.erase(std::unique(instanceData.textures.begin(), instanceData.textures.end()), instanceData.textures.end());
+    
+    instanceData.drawCounts = { static_cast<uint32_t>(drawCommands[0].size()), static_cast<uint32_t>(drawCommands[1].size()) };
+    instanceData.drawCommands.reserve(drawCommands[0].size() + drawCommands[1].size());
+    for (auto & commands : drawCommands) {
+        instanceData.drawCommands.insert(instanceData.drawCommands.end(), commands.begin(), commands.end());
+    }
+    
+    // the culling pass counts the visible instances of every draw up from 0
+    if (instanceData.culled) {
+        instanceData.drawIndices.resize(instanceData.instances.size());
+        for (size_t d=0; d<instanceData.drawCommands.size(); d++) {
+            VkDrawIndexedIndirectCommand & drawCommand = instanceData.drawCommands[d];
+            std::fill_n(instanceData.drawIndices.begin() + drawCommand.firstInstance, drawCommand.instanceCount, static_cast<uint32_t>(d));
+            drawCommand.instanceCount = 0;
+        }
+    }
+    
+    instanceData.instancesOffset = this->alignFrameData(instanceData.transforms.size() * sizeof(struct ModelProperties));
+    instanceData.drawCommandsOffset = 
+        instanceData.instancesOffset + this->alignFrameData(instanceData.instances.size() * sizeof(struct InstanceProperties));
+    instanceData.drawCountsOffset = 
+        instanceData.drawCommandsOffset + this->alignFrameData(instanceData.drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand));
+    instanceData.size = instanceData.drawCountsOffset + sizeof(instanceData.drawCounts);
+    
+    if (instanceData.culled) {
+        instanceData.boundsOffset = this->alignFrameData(instanceData.size);
+        instanceData.drawIndicesOffset = 
+            instanceData.boundsOffset + this->alignFrameData(instanceData.bounds.size() * sizeof(struct InstanceBounds));
+        instanceData.culledInstancesOffset = 
+            instanceData.drawIndicesOffset + this->alignFrameData(instanceData.drawIndices.size() * sizeof(uint32_t));
+        instanceData.size = instanceData.culledInstancesOffset + instanceData.instances.size() * sizeof(struct InstanceProperties);
+    }
+    
+    // the render thread grows the frame data and has the frame recorded again before it submits anything
+    const VkDeviceSize requiredStride = this->alignFrameData(this->alignFrameData(sizeof(struct ModelUniforms)) + instanceData.size);
+    if (requiredStride > this->frameDataStride) {
+        if (requiredStride > this->requiredFrameDataStride) this->requiredFrameDataStride = requiredStride;
+        return false;
+    }
+    
+    return true;
+}
+
+uint32_t Graphics::draw(
+    VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex, const InstanceData & instanceData, bool useIndices, 
+    uint32_t firstDrawCommand, uint32_t lastDrawCommand) {
+    // the vertex shader reads the references the culling pass wrote if there was one
+    const uint32_t frameDataOffset = static_cast<uint32_t>(commandBufferIndex * this->frameDataStride);
+    const VkDeviceSize instanceDataOffset = frameDataOffset + this->alignFrameData(sizeof(struct ModelUniforms));
+    const std::array<uint32_t, 3> dynamicOffsets = {
+        frameDataOffset, 
+        static_cast<uint32_t>(instanceDataOffset), 
+        static_cast<uint32_t>(instanceDataOffset + (instanceData.culled ? instanceData.culledInstancesOffset : instanceData.instancesOffset))
+    };
+    
+    vkCmdBindDescriptorSets(
+        commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+        this->graphicsPipelineLayout, 0, 1, &this->descriptorSets[commandBufferIndex], 
+        static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+    
+    const std::array<VkIndexType, 2> indexTypes = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+    const VkDeviceSize drawCommandsOffset = instanceDataOffset + instanceData.drawCommandsOffset;
+    const VkDeviceSize drawCountsOffset = instanceDataOffset + instanceData.drawCountsOffset;
+    uint32_t numberOfDrawCalls = 0;
+    uint32_t typeDrawCommand = 0;
+    
+    // only the part of each index type's commands that falls into [firstDrawCommand, lastDrawCommand)
+    for (size_t t=0; t<indexTypes.size(); t++) {
+        const uint32_t typeDrawCount = instanceData.drawCounts[t];
+        const uint32_t first = std::max(firstDrawCommand, typeDrawCommand);
+        const uint32_t last = std::min(lastDrawCommand, typeDrawCommand + typeDrawCount);
+        typeDrawCommand += typeDrawCount;
+        if (first >= last) continue;
+        
+        const uint32_t drawCount = last - first;
+        
+        if (useIndices) vkCmdBindIndexBuffer(commandBuffer, this->indexBuffer, 0, indexTypes[t]);
+        
+        if (instanceData.indirect) {
+            VkDeviceSize offset = drawCommandsOffset + first * sizeof(VkDrawIndexedIndirectCommand);
+            if (this->cmdDrawIndexedIndirectCount != nullptr && drawCount == typeDrawCount && drawCount <= this->maxDrawIndirectCount) {
+                this->cmdDrawIndexedIndirectCount(
+                    commandBuffer, this->frameDataBuffer, offset, this->frameDataBuffer, drawCountsOffset + t * sizeof(uint32_t), 
+                    drawCount, sizeof(VkDrawIndexedIndirectCommand));
+                numberOfDrawCalls++;
+            } else {
+                for (uint32_t d=0; d<drawCount; d+=this->maxDrawIndirectCount) {
+                    const uint32_t count = std::min(drawCount - d, this->maxDrawIndirectCount);
+                    vkCmdDrawIndexedIndirect(commandBuffer, this->frameDataBuffer, offset, count, sizeof(VkDrawIndexedIndirectCommand));
+                    offset += count * sizeof(VkDrawIndexedIndirectCommand);
+                    numberOfDrawCalls++;
+                }
+            }
+        } else {
+            for (uint32_t d=first; d<last; d++) {
+                const VkDrawIndexedIndirectCommand & drawCommand = instanceData.drawCommands[d];
+                if (useIndices) {
+                    vkCmdDrawIndexed(
+                        commandBuffer, drawCommand.indexCount, drawCommand.instanceCount, drawCommand.firstIndex, 
+                        drawCommand.vertexOffset, drawCommand.firstInstance);
+                } else {
+                    vkCmdDraw(
+                        commandBuffer, drawCommand.indexCount, drawCommand.instanceCount, 
+                        static_cast<uint32_t>(drawCommand.vertexOffset), drawCommand.firstInstance);
+                }
+                numberOfDrawCalls++;
+            }
+        }
+    }
+    
+    return numberOfDrawCalls;
+}
+
+float Graphics::getProjectedScreenSize(BoundingBox & bbox, const glm::mat4 & modelMatrix) {
+    const glm::vec3 min = glm::vec3(modelMatrix * glm::vec4(bbox.min, 1.0f));
+    const glm::vec3 max = glm::vec3(modelMatrix * glm::vec4(bbox.max, 1.0f));
+    
+    const float radius = glm::length(max - min) * 0.5f;
+    const float distance = glm::length((min + max) * 0.5f - Camera::instance()->getPosition());
+    
+    if (!std::isfinite(radius) || distance <= radius) return std::numeric_limits<float>::max();
+    
+    return radius / (distance * std::tan(glm::radians(Camera::instance()->getFovY()) * 0.5f)) * this->swapChainExtent.height;
+}
+
+Component * Graphics::addComponentWithModel(std::string id, std::string modelId) {
+    Model * model = this->models.findModel(modelId);
+    if (model == nullptr) return nullptr;
+    
+    Component * component = nullptr;
+    this->workerQueue.runExclusively([this, &component, &id, model]() {
+        component = this->components.addComponent(new Component(id, model));
+        
+        // the next frame grows the frame data before it acquires an image, recordings needn't fail on it first
+        if (component != nullptr && this->frameDataBuffer != nullptr) {
+            const VkDeviceSize requiredStride = this->alignFrameData(this->getSceneFrameDataSize());
+            if (requiredStride > this->requiredFrameDataStride) this->requiredFrameDataStride = requiredStride;
+        }
+    });
+    
+    return component;
+}
+
+
+void Graphics::addText(std::string id, std::string font, std::string text, uint16_t size) {
+    this->models.addTextModel(id, this->getAppPath(FONTS) / font, text, size);
+}
+
+void Graphics::addModel(Model * model) {
+     std::unique_ptr<Model> modelPtr(model);
+     if (model->hasBeenLoaded()) this->models.addModel(modelPtr.release());
+}
+
+void Graphics::addModel(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> indices, std::string name) {
+     std::unique_ptr<Model> model = std::make_unique<Model>(vertices, indices, name);
+     if (model->hasBeenLoaded()) this->models.addModel(model.release());
 }
 
 void Graphics::addModel(const std::string & dir, const std::string & file) {
@@ -502,6 +1190,12 @@ void Graphics::toggleWireFrame() {
     this->requiresUpdateSwapChain = true;
 }
 
+void Graphics::toggleOcclusionCulling() {
+    this->useOcclusionCulling = !this->useOcclusionCulling;
+    this->requiresUpdateSwapChain = true;
+    std::cout << "Occlusion Culling: " << (this->useOcclusionCulling ? "on" : "off") << std::endl;
+}
+
 SDL_Window * Graphics::getSdlWindow() {
     return this->sdlWindow;
 }
@@ -514,59 +1208,566 @@ void Graphics::prepareModelTextures() {
         std::unique_ptr<Texture> emptyTexture = std::make_unique<Texture>(true, this->getWindowExtent());
         emptyTexture->setId(0);
         if (emptyTexture->isValid()) {
-            textures["dummy"] = std::move(emptyTexture);
-            std::cout << "dummy" << std::endl;
+            textures[Models::DUMMY_TEXTURE] = std::move(emptyTexture);
+            std::cout << Models::DUMMY_TEXTURE << std::endl;
         }
     }
 
     for (auto & texture : textures) {
-        VkDeviceSize imageSize = texture.second->getSize();
+        if (!this->uploadTexture(texture.second.get())) break;
+    }
+    
+    this->flushUploadRing();
+    
+    std::cout << "Number of Textures: " << textures.size() << std::endl;
+}
+
+bool Graphics::uploadTexture(Texture * texture) {
+    TextureStreamRequest request;
+    bool succeeded = false;
+    
+    // streamable textures start out with their tail only, the residency update streams in the levels above once they are drawn
+    if (texture->isStreamable()) {
+        const uint32_t initialMipLevel = texture->getMipLevelForSize(TEXTURE_INITIAL_SIZE);
+        succeeded = this->uploadStreamedTexture(texture, initialMipLevel, initialMipLevel, request);
+    } else succeeded = this->uploadTextureImage(texture, request.image, request.imageMemory, request.imageView);
+    
+    // the texture owns the image even if the upload failed, recorded copies may still reference it
+    texture->setTextureImage(request.image);
+    texture->setTextureImageMemory(request.imageMemory);
+    if (request.imageView != nullptr) texture->setTextureImageView(request.imageView);
+    texture->setImageMipLevel(request.imageMipLevel);
+    texture->setResidentMipLevel(request.residentMipLevel);
+    
+    if (texture->getId() >= 0 && texture->getId() < MAX_TEXTURES) {
+        this->textureLastUsed[texture->getId()] = texture->isStreamable() ? 0 : this->getTextureClock();
+    }
+    
+    texture->freeSurface();
+    
+    return succeeded;
+}
+
+bool Graphics::uploadTextureImage(Texture * texture, VkImage & textureImage, MemoryAllocation & textureImageMemory, VkImageView & textureImageView) {
+    const bool hasCookedMipLevels = texture->hasCookedMipLevels();
+    const uint32_t mipLevels = hasCookedMipLevels || this->supportsMipMapGeneration(texture->getImageFormat()) ? 
+        texture->getMipLevels() : 1;
+    
+    if (!this->createImage(
+        texture->getWidth(), texture->getHeight(), 
+        texture->getImageFormat(), 
+        VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+        textureImage, textureImageMemory, 1, mipLevels)) {
+            std::cerr << "Failed to Create Texture Image" << std::endl;
+            return false;
+    }
+
+    this->transitionImageLayout(
+        this->getUploadCommandBuffer(), textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, mipLevels);
+    
+    const std::vector<VkBufferImageCopy> regions = hasCookedMipLevels ? 
+        texture->getCookedMipLevels() : std::vector<VkBufferImageCopy> { this->getImageCopyRegion(texture->getWidth(), texture->getHeight()) };
+    
+    // blits need the graphics queue, mip generation takes the image over in transfer layout
+    const bool generatesMipMaps = !hasCookedMipLevels && mipLevels > 1;
+    
+    if (!this->uploadToImage(textureImage, texture->getPixels(), regions) || 
+        !this->releaseImageToGraphicsQueue(
+            textureImage, generatesMipMaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, mipLevels)) {
+        std::cerr << "Failed to Upload Texture Image" << std::endl;
+        return false;
+    }
+    
+    if (generatesMipMaps && 
+        !this->generateMipMaps(this->getUploadGraphicsCommandBuffer(), textureImage, texture->getWidth(), texture->getHeight(), mipLevels)) {
+        // the levels are still in transfer layout and must not be sampled, without a view the dummy texture is bound instead
+        std::cerr << "Failed to Generate Texture Mip Maps" << std::endl;
+        return false;
+    }
+
+    textureImageView = this->createImageView(textureImage, texture->getImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT, 1, mipLevels);
+    
+    return textureImageView != nullptr;
+}
+
+bool Graphics::uploadTextureMipLevels(Texture * texture, VkImage textureImage, uint32_t baseMipLevel, uint32_t levelCount) {
+    std::vector<VkBufferImageCopy> regions = texture->getCookedMipLevels();
+    if (regions.size() < levelCount) return false;
+    
+    regions.resize(levelCount);
+    for (VkBufferImageCopy & region : regions) region.imageSubresource.mipLevel += baseMipLevel;
+    
+    // only the written levels change layout, the ones below may be sampled meanwhile
+    return this->transitionImageLayout(
+            this->getUploadCommandBuffer(), textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, levelCount, baseMipLevel) &&
+        this->uploadToImage(textureImage, texture->getPixels(), regions) &&
+        this->releaseImageToGraphicsQueue(textureImage, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, levelCount, baseMipLevel);
+}
+
+bool Graphics::createStreamedTextureImage(Texture * texture, uint32_t imageMipLevel, uint32_t residentMipLevel, TextureStreamRequest & request) {
+    request.imageMipLevel = imageMipLevel;
+    request.residentMipLevel = residentMipLevel;
+    
+    // an image that holds the level already only gets the levels its view is missing
+    request.ownsImage = texture->getTextureImage() == nullptr || texture->getImageMipLevel() != imageMipLevel || 
+        residentMipLevel >= texture->getResidentMipLevel();
+    
+    const uint32_t mipLevels = texture->getStreamableMipLevels() - imageMipLevel;
+    const uint32_t endMipLevel = request.ownsImage ? texture->getStreamableMipLevels() : texture->getResidentMipLevel();
+    request.levelCount = endMipLevel - residentMipLevel;
+    
+    if (request.ownsImage) {
+        const VkExtent2D extent = texture->getMipLevelExtent(imageMipLevel);
+        if (!this->createImage(
+            extent.width, extent.height, 
+            texture->getImageFormat(), 
+            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
+            request.image, request.imageMemory, 1, mipLevels)) {
+                std::cerr << "Failed to Create Texture Image" << std::endl;
+                return false;
+        }
+    } else request.image = texture->getTextureImage();
+    
+    return true;
+}
+
+bool Graphics::uploadStreamedTexture(Texture * texture, uint32_t imageMipLevel, uint32_t residentMipLevel, TextureStreamRequest & request) {
+    if (!this->createStreamedTextureImage(texture, imageMipLevel, residentMipLevel, request)) return false;
+    
+    if (!texture->loadMipLevels(residentMipLevel) || 
+        !this->uploadTextureMipLevels(texture, request.image, residentMipLevel - imageMipLevel, request.levelCount)) {
+        std::cerr << "Failed to Upload Texture Image" << std::endl;
+        return false;
+    }
+    
+    request.imageView = this->createImageView(
+        request.image, texture->getImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT, 1, 
+        texture->getStreamableMipLevels() - residentMipLevel, residentMipLevel - imageMipLevel);
+    
+    return request.imageView != nullptr;
+}
+
+bool Graphics::uploadStagedTexture(Texture * texture, TextureStreamRequest & request) {
+    const uint32_t baseMipLevel = request.residentMipLevel - request.imageMipLevel;
+    
+    std::vector<VkBufferImageCopy> regions = *request.loadedRegions;
+    for (VkBufferImageCopy & region : regions) region.imageSubresource.mipLevel += baseMipLevel;
+    
+    VkCommandBuffer commandBuffer = this->getUploadCommandBuffer();
+    if (commandBuffer == nullptr || !this->transitionImageLayout(
+            commandBuffer, request.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, request.levelCount, baseMipLevel)) {
+        return false;
+    }
+    
+    vkCmdCopyBufferToImage(
+        commandBuffer, request.stagingBuffer, request.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 
+        static_cast<uint32_t>(regions.size()), regions.data());
+    
+    if (!this->releaseImageToGraphicsQueue(request.image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, 1, request.levelCount, baseMipLevel)) {
+        return false;
+    }
+    
+    request.imageView = this->createImageView(
+        request.image, texture->getImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT, 1, 
+        texture->getStreamableMipLevels() - request.residentMipLevel, baseMipLevel);
+    
+    return request.imageView != nullptr;
+}
+
+void Graphics::retireTextureStaging(TextureStreamRequest & request) {
+    VkBuffer stagingBuffer = request.stagingBuffer;
+    MemoryAllocation stagingBufferMemory = request.stagingBufferMemory;
+    
+    this->retireResource([this, stagingBuffer, stagingBufferMemory]() mutable {
+        if (stagingBuffer != nullptr) vkDestroyBuffer(this->device, stagingBuffer, nullptr);
+        this->memoryAllocator.free(stagingBufferMemory);
+    });
+}
+
+void Graphics::retireTextureImage(VkImage textureImage, MemoryAllocation & textureImageMemory, VkImageView textureImageView) {
+    MemoryAllocation imageMemory = textureImageMemory;
+    
+    this->retireResource([this, textureImage, imageMemory, textureImageView]() mutable {
+        if (textureImageView != nullptr) vkDestroyImageView(this->device, textureImageView, nullptr);
+        if (textureImage != nullptr) vkDestroyImage(this->device, textureImage, nullptr);
+        this->memoryAllocator.free(imageMemory);
+    });
+}
+
+uint64_t Graphics::getTextureClock() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+void Graphics::collectTextures(const Mesh & mesh, std::vector<int> & textures) {
+    const TextureInformation & textureInfo = mesh.getTextureInformation();
+    
+    for (const int id : { textureInfo.ambientTexture, textureInfo.diffuseTexture, textureInfo.specularTexture, textureInfo.normalTexture }) {
+        if (id >= 0 && id < MAX_TEXTURES) textures.push_back(id);
+    }
+}
+
+void Graphics::markTexturesUsed(const std::vector<int> & textures, uint64_t now) {
+    for (const int id : textures) {
+        this->textureLastUsed[id].store(now, std::memory_order_relaxed);
+    }
+}
+
+VkDeviceSize Graphics::getAnticipatedTextureSize(const std::string & location, Texture * texture) {
+    TextureStreamRequest * request = this->findTextureStreamRequest(location);
+    
+    return request != nullptr && request->ownsImage ? request->imageMemory.size : texture->getResidentSize();
+}
+
+TextureStreamRequest * Graphics::findTextureStreamRequest(const std::string & location) {
+    for (TextureStreamRequest & request : this->textureStreamRequests) {
+        if (request.location.compare(location) == 0) return &request;
+    }
+    
+    return nullptr;
+}
+
+bool Graphics::streamTexture(const std::string & location, Texture * texture, uint32_t imageMipLevel, uint32_t residentMipLevel) {
+    TextureStreamRequest request;
+    request.location = location;
+    
+    if (!this->createStreamedTextureImage(texture, imageMipLevel, residentMipLevel, request)) {
+        std::cerr << "Failed to stream Texture " << location << std::endl;
+        return false;
+    }
+    
+    const VkDeviceSize stagingSize = texture->getMipChainSize(residentMipLevel) - texture->getMipChainSize(residentMipLevel + request.levelCount);
+    if (!this->createBuffer(
+            stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
+            request.stagingBuffer, request.stagingBufferMemory)) {
+        std::cerr << "Failed to Create Texture Staging Buffer" << std::endl;
+        this->retireTextureImage(request.ownsImage ? request.image : nullptr, request.imageMemory, request.imageView);
+        return false;
+    }
+    
+    // the streaming thread reads the levels out of the cooked file into the staging buffer, the texture itself isn't touched
+    auto regions = std::make_shared<std::vector<VkBufferImageCopy>>();
+    const std::filesystem::path path = texture->getPath();
+    const uint32_t topMipLevel = texture->getTopMipLevel();
+    const uint32_t levelCount = request.levelCount;
+    void * stagingData = request.stagingBufferMemory.data;
+    
+    request.loadedRegions = regions;
+    request.loadJob = this->textureStreamQueue.addJob([path, topMipLevel, residentMipLevel, levelCount, stagingData, stagingSize, regions]() {
+        if (!Texture::readCookedMipLevels(path, topMipLevel, residentMipLevel, levelCount, stagingData, stagingSize, *regions)) regions->clear();
+    });
+    
+    // the batch is known once the copies are recorded and flushed
+    request.uploadBatch = UINT64_MAX;
+    this->textureStreamRequests.push_back(request);
+    
+    return true;
+}
+
+void Graphics::submitTextureStreaming() {
+    const uint64_t finishedJobs = this->textureStreamQueue.getFinishedJobs();
+    auto & textures = this->models.getTextures();
+    bool recordedCopies = false;
+    
+    for (auto it = this->textureStreamRequests.begin(); it != this->textureStreamRequests.end();) {
+        if (it->uploadBatch != UINT64_MAX || it->loadJob > finishedJobs) {
+            it++;
+            continue;
+        }
+        
+        // removed together with its model while the levels were read
+        auto texture = textures.find(it->location);
+        const bool removed = texture == textures.end() || (!it->ownsImage && texture->second->getTextureImage() != it->image);
+        
+        bool succeeded = !removed && !it->loadedRegions->empty();
+        if (!removed && !succeeded) std::cerr << "Failed to read Texture Levels of " << it->location << std::endl;
         
-        VkBuffer stagingBuffer = nullptr;
-        VkDeviceMemory stagingBufferMemory = nullptr;
-        if (!this->createBuffer(
-            imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory)) {
-                std::cerr << "Failed to Create Texture Staging Buffer" << std::endl;
-                return;
+        if (succeeded && !this->uploadStagedTexture(texture->second.get(), *it)) {
+            std::cerr << "Failed to stream Texture " << it->location << std::endl;
+            
+            // the copies recorded so far have to be done before the image goes
+            this->flushUploadRing();
+            this->releaseUploadRegions(true);
+            succeeded = false;
+        }
+        
+        if (!succeeded) {
+            this->retireTextureImage(it->ownsImage ? it->image : nullptr, it->imageMemory, it->imageView);
+            this->retireTextureStaging(*it);
+            it = this->textureStreamRequests.erase(it);
+            continue;
         }
+        
+        // tagged with the batch of the flush below
+        it->uploadBatch = this->submittedUploadBatches + 1;
+        recordedCopies = true;
+        it++;
+    }
+    
+    if (recordedCopies) this->flushUploadRing();
+}
 
-        void* data;
-        vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, texture.second->getPixels(), static_cast<size_t>(imageSize));
-        vkUnmapMemory(device, stagingBufferMemory);
+void Graphics::finishTextureStreaming() {
+    std::vector<TextureStreamRequest> finishedRequests;
+    for (auto it = this->textureStreamRequests.begin(); it != this->textureStreamRequests.end();) {
+        if (it->uploadBatch == UINT64_MAX || this->completedUploadBatches < it->uploadBatch) {
+            it++;
+            continue;
+        }
         
-        VkImage textureImage = nullptr;
-        VkDeviceMemory textureImageMemory = nullptr;
+        finishedRequests.push_back(*it);
+        it = this->textureStreamRequests.erase(it);
+    }
+    
+    if (finishedRequests.empty()) return;
+    
+    bool succeeded = true;
+    this->workerQueue.runExclusively([this, &finishedRequests, &succeeded]() {
+        auto & textures = this->models.getTextures();
         
-        if (!this->createImage(
-            texture.second->getWidth(), texture.second->getHeight(), 
-            texture.second->getImageFormat(), 
-            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-            textureImage, textureImageMemory)) {
-                std::cerr << "Failed to Create Texture Image" << std::endl;
-                return;
+        for (TextureStreamRequest & request : finishedRequests) {
+            auto texture = textures.find(request.location);
+            
+            // removed together with its model while streaming
+            this->retireTextureStaging(request);
+            
+            if (texture == textures.end() || (!request.ownsImage && texture->second->getTextureImage() != request.image)) {
+                this->retireTextureImage(request.ownsImage ? request.image : nullptr, request.imageMemory, request.imageView);
+                continue;
+            }
+            
+            // refined images stay, only the view that hid the new levels goes
+            MemoryAllocation unusedMemory;
+            if (request.ownsImage) {
+                this->retireTextureImage(
+                    texture->second->getTextureImage(), texture->second->getTextureImageMemory(), texture->second->getTextureImageView());
+                texture->second->setTextureImage(request.image);
+                texture->second->setTextureImageMemory(request.imageMemory);
+            } else this->retireTextureImage(nullptr, unusedMemory, texture->second->getTextureImageView());
+            
+            texture->second->setTextureImageView(request.imageView);
+            texture->second->setImageMipLevel(request.imageMipLevel);
+            texture->second->setResidentMipLevel(request.residentMipLevel);
         }
+        
+        succeeded = this->replaceDescriptorSets();
+    });
+    
+    if (!succeeded) std::cerr << "Failed to replace Descriptor Sets after Texture Streaming" << std::endl;
+}
 
-        transitionImageLayout(textureImage, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        this->copyBufferToImage(
-            stagingBuffer, textureImage, static_cast<uint32_t>(texture.second->getWidth()), static_cast<uint32_t>(texture.second->getHeight()));
-        transitionImageLayout(
-            textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+void Graphics::updateTextureResidency() {
+    this->finishTextureStreaming();
+    this->submitTextureStreaming();
+    
+    if (this->textureBudget == 0 || this->renderedFrames % TEXTURE_RESIDENCY_INTERVAL != 0) return;
+    
+    const uint64_t now = this->getTextureClock();
+    
+    VkDeviceSize residentSize = 0;
+    VkDeviceSize requiredSize = 0;
+    std::vector<std::tuple<uint64_t, std::string, Texture *>> candidates;
+    
+    for (auto & texture : this->models.getTextures()) {
+        residentSize += this->getAnticipatedTextureSize(texture.first, texture.second.get());
+        
+        const int id = texture.second->getId();
+        if (!texture.second->isStreamable() || id < 0 || id >= MAX_TEXTURES || 
+            this->findTextureStreamRequest(texture.first) != nullptr) continue;
+        
+        const uint64_t lastUsed = this->textureLastUsed[id].load(std::memory_order_relaxed);
+        candidates.push_back(std::make_tuple(lastUsed, texture.first, texture.second.get()));
+        
+        if (now - lastUsed < TEXTURE_COLD_TIME && texture.second->getImageMipLevel() > 0) {
+            requiredSize += texture.second->getMipChainSize(0) - std::min(texture.second->getMipChainSize(0), texture.second->getResidentSize());
+        }
+    }
+    
+    // coldest first for demotion, the most recently used are streamed back first
+    std::sort(candidates.begin(), candidates.end());
+    
+    VkDeviceSize streamedSize = 0;
+    
+    for (auto & candidate : candidates) {
+        if (residentSize + std::min(requiredSize, TEXTURE_STREAMING_SIZE) <= this->textureBudget) break;
+        
+        Texture * texture = std::get<2>(candidate);
+        if (now - std::get<0>(candidate) < TEXTURE_COLD_TIME) break;
+        
+        // cold textures first lose their top levels, then shrink to a placeholder that is always kept
+        const uint32_t placeholderLevel = texture->getMipLevelForSize(TEXTURE_PLACEHOLDER_SIZE);
+        if (texture->getImageMipLevel() >= placeholderLevel) continue;
+        
+        const uint32_t residentMipLevel = texture->getResidentMipLevel() == 0 ? 
+            std::min(TEXTURE_DEMOTE_LEVELS, placeholderLevel) : placeholderLevel;
+        
+        if (!this->streamTexture(std::get<1>(candidate), texture, residentMipLevel, residentMipLevel)) continue;
+        
+        residentSize -= std::min(residentSize, texture->getResidentSize());
+        residentSize += this->getAnticipatedTextureSize(std::get<1>(candidate), texture);
+        streamedSize += texture->getMipChainSize(residentMipLevel);
+    }
+    
+    for (auto it = candidates.rbegin(); it != candidates.rend(); it++) {
+        Texture * texture = std::get<2>(*it);
+        if (now - std::get<0>(*it) >= TEXTURE_COLD_TIME) break;
+        if (texture->getResidentMipLevel() == 0 || this->findTextureStreamRequest(std::get<1>(*it)) != nullptr) continue;
+        
+        // one level per update, the first moves into a full chain image that later levels are written into in place
+        const uint32_t residentMipLevel = texture->getResidentMipLevel() - 1;
+        const bool refinesImage = texture->getImageMipLevel() == 0;
+        const VkDeviceSize uploadSize = texture->getMipChainSize(residentMipLevel) - 
+            (refinesImage ? texture->getMipChainSize(texture->getResidentMipLevel()) : 0);
+        
+        if ((!refinesImage && 
+                residentSize - std::min(residentSize, texture->getResidentSize()) + texture->getMipChainSize(0) > this->textureBudget) || 
+            (streamedSize > 0 && streamedSize + uploadSize > TEXTURE_STREAMING_SIZE)) continue;
+        
+        if (!this->streamTexture(std::get<1>(*it), texture, 0, residentMipLevel)) continue;
+        
+        residentSize -= std::min(residentSize, texture->getResidentSize());
+        residentSize += this->getAnticipatedTextureSize(std::get<1>(*it), texture);
+        streamedSize += uploadSize;
+    }
+    
+}
 
-        vkDestroyBuffer(this->device, stagingBuffer, nullptr);
-        vkFreeMemory(this->device, stagingBufferMemory, nullptr);
+bool Graphics::addModelAtRuntime(Model * model) {
+    std::unique_ptr<Model> modelPtr(model);
+    if (model == nullptr || !model->hasBeenLoaded()) return false;
+    
+    if (this->vertexBuffer == nullptr) {
+        std::cerr << "Models have to be prepared before adding more at runtime" << std::endl;
+        return false;
+    }
+    
+    if (this->models.findModel(model->getId()) != nullptr) {
+        std::cerr << "Model " << model->getId() << " exists already" << std::endl;
+        return false;
+    }
+    
+    // textures are decoded and uploaded while frames keep rendering, their slots are not referenced by anything yet
+    std::vector<Texture *> newTextures = this->models.processTextures(model);
+    for (Texture * texture : newTextures) {
+        if (texture->getId() < MAX_TEXTURES && this->uploadTexture(texture)) continue;
         
-        if (textureImage != nullptr) texture.second->setTextureImage(textureImage);
-        if (textureImageMemory != nullptr) texture.second->setTextureImageMemory(textureImageMemory);
+        std::cerr << "Failed to add Textures of Model " << model->getId() << std::endl;
+        this->flushUploadRing();
+        this->releaseUploadRegions(true);
+        for (auto & unusedTexture : this->models.releaseUnusedTextures()) unusedTexture->cleanUpTexture(this->device, this->memoryAllocator);
+        return false;
+    }
+    
+    if (!newTextures.empty()) this->flushUploadRing();
+    
+    // the compaction copies ranges by their old offsets, it has to land before new ranges are handed out
+    this->finishGeometryCompaction(true);
+    
+    bool succeeded = true;
+    
+    // growing a buffer swaps it, so the worker must not record in between
+    this->workerQueue.runExclusively([this, model, &succeeded]() {
+        VkBuffer ssboBuffer = this->ssboBuffer;
+        succeeded = this->allocateModelGeometry(model);
+        if (this->ssboBuffer != ssboBuffer && !this->replaceDescriptorSets()) succeeded = false;
+    });
+    
+    // the new ranges aren't referenced by any recorded frame
+    if (!succeeded || 
+        !this->uploadModelsContent(VERTEX, { model }) || 
+        !this->uploadModelsContent(INDEX, { model }) || 
+        !this->uploadModelsContent(SSBO, { model })) {
+        std::cerr << "Failed to upload Model " << model->getId() << std::endl;
+        this->flushUploadRing();
+        this->releaseUploadRegions(true);
+        this->freeModelGeometry(model);
+        for (auto & unusedTexture : this->models.releaseUnusedTextures()) unusedTexture->cleanUpTexture(this->device, this->memoryAllocator);
+        return false;
+    }
+    
+    this->releaseModelGeometry({ model });
+    
+    this->workerQueue.runExclusively([this, &modelPtr, &newTextures, &succeeded]() {
+        this->models.addModel(modelPtr.release());
         
+        if (!newTextures.empty()) succeeded = this->replaceDescriptorSets();
+    });
+    
+    return succeeded;
+}
+
+bool Graphics::removeModelAtRuntime(std::string id) {
+    std::unique_ptr<Model> model = nullptr;
+    std::vector<std::unique_ptr<Texture>> unusedTextures;
+    bool succeeded = true;
+    
+    this->workerQueue.runExclusively([this, &model, &unusedTextures, &succeeded, &id]() {
+        model = this->models.removeModel(id);
+        if (model == nullptr) return;
         
-        VkImageView textureImageView = this->createImageView(textureImage, texture.second->getImageFormat(), VK_IMAGE_ASPECT_COLOR_BIT);
-        if (textureImageView != nullptr) texture.second->setTextureImageView(textureImageView);
+        this->components.removeComponentsForModel(id);
         
-        texture.second->freeSurface();
+        unusedTextures = this->models.releaseUnusedTextures();
+        if (!unusedTextures.empty()) succeeded = this->replaceDescriptorSets();
+    });
+    
+    if (model == nullptr) return false;
+    
+    std::vector<std::tuple<ModelsContentType, uint32_t>> geometry;
+    for (Mesh & mesh : model->getMeshes()) {
+        for (ModelsContentType contentType : { VERTEX, INDEX, SSBO }) {
+            geometry.push_back(std::make_tuple(contentType, mesh.getGeometryHandle(contentType)));
+        }
     }
     
-    std::cout << "Number of Textures: " << textures.size() << std::endl;
+    // the ranges go back to the arenas once no frame in flight draws from them
+    this->retireResource([this, geometry]() {
+        for (auto & range : geometry) this->geometryArenas[std::get<0>(range)].free(std::get<1>(range));
+    });
+    
+    // the old descriptor sets still reference these images, without replacements they have to stay
+    if (!succeeded) return false;
+    
+    for (auto & unusedTexture : unusedTextures) {
+        std::shared_ptr<Texture> texture(std::move(unusedTexture));
+        this->retireResource([this, texture]() {
+            texture->cleanUpTexture(this->device, this->memoryAllocator);
+        });
+    }
+    
+    return true;
+}
+
+bool Graphics::replaceDescriptorSets() {
+    std::vector<VkDescriptorSet> sets;
+    const VkDescriptorPool oldPool = this->descriptorPool;
+    
+    if (!this->allocateDescriptorSets(sets)) {
+        // pool is full of retired generations frames in flight still use, continue in a new one
+        if (!this->createDescriptorPool() || !this->allocateDescriptorSets(sets)) {
+            if (this->descriptorPool != nullptr && this->descriptorPool != oldPool) {
+                vkDestroyDescriptorPool(this->device, this->descriptorPool, nullptr);
+                this->descriptorPoolGenerations.erase(this->descriptorPool);
+            }
+            this->descriptorPool = oldPool;
+            return false;
+        }
+    }
+    
+    std::vector<VkDescriptorSet> oldSets = this->descriptorSets;
+    this->descriptorSets = sets;
+    
+    this->retireResource([this, oldPool, oldSets]() {
+        vkFreeDescriptorSets(this->device, oldPool, static_cast<uint32_t>(oldSets.size()), oldSets.data());
+        
+        auto generations = this->descriptorPoolGenerations.find(oldPool);
+        if (generations == this->descriptorPoolGenerations.end() || --generations->second > 0 || oldPool == this->descriptorPool) return;
+        
+        vkDestroyDescriptorPool(this->device, oldPool, nullptr);
+        this->descriptorPoolGenerations.erase(generations);
+    });
+    
+    return true;
 }
 
 bool Graphics::updateSwapChain() {
@@ -594,6 +1795,7 @@ bool Graphics::updateSwapChain() {
     
     if (!this->createGraphicsPipeline()) return false;
     if (!this->createDepthResources()) return false;
+    if (this->cullingPipeline != nullptr && !this->createDepthPyramid()) return false;
     if (!this->createFramebuffers()) return false;
 
     Camera::instance()->setAspectRatio(static_cast<float>(this->swapChainExtent.width) / this->swapChainExtent.height);
@@ -610,6 +1812,52 @@ Models & Graphics::getModels() {
     return this->models;
 }
 
+void Graphics::setTextureBudget(VkDeviceSize budget) {
+    this->textureBudget = budget;
+}
+
+VkDeviceSize Graphics::getTextureBudget() {
+    return this->textureBudget;
+}
+
+MemoryStatistics Graphics::getMemoryStatistics(MemoryCategory category) {
+    return this->memoryAllocator.getStatistics(category);
+}
+
+std::vector<MemoryHeapBudget> Graphics::getMemoryHeapBudgets() {
+    return this->memoryAllocator.getHeapBudgets();
+}
+
+void Graphics::setMemoryBudget(MemoryCategory category, VkDeviceSize budget) {
+    this->memoryAllocator.setBudget(category, budget);
+}
+
+void Graphics::printMemoryStatistics() {
+    this->memoryAllocator.printStatistics();
+    this->printGeometryRetention();
+}
+
+void Graphics::printGeometryRetention() {
+    std::array<uint32_t, GEOMETRY_RETENTION_COUNT> modelCounts {};
+    std::array<VkDeviceSize, GEOMETRY_RETENTION_COUNT> geometrySizes {};
+    for (auto & model : this->models.getModels()) {
+        modelCounts[model->getGeometryRetention()]++;
+        geometrySizes[model->getGeometryRetention()] += model->getGeometrySize();
+    }
+    
+    for (size_t i=0; i<GEOMETRY_RETENTION_COUNT; i++) {
+        if (modelCounts[i] == 0) continue;
+        std::cout << "CPU Geometry retaining " << Model::GEOMETRY_RETENTION_NAMES[i] << ": " << geometrySizes[i] / MEGA_BYTE << " MB in " << 
+            modelCounts[i] << " models" << std::endl;
+    }
+    
+    size_t residentSize = 0;
+    size_t peakResidentSize = 0;
+    if (Utils::getResidentSetSize(residentSize, peakResidentSize)) {
+        std::cout << "Resident Set Size: " << residentSize / MEGA_BYTE << " MB, peak " << peakResidentSize / MEGA_BYTE << " MB" << std::endl;
+    }
+}
+
 Components & Graphics::getComponents() {
     return this->components;
 }
@@ -634,11 +1882,22 @@ void Graphics::startCommandBufferQueue() {
     if (!this->isActive() || this->workerQueue.isRunning()) return;
     
     this->workerQueue.startQueue(
-        std::bind(&Graphics::createCommandBuffer, this, std::placeholders::_1),
-        std::bind(&Graphics::destroyCommandBuffer , this, std::placeholders::_1), 
+        std::bind(&Graphics::createCommandBuffer, this, std::placeholders::_1, std::placeholders::_2),
+        std::bind(&Graphics::hasSceneChanged, this), 
         this->swapChainFramebuffers.size());
 }
 
+bool Graphics::hasSceneChanged() {
+    // components flag their own changes, the camera counts its updates
+    const bool componentsChanged = this->components.isSceneUpdateNeeded();
+    
+    const uint64_t cameraVersion = Camera::instance()->getVersion();
+    const bool cameraChanged = cameraVersion != this->recordedCameraVersion;
+    this->recordedCameraVersion = cameraVersion;
+    
+    return componentsChanged || cameraChanged;
+}
+
 void Graphics::stopCommandBufferQueue() {
     this->workerQueue.stopQueue();
 }
@@ -646,7 +1905,15 @@ void Graphics::stopCommandBufferQueue() {
 std::filesystem::path Graphics::getAppPath(APP_PATHS appPath) {
     switch(appPath) {
         case SHADERS:
+        {
+#ifdef SHADERS_DIR
+            // spir-v is compiled by the build, not shipped. fall back to the app dir once the build tree is gone
+            const std::filesystem::path buildShaders(SHADERS_DIR);
+            std::error_code error;
+            if (std::filesystem::is_directory(buildShaders, error)) return buildShaders;
+#endif
             return this->dir / "res/shaders";
+        }
         case MODELS:
             return this->dir / "res/models";
         case FONTS:
@@ -666,6 +1933,7 @@ Graphics::~Graphics() {
     this->cleanupVulkan();
 
     TTF_Quit();
+    IMG_Quit();
     
     SDL_Quit();
 }
@@ -48,6 +48,9 @@ class Camera
         
         glm::mat4 perspective = glm::mat4();
         glm::mat4 view = glm::mat4();
+        
+        // counts view and projection changes, the renderer records anew when it moves on
+        std::atomic<uint64_t> version {0};
 
         void updateViewMatrix();
         bool moving();
@@ -66,6 +69,7 @@ class Camera
         void update(float deltaTime, float terrainHeight = 0.0f);
         glm::mat4 getViewMatrix();
         glm::mat4 getProjectionMatrix();
+        uint64_t getVersion();
         static Camera * instance(glm::vec3 pos);
         static Camera * instance();
         void setType(CameraType type);
@@ -15,7 +15,11 @@ class Component final {
         
         bool visible = true;
         bool sceneUpdate = false;
+        uint32_t lod = 0;
     public:
+        static const std::array<float, 3> LOD_SCREEN_SIZES;
+        static const float LOD_HYSTERESIS;
+        
         Component(std::string id);
         Component(std::string id, Model * model);
         MeshProperties & getModelProperties();
@@ -37,6 +41,8 @@ class Component final {
         std::string getId();
         BoundingBox getTransformedBoundingBox();
         glm::vec3 getComponentBBoxCenter();
+        uint32_t getLod();
+        void updateLod(const float screenSize);
 };
 
 class Components final {
@@ -47,6 +53,7 @@ class Components final {
     public:
         Component * addComponent(Component * component);
         std::vector<Component *> getAllComponentsForModel(std::string model);
+        void removeComponentsForModel(std::string model);
         void initWithModelIds(std::vector< std::string > modelIds);
         std::map<std::string, std::vector<std::unique_ptr<Component>>> & getComponents();
         ~Components();
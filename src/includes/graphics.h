@@ -5,11 +5,143 @@
 
 static constexpr int MAX_TEXTURES = 50;
 static constexpr int MAX_FRAMES_IN_FLIGHT = 3;
+static constexpr int DESCRIPTOR_SET_GENERATIONS = 3;
+static constexpr VkDeviceSize UPLOAD_RING_SIZE = 64 * MEGA_BYTE;
+static constexpr VkDeviceSize UPLOAD_RING_CHUNK_SIZE = UPLOAD_RING_SIZE / 4;
+static constexpr VkDeviceSize UPLOAD_RING_ALIGNMENT = 16;
+static constexpr VkDeviceSize TEXEL_SIZE = 4;
+static constexpr VkDeviceSize FRAME_DATA_SIZE = MEGA_BYTE / 4;
+static constexpr float GEOMETRY_COMPACTION_THRESHOLD = 0.5f;
+static constexpr float GEOMETRY_COMPACTION_MIN_FREE = 0.25f;
+static constexpr VkDeviceSize TEXTURE_BUDGET = 256 * MEGA_BYTE;
+static constexpr uint64_t TEXTURE_COLD_TIME = 5000;
+static constexpr uint32_t TEXTURE_DEMOTE_LEVELS = 2;
+static constexpr uint32_t TEXTURE_PLACEHOLDER_SIZE = 16;
+static constexpr VkDeviceSize TEXTURE_STREAMING_SIZE = UPLOAD_RING_CHUNK_SIZE;
+static constexpr uint32_t TEXTURE_INITIAL_SIZE = 64;
+static constexpr uint64_t TEXTURE_RESIDENCY_INTERVAL = 10;
+static constexpr uint32_t CULLING_GROUP_SIZE = 64;
+static constexpr uint32_t DEPTH_PYRAMID_GROUP_SIZE = 8;
+static constexpr uint32_t DEPTH_PYRAMID_MAX_LEVELS = 16;
+static constexpr uint32_t MIN_DRAW_COMMANDS_PER_SLICE = 64;
 
 enum APP_PATHS {
     ROOT, SHADERS, MODELS, FONTS, MAPS
 };
 
+struct UploadBatch final {
+    public:
+        VkFence fence = nullptr;
+        VkSemaphore semaphore = nullptr;
+        VkCommandBuffer transferCommandBuffer = nullptr;
+        VkCommandBuffer graphicsCommandBuffer = nullptr;
+        VkDeviceSize ringSize = 0;
+};
+
+struct GeometryCompaction final {
+    public:
+        ModelsContentType modelsContentType = VERTEX;
+        VkBuffer buffer = nullptr;
+        MemoryAllocation bufferMemory;
+        std::vector<GeometryMove> moves;
+        uint64_t uploadBatch = 0;
+};
+
+struct TextureStreamRequest final {
+    public:
+        std::string location;
+        uint32_t imageMipLevel = 0;
+        uint32_t residentMipLevel = 0;
+        bool ownsImage = true;
+        VkImage image = nullptr;
+        MemoryAllocation imageMemory;
+        VkImageView imageView = nullptr;
+        uint64_t uploadBatch = 0;
+        // the streaming thread reads the levels into the staging buffer, they are copied once its job is done
+        uint32_t levelCount = 0;
+        VkBuffer stagingBuffer = nullptr;
+        MemoryAllocation stagingBufferMemory;
+        uint64_t loadJob = 0;
+        std::shared_ptr<std::vector<VkBufferImageCopy>> loadedRegions = nullptr;
+};
+
+// what a frame is recorded into, its pools are reset as a whole before it is recorded again.
+// every slice of the render pass has a pool of its own since slices are recorded on different threads
+struct FrameCommands final {
+    public:
+        VkCommandPool commandPool = nullptr;
+        VkCommandBuffer commandBuffer = nullptr;
+        std::vector<VkCommandPool> secondaryCommandPools;
+        std::vector<VkCommandBuffer> secondaryCommandBuffers;
+};
+
+// gathered while recording, copied into the frame data once the command buffer is submitted
+struct InstanceData final {
+    public:
+        std::vector<ModelProperties> transforms;
+        std::vector<InstanceProperties> instances;
+        // indirect draws of 16 bit index meshes first, then the 32 bit ones, counted per index type
+        std::vector<VkDrawIndexedIndirectCommand> drawCommands;
+        std::array<uint32_t, 2> drawCounts {};
+        bool indirect = false;
+        // marked as used whenever the recording is submitted, it may be submitted for many frames
+        std::vector<int> textures;
+        // only filled in for the culling pass, which writes the visible instances into the culled range
+        std::vector<InstanceBounds> bounds;
+        std::vector<uint32_t> drawIndices;
+        bool culled = false;
+        VkDeviceSize instancesOffset = 0;
+        VkDeviceSize drawCommandsOffset = 0;
+        VkDeviceSize drawCountsOffset = 0;
+        VkDeviceSize boundsOffset = 0;
+        VkDeviceSize drawIndicesOffset = 0;
+        VkDeviceSize culledInstancesOffset = 0;
+        VkDeviceSize size = 0;
+};
+
+// what one model adds to a recording, gathered on a worker and merged into the instance data afterwards
+struct ModelDraws final {
+    public:
+        std::vector<ModelProperties> transforms;
+        std::vector<InstanceBounds> bounds;
+        std::vector<InstanceProperties> instances;
+        std::array<std::vector<VkDrawIndexedIndirectCommand>, 2> drawCommands;
+        std::vector<int> textures;
+};
+
+struct CullingConstants final {
+    public:
+        uint32_t instanceCount = 0;
+        uint32_t boundsOffset = 0;
+        uint32_t instancesOffset = 0;
+        uint32_t drawIndicesOffset = 0;
+        uint32_t culledInstancesOffset = 0;
+        uint32_t drawCommandsOffset = 0;
+        uint32_t depthPyramidLevels = 0;
+        uint32_t padding = 0;
+        glm::vec2 viewportSize = glm::vec2(0.0f);
+};
+
+struct DepthPyramidConstants final {
+    public:
+        glm::ivec2 sourceSize = glm::ivec2(0);
+        glm::ivec2 destinationSize = glm::ivec2(0);
+};
+
+// attachments that don't outlive a frame, the ones whose passes don't overlap share memory
+struct TransientAttachment final {
+    public:
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkImageUsageFlags usage = 0;
+        VkImageAspectFlags aspectFlags = 0;
+        uint32_t firstPass = 0;
+        uint32_t lastPass = 0;
+        VkImage image = nullptr;
+        VkImageView imageView = nullptr;
+        VkMemoryRequirements memoryRequirements {};
+        VkDeviceSize offset = 0;
+};
+
 class Graphics {
     private:
         SDL_Window * sdlWindow = nullptr;
@@ -28,13 +160,22 @@ class Graphics {
         bool showWireFrame = false;
         bool requiresUpdateSwapChain = false;
         bool useFrustumCulling = false;
+        bool useOcclusionCulling = false;
         
         uint16_t frameCount = 0;
+        uint64_t renderedFrames = 0;
         double deltaTime = 1;
         std::chrono::high_resolution_clock::time_point lastTimeMeasure = std::chrono::high_resolution_clock::now();
         
         VkPhysicalDevice physicalDevice = nullptr;
         VkDevice device = nullptr;
+        MemoryAllocator memoryAllocator;
+        bool hasPhysicalDeviceProperties2 = false;
+        bool supportsMemoryBudget = false;
+        bool supportsMultiDrawIndirect = false;
+        bool supportsDrawIndirectFirstInstance = false;
+        uint32_t maxDrawIndirectCount = 1;
+        PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
 
         bool hasSkybox = false;
         bool hasTerrain = false;
@@ -45,6 +186,9 @@ class Graphics {
         VkQueue graphicsQueue = nullptr;
         uint32_t presentQueueIndex = -1;
         VkQueue presentQueue = nullptr;
+        uint32_t transferQueueIndex = -1;
+        VkQueue transferQueue = nullptr;
+        VkExtent3D transferImageGranularity = { 1, 1, 1 };
         
         CommandBufferQueue workerQueue;
 
@@ -58,12 +202,19 @@ class Graphics {
 
         std::vector<VkImageView> swapChainImageViews;
 
-        VkCommandPool commandPool = nullptr;
+        VkCommandPool uploadCommandPool = nullptr;
+        VkCommandPool uploadGraphicsCommandPool = nullptr;
         VkDescriptorPool descriptorPool = nullptr;
+        // generations of sets allocated per pool, a full pool is replaced and destroyed once its last generation is freed
+        std::map<VkDescriptorPool, uint32_t> descriptorPoolGenerations;
         VkDescriptorPool skyboxDescriptorPool = nullptr;
         VkDescriptorPool terrainDescriptorPool = nullptr;
 
         std::vector<VkCommandBuffer> commandBuffers;
+        // per swap chain image and slot of the worker queue, recordings are reused until something changes
+        std::vector<FrameCommands> frameCommands;
+        std::unique_ptr<WorkerPool> recordingWorkers = nullptr;
+        uint64_t recordedCameraVersion = 0;
         VkPipelineLayout graphicsPipelineLayout = nullptr;
 
         std::vector<VkDescriptorSet> descriptorSets;
@@ -96,20 +247,20 @@ class Graphics {
         size_t currentFrame = 0;
 
         VkBuffer vertexBuffer = nullptr;
-        VkDeviceMemory vertexBufferMemory = nullptr;
+        MemoryAllocation vertexBufferMemory;
         
         VkBuffer skyBoxVertexBuffer = nullptr;
-        VkDeviceMemory skyBoxVertexBufferMemory = nullptr;        
+        MemoryAllocation skyBoxVertexBufferMemory;        
 
         VkBuffer terrainVertexBuffer = nullptr;
         VkBuffer terrainIndexBuffer = nullptr;
-        VkDeviceMemory terrainVertexBufferMemory = nullptr;
-        VkDeviceMemory terrainIndexBufferMemory = nullptr;        
+        MemoryAllocation terrainVertexBufferMemory;
+        MemoryAllocation terrainIndexBufferMemory;        
         VkShaderModule terrainVertShaderModule = nullptr;
         VkShaderModule terrainFragShaderModule = nullptr;
         
         VkImage skyboxCubeImage = nullptr;
-        VkDeviceMemory skyboxCubeImageMemory = nullptr;
+        MemoryAllocation skyboxCubeImageMemory;
         VkImageView skyboxImageView = nullptr;
         VkShaderModule skyboxVertShaderModule = nullptr;
         VkShaderModule skyboxFragShaderModule = nullptr;
@@ -117,17 +268,76 @@ class Graphics {
         VkShaderModule fragShaderModule = nullptr;
 
         VkBuffer indexBuffer = nullptr;
-        VkDeviceMemory indexBufferMemory = nullptr;
+        MemoryAllocation indexBufferMemory;
 
         VkBuffer ssboBuffer = nullptr;
-        VkDeviceMemory ssboBufferMemory = nullptr;
-
-        std::vector<VkBuffer> uniformBuffers;
-        std::vector<VkDeviceMemory> uniformBuffersMemory;
+        MemoryAllocation ssboBufferMemory;
+        
+        VkBuffer uploadRingBuffer = nullptr;
+        MemoryAllocation uploadRingBufferMemory;
+        void * uploadRingData = nullptr;
+        VkDeviceSize uploadRingHead = 0;
+        VkDeviceSize uploadRingTail = 0;
+        VkDeviceSize uploadRingUsed = 0;
+        VkDeviceSize uploadRingPending = 0;
+        VkCommandBuffer uploadTransferCommandBuffer = nullptr;
+        VkCommandBuffer uploadGraphicsCommandBuffer = nullptr;
+        VkBuffer uploadRingCopyBuffer = nullptr;
+        VkBufferCopy uploadRingCopy {};
+        std::vector<VkBufferMemoryBarrier> uploadBufferBarriers;
+        std::deque<UploadBatch> uploadBatches;
+        uint64_t submittedUploadBatches = 0;
+        uint64_t completedUploadBatches = 0;
+        
+        // ranges of the vertex, index and ssbo buffer, indexed by ModelsContentType
+        std::array<GeometryArena, 3> geometryArenas;
+        std::unique_ptr<GeometryCompaction> geometryCompaction = nullptr;
+        
+        // milliseconds of the last recorded draw per texture id, written by the command buffer worker
+        std::array<std::atomic<uint64_t>, MAX_TEXTURES> textureLastUsed {};
+        std::vector<TextureStreamRequest> textureStreamRequests;
+        JobQueue textureStreamQueue;
+        VkDeviceSize textureBudget = TEXTURE_BUDGET;
         
-        std::vector<VkImage> depthImages;
-        std::vector<VkDeviceMemory> depthImagesMemory;
-        std::vector<VkImageView> depthImagesView;
+        std::vector<std::tuple<uint64_t, std::function<void()>>> retiredResources;
+
+        // per frame data lives in one mapped buffer, each swap chain image owns a slice bound through dynamic offsets
+        VkBuffer frameDataBuffer = nullptr;
+        MemoryAllocation frameDataBufferMemory;
+        VkDeviceSize frameDataStride = 0;
+        VkDeviceSize frameDataAlignment = 1;
+        std::vector<VkDeviceSize> frameDataUsage;
+        std::unordered_map<VkCommandBuffer, InstanceData> recordedInstanceData;
+        std::mutex instanceDataLock;
+        std::atomic<VkDeviceSize> requiredFrameDataStride {0};
+        std::atomic<uint32_t> drawCalls {0};
+        std::atomic<uint32_t> instancesDrawn {0};
+        std::atomic<uint32_t> indirectDraws {0};
+        
+        // frames are serialized on the graphics queue, all framebuffers share one depth attachment
+        std::vector<TransientAttachment> transientAttachments;
+        MemoryAllocation transientAttachmentMemory;
+        uint32_t depthAttachment = 0;
+        
+        // visibility is decided by a compute pass ahead of the model pass, occlusion against last frame's depth
+        VkDescriptorPool cullingDescriptorPool = nullptr;
+        VkDescriptorSetLayout cullingDescriptorSetLayout = nullptr;
+        VkDescriptorSet cullingDescriptorSet = nullptr;
+        VkShaderModule cullingShaderModule = nullptr;
+        VkPipelineLayout cullingPipelineLayout = nullptr;
+        VkPipeline cullingPipeline = nullptr;
+        
+        VkDescriptorSetLayout depthPyramidDescriptorSetLayout = nullptr;
+        std::vector<VkDescriptorSet> depthPyramidDescriptorSets;
+        VkShaderModule depthPyramidShaderModule = nullptr;
+        VkPipelineLayout depthPyramidPipelineLayout = nullptr;
+        VkPipeline depthPyramidPipeline = nullptr;
+        VkImage depthPyramidImage = nullptr;
+        MemoryAllocation depthPyramidImageMemory;
+        VkImageView depthPyramidImageView = nullptr;
+        std::vector<VkImageView> depthPyramidLevelViews;
+        std::vector<VkExtent2D> depthPyramidLevelExtents;
+        VkSampler depthPyramidSampler = nullptr;
         
         VkSampler textureSampler = nullptr;
         VkSampler skyboxSampler = nullptr;
@@ -184,20 +394,34 @@ class Graphics {
         bool createSkyboxDescriptorSetLayout();
         bool createTerrainDescriptorSetLayout();
         bool createDescriptorSets();
+        bool allocateDescriptorSets(std::vector<VkDescriptorSet> & sets);
+        bool replaceDescriptorSets();
         bool createSkyboxDescriptorSets();
         bool createTerrainDescriptorSets();
         
         bool createUniformBuffers();
+        bool createFrameDataBuffer(VkDeviceSize stride);
         void updateUniformBuffer(uint32_t currentImage);
+        void * allocateFrameData(uint32_t frameIndex, VkDeviceSize size, VkDeviceSize & offset);
+        VkDeviceSize alignFrameData(VkDeviceSize offset);
+        VkDeviceSize getInstanceDataSize(VkDeviceSize numberOfTransforms, VkDeviceSize numberOfInstances);
+        VkDeviceSize getSceneFrameDataSize();
+        void updateFrameDataSize();
+        void updateInstanceData(uint32_t currentImage, VkCommandBuffer commandBuffer);
         void updateSsboBuffer();
 
         void listVkPhysicalDeviceQueueFamilyProperties(const VkPhysicalDevice & device);
 
         bool createCommandPool();
+        bool createUploadRing();
         bool createFramebuffers();
         bool createCommandBuffers();
-        void destroyCommandBuffer(VkCommandBuffer commandBuffer);
-        VkCommandBuffer createCommandBuffer(uint16_t commandBufferIndex);
+        bool createFrameCommands(FrameCommands & frameCommands);
+        void destroyFrameCommands();
+        VkCommandBuffer createCommandBuffer(uint16_t commandBufferIndex, uint16_t slot);
+        bool beginSecondaryCommandBuffer(VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex);
+        bool hasSceneChanged();
+        void recordBackground(VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex);
         bool createRenderPass();
 
         bool createSyncObjects();
@@ -205,28 +429,100 @@ class Graphics {
         void cleanupSwapChain();
         void cleanupVulkan();
 
-        bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+        bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, MemoryAllocation & bufferMemory);
         bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, uint32_t & memoryType);
-        void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
 
         bool createBuffersFromModel();
-        bool createSsboBufferFromModel(VkDeviceSize bufferSize, bool makeHostWritable = false);
+        bool createModelBuffers(const BufferSummary & capacity);
+        bool createModelBuffer(ModelsContentType modelsContentType, VkDeviceSize capacity, VkBuffer & buffer, MemoryAllocation & bufferMemory);
+        VkBuffer & getModelBuffer(ModelsContentType modelsContentType);
+        MemoryAllocation & getModelBufferMemory(ModelsContentType modelsContentType);
+        void replaceModelBuffer(ModelsContentType modelsContentType, VkBuffer buffer, MemoryAllocation & bufferMemory);
+        bool allocateModelGeometry(Model * model);
+        void freeModelGeometry(Model * model);
+        void releaseModelGeometry(const std::vector<Model *> & models);
+        bool growModelBuffer(ModelsContentType modelsContentType, VkDeviceSize requiredSize);
+        bool recordModelBufferCopies(VkBuffer srcBuffer, VkBuffer dstBuffer, const std::vector<VkBufferCopy> & regions);
+        void updateGeometryCompaction();
+        bool startGeometryCompaction(ModelsContentType modelsContentType);
+        void finishGeometryCompaction(bool wait = false);
+        bool uploadModelsContent(ModelsContentType modelsContentType, const std::vector<Model *> & models);
+        void retireResource(std::function<void()> release);
+        void releaseRetiredResources(bool force = false);
         
-        VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t layerCount = 1);
+        VkImageView createImageView(
+            VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseMipLevel = 0);
         bool createDepthResources();
+        uint32_t addTransientAttachment(
+            VkFormat format, VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, uint32_t firstPass = 0, uint32_t lastPass = 0);
+        bool createTransientAttachments();
+        void destroyTransientAttachments();
         bool findDepthFormat(VkFormat & supportedFormat);
         bool findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features, VkFormat & supportedFormat);
         bool createImage(
-                int32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory, uint16_t arrayLayers = 1);
+                int32_t width, uint32_t height, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation & imageMemory, uint16_t arrayLayers = 1, uint32_t mipLevels = 1);
         
-        VkCommandBuffer beginSingleTimeCommands();
-        void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-        bool transitionImageLayout(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint16_t layerCount = 1);
+        VkCommandBuffer beginSingleTimeCommands(VkCommandPool commandPool);
+        bool transitionImageLayout(
+            VkCommandBuffer commandBuffer, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, 
+            uint16_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseMipLevel = 0);
+        bool supportsMipMapGeneration(VkFormat format);
+        bool generateMipMaps(VkCommandBuffer commandBuffer, VkImage image, int32_t width, int32_t height, uint32_t mipLevels);
         void prepareModelTextures();
-        void copyBufferToImage(VkBuffer & buffer, VkImage & image, uint32_t width, uint32_t height, uint16_t layerCount = 1);
+        bool uploadTexture(Texture * texture);
+        bool uploadTextureImage(Texture * texture, VkImage & textureImage, MemoryAllocation & textureImageMemory, VkImageView & textureImageView);
+        void retireTextureImage(VkImage textureImage, MemoryAllocation & textureImageMemory, VkImageView textureImageView);
+        uint64_t getTextureClock();
+        void collectTextures(const Mesh & mesh, std::vector<int> & textures);
+        void markTexturesUsed(const std::vector<int> & textures, uint64_t now);
+        VkDeviceSize getAnticipatedTextureSize(const std::string & location, Texture * texture);
+        TextureStreamRequest * findTextureStreamRequest(const std::string & location);
+        bool uploadTextureMipLevels(Texture * texture, VkImage textureImage, uint32_t baseMipLevel, uint32_t levelCount);
+        bool createStreamedTextureImage(Texture * texture, uint32_t imageMipLevel, uint32_t residentMipLevel, TextureStreamRequest & request);
+        bool uploadStreamedTexture(Texture * texture, uint32_t imageMipLevel, uint32_t residentMipLevel, TextureStreamRequest & request);
+        bool uploadStagedTexture(Texture * texture, TextureStreamRequest & request);
+        void retireTextureStaging(TextureStreamRequest & request);
+        bool streamTexture(const std::string & location, Texture * texture, uint32_t imageMipLevel, uint32_t residentMipLevel);
+        void submitTextureStreaming();
+        void finishTextureStreaming();
+        void updateTextureResidency();
+        VkBufferImageCopy getImageCopyRegion(uint32_t width, uint32_t height, uint32_t mipLevel = 0, uint32_t layer = 0);
+        bool hasDedicatedTransferQueue();
+        VkCommandBuffer getUploadCommandBuffer();
+        VkCommandBuffer getUploadGraphicsCommandBuffer();
+        bool releaseImageToGraphicsQueue(
+            VkImage image, VkImageLayout newLayout, uint16_t layerCount = 1, uint32_t mipLevels = 1, uint32_t baseMipLevel = 0);
+        bool reserveUploadRing(VkDeviceSize size, VkDeviceSize & offset);
+        void recordUploadCopy(VkBuffer dstBuffer, VkDeviceSize ringOffset, VkDeviceSize dstOffset, VkDeviceSize size);
+        void recordPendingUploadCopy();
+        bool uploadToBuffer(VkBuffer buffer, VkDeviceSize dstOffset, const void * data, VkDeviceSize size);
+        bool uploadToImage(VkImage image, const void * pixels, const std::vector<VkBufferImageCopy> & regions);
+        bool flushUploadRing();
+        void releaseUploadRegions(bool wait = false);
         bool createTextureSampler(VkSampler & sampler, VkSamplerAddressMode addressMode);
-        void copyModelsContentIntoBuffer(void* data, ModelsContentType modelsContentType, VkDeviceSize maxSize);
-        void draw(VkCommandBuffer & commandBuffer, bool useIndices);
+        void copyMeshContentIntoBuffer(Mesh & mesh, void* data, ModelsContentType modelsContentType);
+        VkDeviceSize getMeshContentSize(const Mesh & mesh, ModelsContentType modelsContentType);
+        VkDeviceSize getMeshContentAlignment(const Mesh & mesh, ModelsContentType modelsContentType);
+        void addModelBufferSizes(Model * model, BufferSummary & bufferSizes);
+        bool collectDraws(uint16_t commandBufferIndex, bool useIndices, InstanceData & instanceData);
+        uint32_t draw(
+            VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex, const InstanceData & instanceData, bool useIndices, 
+            uint32_t firstDrawCommand, uint32_t lastDrawCommand);
+        
+        bool createCulling();
+        bool createCullingDescriptorPool();
+        bool createCullingDescriptorSetLayouts();
+        bool createCullingDescriptorSet();
+        bool createComputePipeline(
+            const std::string & shaderFile, VkDescriptorSetLayout descriptorSetLayout, uint32_t pushConstantSize, 
+            VkShaderModule & shaderModule, VkPipelineLayout & pipelineLayout, VkPipeline & pipeline);
+        bool isCullingActive();
+        bool isOcclusionCullingActive();
+        bool createDepthPyramid();
+        void destroyDepthPyramid();
+        void recordCulling(VkCommandBuffer & commandBuffer, uint16_t commandBufferIndex, const InstanceData & instanceData);
+        void recordDepthPyramid(VkCommandBuffer & commandBuffer);
+        float getProjectedScreenSize(BoundingBox & bbox, const glm::mat4 & modelMatrix);
         
     public:
         Graphics(const Graphics&) = delete;
@@ -250,10 +546,13 @@ class Graphics {
         void addModel(const std::string & dir, const std::string & file);
         void addText(std::string id, std::string font, std::string text, uint16_t size);
         bool prepareModels();
+        bool addModelAtRuntime(Model * model);
+        bool removeModelAtRuntime(std::string id);
 
         VkExtent2D getWindowExtent();
         
         void toggleWireFrame();
+        void toggleOcclusionCulling();
         SDL_Window * getSdlWindow();
         
         void prepareComponents();
@@ -262,6 +561,13 @@ class Graphics {
         
         Models & getModels();
         BufferSummary getModelsBufferSizes(bool printInfo = false);
+        MemoryStatistics getMemoryStatistics(MemoryCategory category);
+        std::vector<MemoryHeapBudget> getMemoryHeapBudgets();
+        void setMemoryBudget(MemoryCategory category, VkDeviceSize budget);
+        void setTextureBudget(VkDeviceSize budget);
+        VkDeviceSize getTextureBudget();
+        void printMemoryStatistics();
+        void printGeometryRetention();
         BufferSummary getTerrainBufferSizes();
         
         double getDeltaTime();
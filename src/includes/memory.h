@@ -0,0 +1,159 @@
+#ifndef SRC_INCLUDES_MEMORY_H_
+#define SRC_INCLUDES_MEMORY_H_
+
+#include "shared.h"
+
+enum MemoryCategory {
+    GEOMETRY_MEMORY, TEXTURE_MEMORY, STAGING_MEMORY, UNIFORM_MEMORY, ATTACHMENT_MEMORY
+};
+
+static constexpr size_t MEMORY_CATEGORY_COUNT = 5;
+
+struct MemoryAllocation final {
+    public:
+        VkDeviceMemory memory = nullptr;
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        void * data = nullptr;
+        uint32_t memoryType = 0;
+        MemoryCategory category = STAGING_MEMORY;
+        bool linear = true;
+        bool dedicated = false;
+
+        bool isValid() const {
+            return this->memory != nullptr;
+        }
+};
+
+struct MemoryStatistics final {
+    public:
+        uint32_t allocations = 0;
+        uint32_t dedicatedAllocations = 0;
+        VkDeviceSize allocatedSize = 0;
+        VkDeviceSize peakAllocatedSize = 0;
+        VkDeviceSize hostVisibleSize = 0;
+        VkDeviceSize budget = 0;
+};
+
+struct MemoryHeapBudget final {
+    public:
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;
+        VkDeviceSize allocatedSize = 0;
+        bool deviceLocal = false;
+};
+
+class FreeList final {
+    private:
+        VkDeviceSize size = 0;
+        VkDeviceSize usedSize = 0;
+        std::map<VkDeviceSize, VkDeviceSize> freeRanges;
+
+    public:
+        FreeList(VkDeviceSize size = 0);
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset);
+        bool allocateAt(VkDeviceSize offset, VkDeviceSize size);
+        void free(VkDeviceSize offset, VkDeviceSize size);
+        void grow(VkDeviceSize size);
+        VkDeviceSize getSize() const;
+        VkDeviceSize getUsedSize() const;
+        VkDeviceSize getLargestFreeRange() const;
+};
+
+class MemoryBlock final {
+    private:
+        VkDeviceMemory memory = nullptr;
+        void * data = nullptr;
+        FreeList freeList;
+
+    public:
+        MemoryBlock(VkDeviceMemory memory, VkDeviceSize size, void * data);
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize & offset);
+        void free(VkDeviceSize offset, VkDeviceSize size);
+        bool isEmpty();
+        VkDeviceMemory getMemory();
+        VkDeviceSize getSize();
+        VkDeviceSize getUsedSize();
+        void * getData();
+};
+
+class MemoryAllocator final {
+    private:
+        VkDevice device = nullptr;
+        VkPhysicalDevice physicalDevice = nullptr;
+        VkPhysicalDeviceMemoryProperties memoryProperties;
+        PFN_vkGetPhysicalDeviceMemoryProperties2KHR getMemoryProperties2 = nullptr;
+
+        // linear resources and optimal tiling images never share a block, that sidesteps bufferImageGranularity
+        std::vector<std::vector<std::unique_ptr<MemoryBlock>>> linearBlocks;
+        std::vector<std::vector<std::unique_ptr<MemoryBlock>>> optimalBlocks;
+        std::array<MemoryStatistics, MEMORY_CATEGORY_COUNT> statistics;
+        std::array<bool, MEMORY_CATEGORY_COUNT> budgetsExceeded {};
+        std::vector<VkDeviceSize> heapAllocatedSizes;
+        std::vector<bool> heapBudgetsExceeded;
+        std::mutex lock;
+
+        VkDeviceSize getBlockSize(uint32_t memoryType);
+        bool allocateDeviceMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory & memory, void ** data);
+        void freeDeviceMemory(VkDeviceMemory memory, VkDeviceSize size, uint32_t memoryType);
+        std::vector<MemoryHeapBudget> queryHeapBudgets();
+        void checkBudgets(MemoryCategory category, uint32_t heapIndex);
+
+    public:
+        static const VkDeviceSize BLOCK_SIZE;
+        static const VkDeviceSize MIN_BLOCK_SIZE;
+        static const float HEAP_BUDGET_RATIO;
+        static const std::array<std::string, MEMORY_CATEGORY_COUNT> CATEGORY_NAMES;
+
+        void init(const VkInstance & instance, const VkPhysicalDevice & physicalDevice, const VkDevice & device, bool supportsMemoryBudget = false);
+        bool allocate(const VkMemoryRequirements & requirements, uint32_t memoryType, MemoryCategory category, bool linear, MemoryAllocation & allocation);
+        void free(MemoryAllocation & allocation);
+        MemoryStatistics getStatistics(MemoryCategory category);
+        std::vector<MemoryHeapBudget> getHeapBudgets();
+        void setBudget(MemoryCategory category, VkDeviceSize budget);
+        bool hasMemoryBudgetSupport();
+        void printStatistics();
+        void destroy();
+};
+
+struct GeometryRange final {
+    public:
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        VkDeviceSize alignment = 1;
+        bool used = false;
+};
+
+struct GeometryMove final {
+    public:
+        uint32_t handle = 0;
+        VkDeviceSize srcOffset = 0;
+        VkDeviceSize dstOffset = 0;
+        VkDeviceSize size = 0;
+};
+
+// ranges of one model buffer handed out by handle, offsets may change when the arena is compacted
+class GeometryArena final {
+    private:
+        FreeList freeList;
+        std::vector<GeometryRange> ranges;
+        std::vector<uint32_t> freeHandles;
+
+    public:
+        static const uint32_t INVALID_HANDLE;
+
+        void reset(VkDeviceSize capacity);
+        void grow(VkDeviceSize capacity);
+        bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint32_t & handle);
+        void free(uint32_t handle);
+        VkDeviceSize getOffset(uint32_t handle) const;
+        VkDeviceSize getSize(uint32_t handle) const;
+        VkDeviceSize getCapacity() const;
+        VkDeviceSize getUsedSize() const;
+        float getFragmentation() const;
+        std::vector<GeometryMove> planCompaction() const;
+        void applyCompaction(const std::vector<GeometryMove> & moves);
+};
+
+#endif
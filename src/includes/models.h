@@ -2,6 +2,26 @@
 #define SRC_INCLUDES_MODELS_H_
 
 #include "camera.h"
+#include "memory.h"
+
+static constexpr uint32_t MODEL_IMPORT_FLAGS = 
+    aiProcess_Triangulate | aiProcess_GenBoundingBoxes | aiProcess_CalcTangentSpace | aiProcess_FlipUVs | aiProcess_GenSmoothNormals;
+
+class MappedFile final {
+    private:
+        char * data = nullptr;
+        uint64_t size = 0;
+        bool mapped = false;
+        
+    public:
+        MappedFile(const std::filesystem::path & file);
+        MappedFile(const MappedFile &) = delete;
+        MappedFile & operator=(const MappedFile &) = delete;
+        ~MappedFile();
+        bool isValid();
+        const char * getData();
+        uint64_t getSize();
+};
 
 struct BufferSummary {
     VkDeviceSize vertexBufferSize = 0;
@@ -21,6 +41,8 @@ struct MeshProperties final {
         float opacity = 1.0f;
         glm::vec3 specularColor = glm::vec3(0.3f);
         float shininess = 10.0f;
+        glm::vec4 positionOffset = glm::vec4(0.0f);
+        glm::vec4 positionScale = glm::vec4(1.0f);
 };
 
 struct ModelProperties final {
@@ -28,6 +50,20 @@ struct ModelProperties final {
         glm::mat4 matrix = glm::mat4(1);
 };
 
+// gl_InstanceIndex picks one of these, they point at the component's transform and the mesh's properties
+struct InstanceProperties final {
+    public:
+        uint32_t modelPropertiesIndex = 0;
+        uint32_t meshPropertiesIndex = 0;
+};
+
+// model space bounds of a transform, the culling pass tests them against the frustum and the depth pyramid
+struct InstanceBounds final {
+    public:
+        glm::vec4 min = glm::vec4(0.0f);
+        glm::vec4 max = glm::vec4(0.0f);
+};
+
 class SimpleVertex final {
     private:
         glm::vec3 position;
@@ -73,13 +109,34 @@ class ModelVertex final {
         static VkVertexInputBindingDescription getBindingDescription();
         static std::array<VkVertexInputAttributeDescription, 5> getAttributeDescriptions();
 
-        glm::vec3 getPosition();
+        glm::vec3 getPosition() const;
+        glm::vec3 getNormal() const;
+        glm::vec2 getUV() const;
+        glm::vec3 getTangent() const;
+        glm::vec3 getBitangent() const;
         void setUV(const glm::vec2 & uv);
         void setNormal(const glm::vec3 & normal);
         void setTangent(const glm::vec3 & tangent);
         void setBitangent(const glm::vec3 & bitangent);
 };
 
+class PackedModelVertex final {
+    private:
+        // unorm16 within the mesh bounds, w holds the sign of the bitangent
+        uint16_t position[4];
+        // octahedral encoded snorm16
+        int16_t normal[2];
+        int16_t tangent[2];
+        // half float
+        uint32_t uv;
+
+    public:
+        PackedModelVertex(const ModelVertex & vertex, const glm::vec3 & boundsMin, const glm::vec3 & boundsExtent);
+
+        static VkVertexInputBindingDescription getBindingDescription();
+        static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions();
+};
+
 struct MaterialInformation final {
     public:
         glm::vec3 ambientColor = glm::vec3(1.0f);
@@ -106,24 +163,49 @@ struct TextureInformation final {
         }
 };
 
+enum ModelsContentType {
+    VERTEX, INDEX, SSBO
+};
+
+// what stays in RAM once a model has been uploaded, collision only looks at the bounding boxes
+enum GeometryRetention {
+    RETAIN_ALL, RETAIN_POSITIONS, RETAIN_COLLISION, RETAIN_NONE
+};
+
+static constexpr size_t GEOMETRY_RETENTION_COUNT = 4;
+
 class Mesh final {
     private:
         std::vector<ModelVertex> vertices;
         std::vector<uint32_t> indices;
+        std::vector<std::vector<uint32_t>> lods;
+        std::vector<glm::vec3> positions;
+        uint32_t vertexCount = 0;
+        std::vector<uint32_t> lodIndexCounts;
+        bool geometryReleased = false;
         TextureInformation textures;
         MaterialInformation materials;
         BoundingBox bbox;
         bool isBbox = false;
         std::string name = "";
+        std::array<uint32_t, 3> geometryHandles = { GeometryArena::INVALID_HANDLE, GeometryArena::INVALID_HANDLE, GeometryArena::INVALID_HANDLE };
     public:
-        Mesh(const std::vector<ModelVertex> & vertices);
-        Mesh(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> indices);
-        Mesh(const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> indices, 
+        Mesh(std::vector<ModelVertex> vertices);
+        Mesh(std::vector<ModelVertex> vertices, std::vector<uint32_t> indices);
+        Mesh(std::vector<ModelVertex> vertices, std::vector<uint32_t> indices, 
              const TextureInformation & textures, const MaterialInformation & materials);
         const std::vector<ModelVertex> & getVertices() const;
         const std::vector<uint32_t> & getIndices() const;
+        const std::vector<glm::vec3> & getPositions() const;
+        const std::vector<uint32_t> & getLodIndices(uint32_t level) const;
+        uint32_t getVertexCount() const;
+        uint32_t getLodIndexCount(uint32_t level) const;
+        uint32_t getLodCount() const;
+        VkDeviceSize getLodFirstIndex(uint32_t level) const;
+        VkDeviceSize getIndexCountForAllLods() const;
+        void setLods(std::vector<std::vector<uint32_t>> lods);
         void setColor(glm::vec4 color);
-        TextureInformation getTextureInformation();
+        const TextureInformation & getTextureInformation() const;
         MaterialInformation getMaterialInformation();
         void setTextureInformation(TextureInformation & TextureInformation);
         void setBoundingBox(BoundingBox & bbox);
@@ -133,6 +215,13 @@ class Mesh final {
         void markAsBoundingBox();
         std::string getName();
         void setName(std::string name);
+        void getPositionBounds(glm::vec3 & boundsMin, glm::vec3 & boundsExtent) const;
+        VkIndexType getIndexType() const;
+        VkDeviceSize getIndexSize() const;
+        uint32_t getGeometryHandle(ModelsContentType modelsContentType) const;
+        void setGeometryHandle(ModelsContentType modelsContentType, uint32_t handle);
+        VkDeviceSize releaseGeometry(GeometryRetention retention);
+        VkDeviceSize getGeometrySize() const;
 };
 
 class Texture final {
@@ -145,8 +234,26 @@ class Texture final {
         VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
         SDL_Surface * textureSurface = nullptr;
         VkImage textureImage = nullptr;
-        VkDeviceMemory textureImageMemory = nullptr;
+        MemoryAllocation textureImageMemory;
         VkImageView textureImageView = nullptr;
+        uint32_t topMipLevel = 0;
+        std::unique_ptr<MappedFile> cookedFile = nullptr;
+        std::vector<VkBufferImageCopy> cookedMipLevels;
+        uint64_t cookedPixelsOffset = 0;
+        VkDeviceSize cookedPixelsSize = 0;
+        
+        // levels dropped on top of topMipLevel by the residency manager, only cooked textures can be streamed
+        // the image holds the levels from imageMipLevel on, its view starts at residentMipLevel
+        bool streamable = false;
+        uint32_t residentMipLevel = 0;
+        uint32_t imageMipLevel = 0;
+        uint32_t streamableMipLevels = 0;
+        uint32_t streamableWidth = 0;
+        uint32_t streamableHeight = 0;
+        
+        bool dropTopMipLevels();
+        bool cook();
+        bool loadCooked(uint32_t firstLevel);
         
     public:
         int getId();
@@ -156,7 +263,28 @@ class Texture final {
         void setId(const int & id);
         void setType(const std::string & type);
         void setPath(const std::filesystem::path & path);
+        void setTopMipLevel(const uint32_t & topMipLevel);
+        const std::filesystem::path & getPath();
+        uint32_t getTopMipLevel();
+        uint32_t getMipLevels();
+        bool hasCookedMipLevels();
+        std::vector<VkBufferImageCopy> getCookedMipLevels();
         void load();
+        bool loadMipLevels(uint32_t residentMipLevel);
+        // reads the levels straight out of the cooked file, it doesn't touch any texture and may run on any thread
+        static bool readCookedMipLevels(
+            const std::filesystem::path & path, uint32_t topMipLevel, uint32_t firstLevel, uint32_t levelCount, 
+            void * destination, VkDeviceSize size, std::vector<VkBufferImageCopy> & regions);
+        bool isStreamable();
+        uint32_t getResidentMipLevel();
+        void setResidentMipLevel(uint32_t residentMipLevel);
+        uint32_t getImageMipLevel();
+        void setImageMipLevel(uint32_t imageMipLevel);
+        uint32_t getStreamableMipLevels();
+        VkExtent2D getMipLevelExtent(uint32_t level);
+        uint32_t getMipLevelForSize(uint32_t size);
+        VkDeviceSize getMipChainSize(uint32_t residentMipLevel);
+        VkDeviceSize getResidentSize();
         uint32_t getWidth();
         uint32_t getHeight();
         VkDeviceSize getSize();
@@ -165,10 +293,12 @@ class Texture final {
         Texture(bool empty = false, VkExtent2D extent = {100, 100});
         Texture(SDL_Surface * surface);
         ~Texture();
-        void cleanUpTexture(const VkDevice & device);
+        void cleanUpTexture(const VkDevice & device, MemoryAllocator & allocator);
         bool readImageFormat();
         void setTextureImage(VkImage & image);
-        void setTextureImageMemory(VkDeviceMemory & imageMemory);
+        VkImage getTextureImage();
+        MemoryAllocation & getTextureImageMemory();
+        void setTextureImageMemory(MemoryAllocation & imageMemory);
         void setTextureImageView(VkImageView & imageView);
         VkImageView & getTextureImageView();
 };
@@ -179,7 +309,7 @@ class Model final {
         std::filesystem::path file;
         std::vector<Mesh> meshes;
         bool loaded = false;
-        VkDeviceSize ssboOffset = 0;
+        GeometryRetention geometryRetention = RETAIN_COLLISION;
 
         BoundingBox bbox;
         
@@ -188,6 +318,8 @@ class Model final {
 
         Model(const std::string id);        
     public:
+        static const std::array<std::string, GEOMETRY_RETENTION_COUNT> GEOMETRY_RETENTION_NAMES;
+        
         ~Model();
         Model() {};
         Model(const std::string id, const std::filesystem::path file);
@@ -200,21 +332,65 @@ class Model final {
         void setColor(glm::vec4 color);
         TextureInformation addTextures(const aiMaterial * mat);
         void correctTexturePath(char * path);
-        void setSsboOffset(VkDeviceSize offset);
-        VkDeviceSize getSsboOffset();
         BoundingBox & getBoundingBox();
         void setBoundingBox(BoundingBox bbox);
         void calculateBoundingBoxForModel(bool addBboxMesh = false);
+        GeometryRetention getGeometryRetention();
+        void setGeometryRetention(GeometryRetention geometryRetention);
+        VkDeviceSize releaseGeometry();
+        VkDeviceSize getGeometrySize();
 };
 
-enum ModelsContentType {
-    VERTEX, INDEX, SSBO
+class ModelCache final {
+    private:
+        static std::atomic<uint32_t> hits;
+        static std::atomic<uint32_t> misses;
+        
+    public:
+        static const uint32_t VERSION;
+        static const std::string CACHE_DIRECTORY;
+        static const std::string CACHE_EXTENSION;
+        static const std::string COOKED_TEXTURE_EXTENSION;
+
+        static std::filesystem::path getCacheFile(const std::filesystem::path & file, const std::string & extension = CACHE_EXTENSION);
+        static bool readSourceStamp(const std::filesystem::path & file, int64_t & modificationTime, uint64_t & size);
+        static bool load(const std::filesystem::path & file, const uint32_t importFlags, std::vector<Mesh> & meshes);
+        static bool store(const std::filesystem::path & file, const uint32_t importFlags, std::vector<Mesh> & meshes);
+        static uint32_t getHits();
+        static uint32_t getMisses();
+        static void resetStatistics();
+};
+
+class MeshOptimizer final {
+    public:
+        static const int64_t CACHE_SIZE;
+        static const size_t LOD_MIN_TRIANGLES;
+        static const std::array<float, 3> LOD_TARGET_RATIOS;
+        static const std::array<float, 3> LOD_TARGET_ERRORS;
+
+        static void optimize(std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices, const std::string & name = "");
+        static uint32_t weldVertices(std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices);
+        static void optimizeVertexCache(std::vector<uint32_t> & indices, const uint32_t vertexCount, std::vector<uint32_t> & clusters);
+        static void optimizeOverdraw(const std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices, const std::vector<uint32_t> & clusters);
+        static void optimizeVertexFetch(std::vector<ModelVertex> & vertices, std::vector<uint32_t> & indices);
+        static float calculateACMR(const std::vector<uint32_t> & indices, const uint32_t vertexCount);
+        static std::vector<uint32_t> simplify(
+            const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> & indices,
+            const size_t targetIndexCount, const float targetError, float & resultError);
+        static std::vector<std::vector<uint32_t>> generateLods(
+            const std::vector<ModelVertex> & vertices, const std::vector<uint32_t> & indices, const std::string & name = "");
 };
 
 class Models final {
     private:
         std::map<std::string, std::unique_ptr<Texture>> textures;
         std::vector<std::unique_ptr<Model>> models;
+        uint32_t textureTopMipLevel = 0;
+        std::map<std::string, uint32_t> textureTopMipLevels;
+        
+        int findTextureId(const std::string & location);
+        int findFreeTextureId();
+        std::vector<Texture *> loadTextures(const std::vector<Model *> & models);
 
     public:
         void addModel(Model * model);
@@ -225,14 +401,21 @@ class Models final {
         const static std::string DIFFUSE_TEXTURE;
         const static std::string SPECULAR_TEXTURE;
         const static std::string TEXTURE_NORMALS;
-        void processTextures(Mesh & mesh);
+        const static std::string DUMMY_TEXTURE;
+        void processTextures();
+        std::vector<Texture *> processTextures(Model * model);
+        std::unique_ptr<Model> removeModel(std::string id);
+        std::vector<std::unique_ptr<Texture>> releaseUnusedTextures();
+        void setTextureTopMipLevel(const uint32_t & topMipLevel);
+        void setTextureTopMipLevel(const std::string & location, const uint32_t & topMipLevel);
         std::map<std::string, std::unique_ptr<Texture>> &  getTextures();
         std::vector<std::string> getModelIds();
         VkImageView findTextureImageViewById(int id); 
-        void cleanUpTextures(const VkDevice & device);
+        void cleanUpTextures(const VkDevice & device, MemoryAllocator & allocator);
         std::vector<std::unique_ptr<Model>> & getModels();
         Model * findModel(std::string id);
         static Model * createPlaneModel(std::string id, VkExtent2D extent);
+        static std::vector<Model *> importModels(const std::vector<std::tuple<std::string, std::filesystem::path>> & modelFiles);
         ~Models();
 
 };
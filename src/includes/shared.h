@@ -8,10 +8,15 @@
 #include <vector>
 #include <array>
 #include <map>
+#include <set>
+#include <unordered_map>
 #include <functional>
 #include <algorithm>
+#include <numeric>
 #include <queue>
+#include <deque>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
 #include <tuple>
@@ -32,6 +37,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/packing.hpp>
 #include <glm/gtx/string_cast.hpp>
 
 #include <assimp/Importer.hpp>
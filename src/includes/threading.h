@@ -3,105 +3,360 @@
 
 #include "shared.h"
 
-class CommandBufferQueue final {
+class WorkerPool final {
     private:
-        std::unique_ptr<std::thread> queueThread = nullptr;
-        bool isStopping = true;
-        bool hasStopped = true;
+        std::vector<std::thread> workers;
         std::mutex lock;
-        std::mutex lock2;
-        std::vector<std::queue<VkCommandBuffer>> commmandBuffers;
-        std::vector<VkCommandBuffer> trash;
-        uint16_t maxItems = 3;
-        
-        void emptyTrash(std::function<void(VkCommandBuffer)> commandBufferDeletion) {
-            for (auto & t : this->trash) {
-                commandBufferDeletion(t);    
+        std::condition_variable condition;
+        std::condition_variable finished;
+        std::function<void(size_t)> task = nullptr;
+        size_t numberOfTasks = 0;
+        std::atomic<size_t> nextTask {0};
+        size_t busyWorkers = 0;
+        uint64_t batch = 0;
+        bool isStopping = false;
+        
+        void work() {
+            size_t next = this->nextTask++;
+            while (next < this->numberOfTasks) {
+                this->task(next);
+                next = this->nextTask++;
             }
+        }
+        
+    public:
+        // the threads are kept around between batches, the thread handing out a batch works on it as well
+        WorkerPool(const size_t numberOfWorkers) {
+            this->workers.reserve(numberOfWorkers);
             
-            this->trash.clear(); 
+            for (size_t w=0; w<numberOfWorkers; w++) {
+                this->workers.emplace_back([this]() {
+                    uint64_t lastBatch = 0;
+                    
+                    while (true) {
+                        {
+                            std::unique_lock<std::mutex> lock(this->lock);
+                            this->condition.wait(lock, [this, &lastBatch]() { return this->isStopping || this->batch != lastBatch; });
+                            if (this->isStopping) return;
+                            
+                            lastBatch = this->batch;
+                            this->busyWorkers++;
+                        }
+                        
+                        this->work();
+                        
+                        {
+                            std::lock_guard<std::mutex> lock(this->lock);
+                            this->busyWorkers--;
+                        }
+                        this->finished.notify_all();
+                    }
+                });
+            }
         }
-    public:        
-        VkCommandBuffer getNextCommandBuffer(uint16_t frameIndex) {            
+        
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(this->lock);
+                this->isStopping = true;
+            }
+            this->condition.notify_all();
+            
+            for (auto & worker : this->workers) worker.join();
+        }
+        
+        // blocks until all tasks are done, one batch at a time
+        void execute(const size_t numberOfTasks, std::function<void(size_t)> task) {
+            if (numberOfTasks == 0) return;
+            
+            {
+                // a worker that woke up late may still be looking at the previous batch
+                std::unique_lock<std::mutex> lock(this->lock);
+                this->finished.wait(lock, [this]() { return this->busyWorkers == 0; });
+                
+                this->task = task;
+                this->numberOfTasks = numberOfTasks;
+                this->nextTask = 0;
+                this->batch++;
+            }
+            this->condition.notify_all();
+            
+            this->work();
+            
+            std::unique_lock<std::mutex> lock(this->lock);
+            this->finished.wait(lock, [this]() { return this->busyWorkers == 0; });
+        }
+        
+        static void run(const size_t numberOfTasks, std::function<void(size_t)> task) {
+            if (numberOfTasks == 0) return;
+            
+            const size_t numberOfWorkers = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), numberOfTasks));
+            std::atomic<size_t> nextTask(0);
+            
+            std::vector<std::thread> workers;
+            workers.reserve(numberOfWorkers);
+            
+            for (size_t w=0; w<numberOfWorkers; w++) {
+                workers.emplace_back([&nextTask, &task, numberOfTasks]() {
+                    size_t next = nextTask++;
+                    while (next < numberOfTasks) {
+                        task(next);
+                        next = nextTask++;
+                    }
+                });
+            }
+            
+            for (auto & worker : workers) worker.join();
+        }
+};
+
+// runs jobs one after the other on a thread of its own, started with the first job
+class JobQueue final {
+    private:
+        std::unique_ptr<std::thread> queueThread = nullptr;
+        std::mutex lock;
+        std::condition_variable condition;
+        std::deque<std::function<void()>> jobs;
+        uint64_t addedJobs = 0;
+        std::atomic<uint64_t> finishedJobs {0};
+        bool isStopping = false;
+        
+    public:
+        ~JobQueue() {
+            this->stopQueue();
+        }
+        
+        // the job is done once getFinishedJobs() reaches the returned number
+        uint64_t addJob(std::function<void()> job) {
             std::lock_guard<std::mutex> lock(this->lock);
+            
+            if (this->queueThread == nullptr) {
+                this->isStopping = false;
+                this->queueThread = std::make_unique<std::thread>([this]() {
+                    while (true) {
+                        std::function<void()> job = nullptr;
+                        
+                        {
+                            std::unique_lock<std::mutex> lock(this->lock);
+                            this->condition.wait(lock, [this]() { return this->isStopping || !this->jobs.empty(); });
+                            if (this->isStopping) return;
+                            
+                            job = std::move(this->jobs.front());
+                            this->jobs.pop_front();
+                        }
+                        
+                        job();
+                        this->finishedJobs++;
+                    }
+                });
+            }
+            
+            this->jobs.push_back(job);
+            this->condition.notify_all();
+            
+            return ++this->addedJobs;
+        }
+        
+        uint64_t getFinishedJobs() {
+            return this->finishedJobs;
+        }
+        
+        // jobs that haven't started are dropped, the running one is waited for
+        void stopQueue() {
+            {
+                std::lock_guard<std::mutex> lock(this->lock);
+                if (this->queueThread == nullptr) return;
+                
+                this->isStopping = true;
+                this->jobs.clear();
+            }
+            this->condition.notify_all();
+            
+            this->queueThread->join();
+            this->queueThread = nullptr;
+            
+            // dropped jobs count as done, whoever waits on them finds their results missing
+            this->finishedJobs = this->addedJobs;
+        }
+};
 
-            if (this->isStopping || this->commmandBuffers[frameIndex].empty()) return nullptr;
+class CommandBufferQueue final {
+    public:
+        // one slot per frame is handed out for submission, the other one is recorded into meanwhile
+        static constexpr uint16_t SLOTS_PER_FRAME = 2;
+        
+    private:
+        struct RecordedFrame final {
+            std::array<VkCommandBuffer, SLOTS_PER_FRAME> commandBuffers {};
+            std::array<uint64_t, SLOTS_PER_FRAME> generations {};
+            int submitted = -1;
+            bool recording = false;
+            uint64_t failedGeneration = 0;
+        };
+        
+        std::unique_ptr<std::thread> queueThread = nullptr;
+        bool isStopping = true;
+        bool checkRequested = false;
+        std::mutex lock;
+        // held while recording as well as while the scene is changed, a recording sees a change either fully or not at all
+        std::mutex recordingLock;
+        std::condition_variable condition;
+        std::vector<RecordedFrame> frames;
+        uint16_t lastAcquiredFrame = 0;
+        // bumped with every change, recordings below the required generation reference resources that have been replaced
+        uint64_t generation = 1;
+        uint64_t requiredGeneration = 1;
+        
+        int getSpareSlot(const RecordedFrame & frame) {
+            return frame.submitted == 0 ? 1 : 0;
+        }
+        
+        bool isUsable(const RecordedFrame & frame, int slot) {
+            return slot >= 0 && frame.commandBuffers[slot] != nullptr && frame.generations[slot] >= this->requiredGeneration;
+        }
+        
+        // a finished recording that is merely outdated waits to be picked up, otherwise it would never be
+        // while the scene keeps changing
+        bool needsRecording(const RecordedFrame & frame) {
+            if (frame.recording || frame.failedGeneration == this->generation) return false;
+            if (this->isUsable(frame, this->getSpareSlot(frame))) return false;
             
-            VkCommandBuffer ret = this->commmandBuffers[frameIndex].front();
-            this->commmandBuffers[frameIndex].pop();
+            return !this->isUsable(frame, frame.submitted) || frame.generations[frame.submitted] < this->generation;
+        }
+        
+        // the frame that is going to be acquired next comes first
+        int findFrameToRecord() {
+            for (size_t i=1; i<=this->frames.size(); i++) {
+                const size_t frameIndex = (this->lastAcquiredFrame + i) % this->frames.size();
+                if (this->needsRecording(this->frames[frameIndex])) return static_cast<int>(frameIndex);
+            }
             
-            return ret;
+            return -1;
         }
         
-        uint16_t getNumberOfItems(uint16_t frameIndex) {
-            if (this->isStopping) return 0;
+    public:
+        // to be called once the previous submission of the frame has completed, the slot it replaces is recorded into next
+        VkCommandBuffer acquireCommandBuffer(uint16_t frameIndex) {
+            std::unique_lock<std::mutex> lock(this->lock);
+            
+            if (this->isStopping || frameIndex >= this->frames.size()) return nullptr;
+            
+            this->lastAcquiredFrame = frameIndex;
+            this->checkRequested = true;
+            this->condition.notify_all();
+            
+            RecordedFrame & frame = this->frames[frameIndex];
+            const int spare = this->getSpareSlot(frame);
+            
+            // a failed recording isn't retried before the next change, there is nothing to wait for then
+            const bool hasCommandBuffer = this->condition.wait_for(lock, std::chrono::milliseconds(2000), [this, &frame, spare]() {
+                return this->isStopping || this->isUsable(frame, spare) || this->isUsable(frame, frame.submitted) || 
+                    frame.failedGeneration == this->generation;
+            });
+            if (!hasCommandBuffer || this->isStopping) return nullptr;
+            if (!this->isUsable(frame, spare) && !this->isUsable(frame, frame.submitted)) return nullptr;
             
-            return this->commmandBuffers[frameIndex].size();
+            if (this->isUsable(frame, spare)) {
+                if (frame.submitted >= 0) frame.commandBuffers[frame.submitted] = nullptr;
+                frame.submitted = spare;
+                this->condition.notify_all();
+            }
+            
+            return frame.commandBuffers[frame.submitted];
         }
         
-        void startQueue(std::function<VkCommandBuffer(uint16_t)> commandBufferCreation, 
-                        std::function<void(VkCommandBuffer)> commandBufferDeletion, uint16_t numberOfFrames) {
-            this->commmandBuffers.resize(numberOfFrames);
-
-            this->queueThread = std::make_unique<std::thread>([this, commandBufferCreation,commandBufferDeletion]() {
-                this->isStopping = false;
-                this->hasStopped = false;
+        void startQueue(std::function<VkCommandBuffer(uint16_t, uint16_t)> commandBufferRecording, 
+                        std::function<bool()> sceneCheck, uint16_t numberOfFrames) {
+            if (this->queueThread != nullptr) return;
+            
+            this->frames.assign(numberOfFrames, RecordedFrame());
+            this->isStopping = false;
 
-                std::chrono::high_resolution_clock::time_point lastDeletion = std::chrono::high_resolution_clock::now();
-                while(!this->isStopping) {
-                    for (uint16_t i=0;i<this->commmandBuffers.size();i++) {
+            this->queueThread = std::make_unique<std::thread>([this, commandBufferRecording, sceneCheck]() {
+                while (true) {
+                    {
+                        std::unique_lock<std::mutex> lock(this->lock);
+                        this->condition.wait(lock, [this]() {
+                            return this->isStopping || this->checkRequested || this->findFrameToRecord() >= 0;
+                        });
                         if (this->isStopping) break;
-
-                        {
-                            std::lock_guard<std::mutex> lock(this->lock);
-
-                            uint16_t numberOfCommandBuffers = this->commmandBuffers[i].size();
-                            if (numberOfCommandBuffers < maxItems) {
-                                VkCommandBuffer buf = commandBufferCreation(i);
-                                if (buf != nullptr) {
-                                    this->commmandBuffers[i].push(std::move(buf));
-                                }
-                            }
-                        }
                     }
                     
-                    std::chrono::duration<double, std::milli> timeSinceLastDeletion = std::chrono::high_resolution_clock::now() - lastDeletion;
-                    if (timeSinceLastDeletion.count() > 5000) {
-                        std::lock_guard<std::mutex> lock(this->lock2);
-                        this->emptyTrash(commandBufferDeletion);
-                        lastDeletion = std::chrono::high_resolution_clock::now();
-                    }                        
+                    std::lock_guard<std::mutex> recordingLock(this->recordingLock);
+                    
+                    // polled once per acquired frame, outside of the lock so that acquiring isn't held up by it
+                    bool check = false;
+                    {
+                        std::lock_guard<std::mutex> lock(this->lock);
+                        check = this->checkRequested;
+                        this->checkRequested = false;
+                    }
+                    const bool sceneChanged = check && sceneCheck();
+                    
+                    int frameIndex = -1;
+                    int slot = -1;
+                    uint64_t generation = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(this->lock);
+                        if (sceneChanged) this->generation++;
+                        
+                        frameIndex = this->findFrameToRecord();
+                        if (frameIndex < 0) continue;
+                        
+                        RecordedFrame & frame = this->frames[frameIndex];
+                        slot = this->getSpareSlot(frame);
+                        frame.commandBuffers[slot] = nullptr;
+                        frame.recording = true;
+                        generation = this->generation;
+                    }
+                    
+                    VkCommandBuffer commandBuffer = commandBufferRecording(frameIndex, slot);
+                    
+                    {
+                        std::lock_guard<std::mutex> lock(this->lock);
+                        RecordedFrame & frame = this->frames[frameIndex];
+                        frame.recording = false;
+                        frame.commandBuffers[slot] = commandBuffer;
+                        frame.generations[slot] = generation;
+                        
+                        // not retried before the next change, a failing recording would keep the thread busy otherwise
+                        if (commandBuffer == nullptr) frame.failedGeneration = generation;
+                    }
+                    this->condition.notify_all();
                 }
-                
-                this->emptyTrash(commandBufferDeletion);
-                
-                this->hasStopped = true;
             });
-            
-            this->queueThread->detach();
         }
         
         void stopQueue() {
-            if (this->isStopping || this->hasStopped) return;
+            if (this->queueThread == nullptr) return;
             
-            this->isStopping = true;
-            
-            std::chrono::high_resolution_clock::time_point shutdownStart = std::chrono::high_resolution_clock::now();
-            while (!this->hasStopped) {
-                std::chrono::duration<double, std::milli> shutdownPeriod = std::chrono::high_resolution_clock::now() - shutdownStart;
-                if (shutdownPeriod.count() > 5000) break;
+            {
+                std::lock_guard<std::mutex> lock(this->lock);
+                this->isStopping = true;
             }
+            this->condition.notify_all();
+            
+            this->queueThread->join();
+            this->queueThread = nullptr;
             
-            this->commmandBuffers.clear();
+            this->frames.clear();
         }
         
         bool isRunning() {
-            return !this->isStopping && !this->hasStopped;
+            std::lock_guard<std::mutex> lock(this->lock);
+            return this->queueThread != nullptr && !this->isStopping;
         }
         
-        void queueCommandBufferForDeletion(VkCommandBuffer commandBuffer) {
-            std::lock_guard<std::mutex> lock(this->lock2);
-            this->trash.push_back(commandBuffer);
+        void runExclusively(std::function<void()> task) {
+            std::lock_guard<std::mutex> recordingLock(this->recordingLock);
+            
+            task();
+            
+            // whatever was recorded before the change must not be submitted anymore
+            std::lock_guard<std::mutex> lock(this->lock);
+            this->generation++;
+            this->requiredGeneration = this->generation;
+            this->condition.notify_all();
         }
 };
 
@@ -4,6 +4,11 @@
 #include "shared.h"
 #include "components.h"
 
+#ifdef __linux__
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
 class Utils final {
     public:
 
@@ -33,6 +38,25 @@ class Utils final {
 
             return true;
          }
+
+        static bool getResidentSetSize(size_t & residentSize, size_t & peakResidentSize) {
+#ifdef __linux__
+            std::ifstream statm("/proc/self/statm");
+            size_t totalPages = 0;
+            size_t residentPages = 0;
+            if (!(statm >> totalPages >> residentPages)) return false;
+            
+            struct rusage usage;
+            if (getrusage(RUSAGE_SELF, &usage) != 0) return false;
+            
+            residentSize = residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            peakResidentSize = static_cast<size_t>(usage.ru_maxrss) * 1024;
+            
+            return true;
+#else
+            return false;
+#endif
+        }
 };
 
 class SpatialTree final {